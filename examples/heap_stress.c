@@ -0,0 +1,132 @@
+#include "mm.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define SLOT_COUNT   64
+#define ROUNDS       100000
+#define MAX_SIZE     8192
+
+// 每个槽位记录一块分配及其填充内容
+typedef struct {
+    uint8_t *ptr;
+    size_t size;
+    size_t align;
+    uint8_t seed;
+} slot_t;
+
+static slot_t slots[SLOT_COUNT];
+static uint32_t rng_state = 12345;
+
+// 线性同余随机数
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1103515245 + 12345;
+    return rng_state >> 8;
+}
+
+// 按种子填充，用于检测相邻块被覆盖或realloc丢失内容
+static void fill(uint8_t *p, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)(seed + i);
+    }
+}
+
+static bool verify(const uint8_t *p, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != (uint8_t)(seed + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 对一个槽位做一次随机操作：分配、对齐分配、realloc或释放
+static bool step(slot_t *s)
+{
+    uint32_t op = rng_next() % 4;
+    size_t size = rng_next() % MAX_SIZE + 1;
+
+    if (s->ptr && !verify(s->ptr, s->size, s->seed)) {
+        printf("corruption at %p (size %u)\n", s->ptr, (unsigned)s->size);
+        return false;
+    }
+
+    if (!s->ptr && op == 3) {
+        op = 0;
+    }
+
+    switch (op) {
+    case 0:
+        if (s->ptr) {
+            mm_free(s->ptr);
+        }
+        s->ptr = mm_alloc(size);
+        s->align = 0;
+        break;
+
+    case 1:
+        if (s->ptr) {
+            mm_free(s->ptr);
+        }
+        s->align = (size_t)8 << (rng_next() % 9);  // 8..2048
+        s->ptr = mm_alloc_aligned(size, s->align);
+        if (s->ptr && ((uintptr_t)s->ptr & (s->align - 1))) {
+            printf("misaligned %p (align %u)\n", s->ptr, (unsigned)s->align);
+            return false;
+        }
+        break;
+
+    case 2: {
+        // 原地扩展与收缩都必须保留公共前缀
+        uint8_t *p = mm_realloc(s->ptr, size);
+        if (!p) {
+            return true;
+        }
+        size_t keep = size < s->size ? size : s->size;
+        if (s->ptr && !verify(p, keep, s->seed)) {
+            printf("realloc lost data at %p\n", p);
+            return false;
+        }
+        s->ptr = p;
+        break;
+    }
+
+    default:
+        mm_free(s->ptr);
+        s->ptr = NULL;
+        return true;
+    }
+
+    if (s->ptr) {
+        s->size = size;
+        s->seed = (uint8_t)rng_next();
+        fill(s->ptr, s->size, s->seed);
+    }
+    return true;
+}
+
+int main(void)
+{
+    mm_init();
+    memset(slots, 0, sizeof(slots));
+
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        if (!step(&slots[rng_next() % SLOT_COUNT])) {
+            printf("heap stress failed in round %u\n", (unsigned)round);
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (slots[i].ptr) {
+            mm_free(slots[i].ptr);
+        }
+    }
+
+    printf("heap stress passed: %u rounds\n", (unsigned)ROUNDS);
+    return 0;
+}
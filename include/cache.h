@@ -0,0 +1,28 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+
+// DMA传输方向
+typedef enum {
+    DMA_TO_DEVICE,       // CPU写入，设备读取
+    DMA_FROM_DEVICE,     // 设备写入，CPU读取
+    DMA_BIDIRECTIONAL    // 双向
+} dma_dir_t;
+
+// 按虚拟地址范围的数据缓存维护（DCCMVAC/DCIMVAC/DCCIMVAC，多核间自动广播）
+void dcache_clean_range(const void *addr, uint32_t size);
+void dcache_inv_range(void *addr, uint32_t size);
+void dcache_flush_range(const void *addr, uint32_t size);
+
+// 写入指令后同步指令缓存（加载代码、修改跳转表）
+void icache_sync_range(const void *addr, uint32_t size);
+
+// DMA缓冲区映射：传给设备前map，设备完成后unmap，返回设备使用的物理地址；
+// 接收缓冲区应按缓存行对齐，否则首尾行中的相邻数据会与设备写入互相覆盖
+uint32_t dma_map_single(void *addr, uint32_t size, dma_dir_t dir);
+void dma_unmap_single(void *addr, uint32_t size, dma_dir_t dir);
+
+uint32_t cache_line_size(void);
+
+#endif
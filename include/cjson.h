@@ -37,6 +37,9 @@ typedef struct {
     int depth;
 } parse_buffer;
 
+/* Create the node cache; call once after the slab allocator is up */
+void cJSON_Init(void);
+
 /* Supply a block of JSON, and this returns a cJSON object */
 cJSON *cJSON_Parse(const char *value);
 cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length);
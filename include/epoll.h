@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include "rbtree.h"
 
 #define EPOLL_CTL_ADD 1
 #define EPOLL_CTL_DEL 2
@@ -36,18 +37,6 @@ struct epoll_event {
     epoll_data_t data;
 };
 
-// 红黑树节点结构
-typedef struct rb_node {
-    unsigned long rb_parent_color;
-    struct rb_node *rb_right;
-    struct rb_node *rb_left;
-} rb_node_t;
-
-// 红黑树根节点
-typedef struct rb_root {
-    struct rb_node *rb_node;
-} rb_root_t;
-
 // epoll文件描述符信息
 typedef struct epitem {
     rb_node_t rbn;           // 红黑树节点
@@ -102,9 +102,10 @@ typedef struct cache_block {
     uint32_t block_no;       // 块号
     uint8_t *data;          // 数据
     bool dirty;             // 是否脏
-    uint32_t ref_count;     // 引用计数
+    uint32_t ref_count;     // 引用计数（大于1表示被文件映射固定）
     struct cache_block *next;// 下一个块
     struct cache_block *prev;// 前一个块
+    struct cache_block *hash_next;// 哈希链下一个块
 } cache_block_t;
 
 // 文件系统接口函数
@@ -135,4 +136,14 @@ void cache_release_block(cache_block_t *block);
 void cache_sync(void);
 void cache_invalidate(void);
 
+// 文件映射（页缓存）函数，块大小与页大小相同，文件页号即文件块号
+int fs_get_inode(int fd, uint32_t *ino);
+uint32_t fs_file_pages(uint32_t ino);
+uint32_t fs_file_size(uint32_t ino);
+void *fs_get_page(uint32_t ino, uint32_t pgoff);
+void *fs_find_page(uint32_t ino, uint32_t pgoff);
+void fs_put_page(uint32_t ino, uint32_t pgoff);
+void fs_set_page_dirty(uint32_t ino, uint32_t pgoff);
+uint32_t fs_readahead(uint32_t ino, uint32_t pgoff, uint32_t nr_pages);
+
 #endif 
\ No newline at end of file
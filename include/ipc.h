@@ -3,14 +3,53 @@
 
 #include "task.h"
 #include "sync.h"
+#include "mm.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+// IPC 对象键，IPC_PRIVATE创建的对象只能通过句柄访问
+typedef int32_t key_t;
+#define IPC_PRIVATE        0
+
+// 各类IPC对象数上限（句柄表容量）
+#define IPC_MAX_MSGQ       64
+#define IPC_MAX_SHM        64
+#define IPC_MAX_PIPE_FDS   128     // 每个管道占两个句柄
+
+// 句柄 = 代数 << IPC_HANDLE_INDEX_BITS | 槽下标；对象释放时代数加一，旧句柄随之失效
+#define IPC_HANDLE_INDEX_BITS  12
+#define IPC_HANDLE_GEN_MASK    0x7FFF
+#define IPC_KEY_HASH_BITS      6
+
+// 句柄表槽
+typedef struct ipc_handle_slot {
+    void *obj;                 // 对象，空闲时为NULL
+    key_t key;                 // 对象键
+    uint16_t gen;              // 当前代数
+    int16_t next;              // 键哈希链或空闲链中的下一个槽（-1结束）
+} ipc_handle_slot_t;
+
+// IPC对象公共头，必须是各对象结构的首字段
+typedef struct ipc_object {
+    volatile uint32_t refs;    // 引用计数：每个句柄一个，每个进行中的操作一个
+} ipc_object_t;
+
+// 句柄表：按句柄O(1)查找对象，按键哈希查找句柄
+typedef struct ipc_table {
+    ipc_handle_slot_t *slots;
+    uint32_t capacity;
+    uint32_t count;            // 已分配句柄数
+    int16_t free_head;         // 空闲槽链
+    int16_t buckets[1 << IPC_KEY_HASH_BITS]; // 键哈希桶
+    mutex_t lock;              // 保护分配、释放、查找与引用获取
+} ipc_table_t;
+
 // IPC 类型定义
 typedef enum {
     IPC_TYPE_MSG_QUEUE,
     IPC_TYPE_SHARED_MEM,
-    IPC_TYPE_PIPE
+    IPC_TYPE_PIPE,
+    IPC_TYPE_RING
 } ipc_type_t;
 
 // IPC 权限
@@ -27,46 +66,165 @@ typedef struct {
     uint8_t data[];        // 消息数据
 } msg_t;
 
+// 消息节点：位于消息块池的块首，其后紧跟msg_t（零拷贝收发直接传递msg_t指针）
+typedef struct msg_node {
+    struct msg_node *next;         // 同优先级链表（按到达顺序）
+    struct msg_node *prev;
+    struct msg_node *type_next;    // 同类型子队列（按到达顺序）
+    struct msg_node *type_prev;
+    struct msg_type_queue *tq;     // 所属类型子队列
+    uint32_t len;                  // 消息总长度（含msg_t头）
+    uint32_t key;                  // 优先级，截止时间模式下为截止tick
+    uint32_t seq;                  // 到达序号，截止时间相同时保持先进先出
+    uint32_t heap_idx;             // 截止时间堆中的下标
+    struct msg_queue *mq;          // 所属队列，消息从分配到释放一直持有队列的一个引用
+} __attribute__((aligned(8))) msg_node_t;
+
+// 同类型消息的子队列，按类型接收时直接取队首
+typedef struct msg_type_queue {
+    long type;                     // 消息类型
+    msg_node_t *head;              // 队首
+    msg_node_t *tail;              // 队尾
+    uint32_t count;                // 子队列中的消息数
+    struct msg_type_queue *next;   // 哈希链或空闲链
+} msg_type_queue_t;
+
+#define MSGQ_TYPE_BUCKETS  16      // 类型子队列哈希桶数
+#define MSGQ_BATCH_MAX     64      // 复制方式批量收发每次持锁的最大条数
+#define MSGQ_PRIO_LEVELS   32      // 优先级数（0最低，31最高）
+
+// 消息队列创建标志
+#define MSGQ_DEADLINE      0x01    // 按截止时间（最早者优先）而非优先级投递
+
 // 消息队列结构
 typedef struct msg_queue {
+    ipc_object_t obj;          // 引用计数（首字段）
     ipc_perm_t perm;           // 权限
+    key_t key;                 // 键
+    int id;                    // 句柄
     uint32_t msg_count;        // 消息数量
-    uint32_t max_msgs;         // 最大消息数
-    uint32_t max_size;         // 最大消息大小
-    uint8_t *buffer;           // 消息缓冲区
-    uint32_t head;             // 队列头
-    uint32_t tail;             // 队列尾
+    uint32_t max_msgs;         // 最大消息数（消息块数）
+    uint32_t max_size;         // 最大消息大小（含msg_t头）
+    uint8_t *storage;          // 消息块存储区
+    mempool_t pool;            // 消息块池，发送方分配、接收方释放
+    uint32_t flags;            // 创建标志（MSGQ_DEADLINE）
+    uint32_t prio_map;         // 非空优先级位图
+    msg_node_t *head[MSGQ_PRIO_LEVELS]; // 各优先级队首
+    msg_node_t *tail[MSGQ_PRIO_LEVELS]; // 各优先级队尾
+    msg_node_t **heap;         // 截止时间小顶堆（MSGQ_DEADLINE）
+    uint32_t seq;              // 到达序号
+    msg_type_queue_t *types[MSGQ_TYPE_BUCKETS]; // 类型子队列哈希表
+    msg_type_queue_t *free_types; // 空闲子队列（共max_msgs个，同时存在的类型数不超过消息数）
+    msg_type_queue_t *type_storage; // 子队列存储区
+    bool deleted;              // 已删除，等待中的接收者返回
     mutex_t lock;              // 互斥锁
-    condition_t not_full;      // 非满条件变量
     condition_t not_empty;     // 非空条件变量
-    struct msg_queue *next;    // 链表下一个节点
 } msg_queue_t;
 
 // 共享内存段结构
 typedef struct shm_segment {
+    ipc_object_t obj;          // 引用计数（首字段）
     ipc_perm_t perm;           // 权限
+    key_t key;                 // 键
+    int id;                    // 句柄
     uint32_t size;             // 段大小
-    void *addr;                // 映射地址
-    uint32_t ref_count;        // 引用计数
+    void *phys_addr;           // 段内存（物理连续）
+    uint32_t ref_count;        // 附加次数
     mutex_t lock;              // 互斥锁
-    struct shm_segment *next;  // 链表下一个节点
 } shm_segment_t;
 
-// 管道结构
+// 管道缓冲区类型
+typedef enum {
+    PIPE_BUF_ANON,             // 管道自有的匿名页，可追加写入
+    PIPE_BUF_FILE,             // 固定的文件页缓存（splice），读完后解除固定
+    PIPE_BUF_USER              // 调用者的缓冲区（vmsplice），读完后交还
+} pipe_buf_type_t;
+
+// 管道缓冲区：一页（或调用者缓冲区）中的一段有效数据
+typedef struct pipe_buf {
+    uint8_t *page;             // 页（缓冲区）首地址
+    uint32_t offset;           // 有效数据起始偏移
+    uint32_t len;              // 有效数据长度
+    pipe_buf_type_t type;
+    union {
+        struct {
+            uint32_t ino;      // 文件页的inode号与页号
+            uint32_t pgoff;
+        } file;
+        struct {
+            void (*release)(void *buf, void *arg);
+            void *arg;
+        } user;
+    };
+} pipe_buf_t;
+
+// 管道结构：缓冲区槽组成的环，槽数为2的幂，容量按页计
 typedef struct pipe {
-    uint8_t *buffer;           // 缓冲区
-    uint32_t size;             // 缓冲区大小
-    uint32_t read_pos;         // 读位置
-    uint32_t write_pos;        // 写位置
+    ipc_object_t obj;          // 引用计数（首字段，读端、写端句柄各持有一个）
+    pipe_buf_t *bufs;          // 缓冲区槽
+    uint32_t nr_bufs;          // 槽数
+    uint32_t head;             // 写入槽序号（单调递增）
+    uint32_t tail;             // 读取槽序号
+    uint32_t size;             // 容量（字节，nr_bufs页）
     uint32_t count;            // 数据计数
+    uint8_t *spare;            // 读完后留用的一个匿名页，避免反复分配
     mutex_t lock;              // 互斥锁
     condition_t not_full;      // 非满条件变量
     condition_t not_empty;     // 非空条件变量
     bool reader_closed;        // 读端关闭标志
     bool writer_closed;        // 写端关闭标志
-    struct pipe *next;         // 链表下一个节点
+    int read_fd;               // 读端句柄
+    int write_fd;              // 写端句柄
 } pipe_t;
 
+// 环形队列阻塞等待：等待者计数非零时入队/出队方才释放信号量，无人等待时快路径不触碰信号量；
+// semaphore_post只关中断，中断上下文的生产者也可唤醒阻塞的消费者
+typedef struct ring_waitq {
+    volatile uint32_t waiters;     // 阻塞等待的任务数
+    semaphore_t sem;               // 唤醒计数（只作提示，等待者醒来后重新检查队列）
+} ring_waitq_t;
+
+// 单生产者单消费者环形队列（无等待）：生产者只写tail，消费者只写head，
+// 两者各占一个缓存行，并缓存对方索引以减少跨核读取
+typedef struct spsc_ring {
+    uint8_t *buffer;               // 元素存储区（capacity * elem_size）
+    uint32_t mask;                 // capacity - 1，容量为2的幂
+    uint32_t elem_size;            // 元素大小
+    const char *name;
+
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // 写入位置（单调递增）
+    uint32_t head_cache;           // 生产者缓存的读取位置
+
+    volatile uint32_t head __attribute__((aligned(CACHE_LINE_SIZE))); // 读取位置（单调递增）
+    uint32_t tail_cache;           // 消费者缓存的写入位置
+
+    ring_waitq_t not_empty __attribute__((aligned(CACHE_LINE_SIZE)));
+    ring_waitq_t not_full;
+} spsc_ring_t;
+
+// 有界多生产者多消费者环形队列（Vyukov）：每个槽位带序号，
+// 生产者/消费者通过CAS认领tail/head后独占槽位，再以序号发布
+typedef struct mpmc_ring {
+    uint8_t *cells;                // 槽位存储区（capacity * cell_size）
+    uint32_t mask;                 // capacity - 1，容量为2的幂
+    uint32_t elem_size;            // 元素大小
+    uint32_t cell_size;            // 槽位大小（序号 + 元素，8字节对齐）
+    const char *name;
+
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // 入队认领位置
+    volatile uint32_t head __attribute__((aligned(CACHE_LINE_SIZE))); // 出队认领位置
+
+    ring_waitq_t not_empty __attribute__((aligned(CACHE_LINE_SIZE)));
+    ring_waitq_t not_full;
+} mpmc_ring_t;
+
+// 环形队列静态存储
+#define SPSC_RING_STORAGE(name, elem_size, capacity) \
+    static uint8_t name[(elem_size) * (capacity)] __attribute__((aligned(CACHE_LINE_SIZE)))
+#define MPMC_RING_CELL_SIZE(elem_size)  ((sizeof(uint32_t) + (elem_size) + 7) / 8 * 8)
+#define MPMC_RING_STORAGE(name, elem_size, capacity) \
+    static uint8_t name[MPMC_RING_CELL_SIZE(elem_size) * (capacity)] __attribute__((aligned(CACHE_LINE_SIZE)))
+
 // IPC 统计信息
 typedef struct {
     uint32_t msg_queues;       // 消息队列数量
@@ -79,11 +237,44 @@ typedef struct {
     uint32_t pipe_reads;       // 管道读取次数
 } ipc_stats_t;
 
+extern ipc_stats_t ipc_stats;
+
+// 句柄表函数
+int ipc_table_init(ipc_table_t *table, uint32_t capacity);
+int ipc_handle_alloc(ipc_table_t *table, key_t key, void *obj);
+void *ipc_handle_get(ipc_table_t *table, int handle);
+bool ipc_handle_put(void *obj);
+int ipc_handle_lookup(ipc_table_t *table, key_t key);
+void *ipc_handle_free(ipc_table_t *table, int handle);
+void *ipc_handle_next(ipc_table_t *table, uint32_t *pos);
+
 // 消息队列函数
 int msgq_create(key_t key, uint32_t max_msgs, uint32_t max_size);
+int msgq_create_ex(key_t key, uint32_t max_msgs, uint32_t max_size, uint32_t flags);
 int msgq_open(key_t key);
 int msgq_send(int mqid, const msg_t *msg, uint32_t size, uint32_t timeout);
 int msgq_receive(int mqid, msg_t *msg, uint32_t size, long type, uint32_t timeout);
+
+// 按优先级发送：type为0的接收总是取最高优先级（截止时间队列中为最早截止）的消息，同级先进先出；
+// 按类型接收仍取该类型最早到达的消息。prio为0~MSGQ_PRIO_LEVELS-1，截止时间队列中为绝对截止tick；
+// 普通发送使用优先级0，截止时间队列中视为无截止时间
+int msgq_send_prio(int mqid, const msg_t *msg, uint32_t size, uint32_t prio, uint32_t timeout);
+int msgq_post_prio(int mqid, msg_t *msg, uint32_t prio);
+
+// 零拷贝收发：发送方从队列的块池分配消息并填充后投递指针，接收方取得指针，用完后释放
+msg_t *msgq_alloc(int mqid, uint32_t size, uint32_t timeout);
+int msgq_post(int mqid, msg_t *msg);
+msg_t *msgq_receive_ref(int mqid, long type, uint32_t timeout);
+void msgq_release(int mqid, msg_t *msg);
+
+// 批量收发：一次持锁投递/取出多条消息，只唤醒一次；消息按size间隔连续存放，返回实际条数，失败返回-1。
+// 批量接收等待到至少min_count条符合类型的消息或超时，然后最多取max_count条（超时时取已有的）
+int msgq_post_batch(int mqid, msg_t **msgs, uint32_t count);
+int msgq_send_batch(int mqid, const void *msgs, uint32_t size, uint32_t count, uint32_t timeout);
+int msgq_receive_ref_batch(int mqid, msg_t **msgs, uint32_t max_count, uint32_t min_count,
+                           long type, uint32_t timeout);
+int msgq_receive_batch(int mqid, void *msgs, uint32_t size, uint32_t max_count, uint32_t min_count,
+                       long type, uint32_t timeout);
 int msgq_close(int mqid);
 int msgq_delete(int mqid);
 
@@ -101,6 +292,39 @@ int pipe_write(int fd, const void *buf, uint32_t count);
 int pipe_read(int fd, void *buf, uint32_t count);
 int pipe_close(int fd);
 
+// 管道容量（按页取整为2的幂），缩小时不能小于已占用的缓冲区数
+int pipe_create_size(int pipefd[2], uint32_t size);
+int pipe_set_size(int fd, uint32_t size);
+int pipe_get_size(int fd);
+
+// 零拷贝传输：文件页缓存、调用者缓冲区直接挂入管道，管道页直接写往文件或套接字；
+// 返回传输的字节数，失败返回-1
+int pipe_vmsplice(int fd, void *buf, uint32_t len, void (*release)(void *buf, void *arg), void *arg);
+int pipe_splice_from_file(int fd_in, uint32_t *offset, int pipe_fd, uint32_t len);
+int pipe_splice_to_file(int pipe_fd, int fd_out, uint32_t len);
+int pipe_splice_from_socket(int sock, int pipe_fd, uint32_t len);
+int pipe_splice_to_socket(int pipe_fd, int sock, uint32_t len);
+
+// 环形队列函数：非阻塞接口可在中断上下文和任意核上调用，返回实际入队/出队的元素数；
+// _wait接口仅限任务上下文，timeout_ms为0表示不等待
+int spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity, uint32_t elem_size, const char *name);
+bool spsc_ring_enqueue(spsc_ring_t *ring, const void *elem);
+bool spsc_ring_dequeue(spsc_ring_t *ring, void *elem);
+uint32_t spsc_ring_enqueue_batch(spsc_ring_t *ring, const void *elems, uint32_t n);
+uint32_t spsc_ring_dequeue_batch(spsc_ring_t *ring, void *elems, uint32_t n);
+uint32_t spsc_ring_enqueue_wait(spsc_ring_t *ring, const void *elems, uint32_t n, uint32_t timeout_ms);
+uint32_t spsc_ring_dequeue_wait(spsc_ring_t *ring, void *elems, uint32_t n, uint32_t timeout_ms);
+uint32_t spsc_ring_count(spsc_ring_t *ring);
+
+int mpmc_ring_init(mpmc_ring_t *ring, void *cells, uint32_t capacity, uint32_t elem_size, const char *name);
+bool mpmc_ring_enqueue(mpmc_ring_t *ring, const void *elem);
+bool mpmc_ring_dequeue(mpmc_ring_t *ring, void *elem);
+uint32_t mpmc_ring_enqueue_batch(mpmc_ring_t *ring, const void *elems, uint32_t n);
+uint32_t mpmc_ring_dequeue_batch(mpmc_ring_t *ring, void *elems, uint32_t n);
+uint32_t mpmc_ring_enqueue_wait(mpmc_ring_t *ring, const void *elems, uint32_t n, uint32_t timeout_ms);
+uint32_t mpmc_ring_dequeue_wait(mpmc_ring_t *ring, void *elems, uint32_t n, uint32_t timeout_ms);
+uint32_t mpmc_ring_count(mpmc_ring_t *ring);
+
 // IPC 控制函数
 int ipc_get_stats(ipc_stats_t *stats);
 void ipc_reset_stats(void);
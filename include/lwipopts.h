@@ -31,6 +31,7 @@
 // PBUF配置
 #define PBUF_POOL_SIZE            16
 #define PBUF_POOL_BUFSIZE         1524
+#define LWIP_SUPPORT_CUSTOM_PBUF  1    // 以太网接收零拷贝：pbuf直接引用DMA接收缓冲区
 
 // ARP配置
 #define LWIP_ARP                  1
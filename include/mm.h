@@ -3,23 +3,42 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "mmu.h"
+#include "sync.h"
+#include "rbtree.h"
+
+struct task_struct;
 
 // 内存页大小
 #define PAGE_SIZE           4096
 #define PAGE_SHIFT         12
 #define PAGE_MASK          (~(PAGE_SIZE - 1))
 
+// Cortex-A7 数据缓存行大小
+#define CACHE_LINE_SIZE    64
+
 // 内存保护标志
 #define PROT_NONE          0x0     // 页面不可访问
 #define PROT_READ          0x1     // 页面可读
 #define PROT_WRITE         0x2     // 页面可写
 #define PROT_EXEC          0x4     // 页面可执行
+#define PROT_MT(t)         ((t) << 8)  // 内存类型（mmu_mem_type_t，如MMU_MT_WRITE_COMBINE），默认写回缓存；仅物理映射可用
+#define PROT_MT_MASK       (7 << 8)
 
 // 内存映射标志
 #define MAP_PRIVATE        0x01    // 私有映射
 #define MAP_SHARED         0x02    // 共享映射
 #define MAP_FIXED          0x04    // 固定地址映射
 #define MAP_ANONYMOUS      0x08    // 匿名映射
+#define MAP_PHYS           0x10    // 物理连续区域映射（建立时一次性映射，不换出，复制地址空间时共享）
+
+// 缺页错误码
+#define FAULT_PRESENT      0x01    // 页面存在（保护错误）
+#define FAULT_WRITE        0x02    // 写访问
+#define FAULT_EXEC         0x04    // 取指访问
+#define FAULT_ACCESS_FLAG  0x08    // 访问标志错误
+#define FAULT_PERMISSION   0x10    // 权限错误
 
 // 页面状态
 typedef enum {
@@ -57,13 +76,24 @@ typedef struct vm_area {
     uint32_t start;        // 起始地址
     uint32_t end;          // 结束地址
     uint32_t flags;        // 访问权限
-    struct vm_area *next;  // 下一个区域
+    uint32_t map_flags;    // 映射标志（MAP_SHARED等）
+    uint32_t ino;          // 映射文件的inode号，0表示匿名映射
+    uint32_t pgoff;        // start对应的文件页号
+    uint32_t phys;         // MAP_PHYS映射中start对应的物理地址
+    uint32_t ra_next;      // 顺序访问时预期的下一个缺页文件页号
+    uint32_t ra_window;    // 当前预读窗口（页），0表示随机访问
+    rb_node_t vm_rb;       // 按起始地址排序的红黑树节点
+    struct vm_area *next;  // 下一个区域（按地址排序）
 } vm_area_t;
 
 // 内存描述符
-typedef struct {
+typedef struct mm_struct {
     pde_t *pgd;           // 页目录
+    uint32_t asid;        // 上下文标识：代数<<8 | ASID（TLB项按ASID区分，0表示未分配）
     vm_area_t *mmap;      // 虚拟内存区域链表
+    rb_root_t mm_rb;      // 虚拟内存区域红黑树
+    vm_area_t *mmap_cache;// 最近一次查找命中的区域
+    uint32_t map_count;   // 区域数
     uint32_t start_code;  // 代码段起始
     uint32_t end_code;    // 代码段结束
     uint32_t start_data;  // 数据段起始
@@ -87,29 +117,321 @@ typedef struct {
     uint32_t page_ins;        // 页面调入次数
     uint32_t page_outs;       // 页面换出次数
     uint32_t replaced_pages;  // 被替换页面数
+    uint32_t harvested;       // 扫描收集到的访问次数
 } pra_stats_t;
 
+// 伙伴分配器参数
+#define RAM_PAGES          (RAM_SIZE >> PAGE_SHIFT)
+#define MAX_ORDER          11                  // 阶数 0~10，最大块4MB
+#define DMA_ZONE_SIZE      (16 * SECTION_SIZE) // RAM低端16MB为DMA区
+
+// 分配标志
+#define GFP_KERNEL         0x00    // 普通分配，优先Normal区
+#define GFP_DMA            0x01    // 只从DMA区分配
+#define GFP_ZERO           0x02    // 分配后清零
+
+// 物理页标志
+#define PG_RESERVED        0x01    // 保留页（内核镜像、页表）
+#define PG_BUDDY           0x02    // 位于伙伴系统空闲链表
+#define PG_LRU             0x04    // 位于页面替换链表
+#define PG_ACTIVE          0x08    // 位于活跃链表
+#define PG_REFERENCED      0x10    // 上次扫描后被访问
+#define PG_DIRTY           0x20    // 页面内容已修改
+#define PG_SWAPCACHE       0x40    // 位于交换缓存
+#define PG_UNOWNED         0x80    // 写时复制共享后映射归属未知，暂不回收
+#define PG_WRITEBACK       0x100   // 已解除映射正在换出，尚未进入空闲链表
+
+// 物理页描述符（每个物理页一个，按页帧号索引）
+typedef struct page {
+    uint32_t flags;        // 页标志
+    uint32_t order;        // 块阶数（仅块首页有效）
+    struct page *next;     // 空闲链表/页面替换链表下一个
+    struct page *prev;     // 空闲链表/页面替换链表上一个
+    uint32_t vaddr;        // 映射的用户虚拟地址（页面替换使用）
+    mm_struct_t *mm;       // 映射所属的地址空间
+    uint32_t age;          // NFU老化计数
+    uint32_t swap_slot;    // 交换槽中仍有效的副本（0表示无）
+    uint32_t mapcount;     // 映射该页的页表项数（写时复制共享时大于1）
+} page_t;
+
+// 内存区域类型
+typedef enum {
+    ZONE_DMA = 0,
+    ZONE_NORMAL,
+    ZONE_COUNT
+} zone_type_t;
+
+// 内存区域统计信息
+typedef struct {
+    const char *name;              // 区域名称
+    uint32_t nr_pages;             // 总页数
+    uint32_t free_pages;           // 伙伴系统中的空闲页数
+    uint32_t pcp_pages;            // 每CPU缓存中的页数
+    uint32_t nr_free[MAX_ORDER];   // 各阶空闲块数量
+} zone_info_t;
+
+// 伙伴分配器函数
+void buddy_init(void);
+page_t *alloc_pages(uint32_t gfp, uint32_t order);
+void free_pages(page_t *page, uint32_t order);
+page_t *pfn_to_page(uint32_t pfn);
+page_t *virt_to_page(void *addr);
+void *page_to_virt(page_t *page);
+uint32_t pages_to_order(uint32_t count);
+void *mm_alloc_dma_pages(uint32_t count);
+int buddy_get_zone_info(zone_type_t type, zone_info_t *info);
+
 // 内存管理函数
 void mm_init(void);
+void mm_alloc_init(void);
 void *mm_alloc_pages(uint32_t count);
 void mm_free_pages(void *addr, uint32_t count);
 void *mm_alloc(size_t size);
+void *mm_alloc_tagged(size_t size, uint32_t caller);
+void *mm_realloc(void *addr, size_t size);
+void *mm_realloc_tagged(void *addr, size_t size, uint32_t caller);
+void *mm_alloc_aligned(size_t size, size_t align);
+void *mm_alloc_aligned_tagged(size_t size, size_t align, uint32_t caller);
 void mm_free(void *addr);
 
+// 全局堆接口（magazine缓存层的后端）
+void *mm_heap_alloc(size_t size);
+void mm_heap_free(void *addr);
+uint32_t mm_heap_alloc_batch(size_t size, void **objs, uint32_t count);
+void mm_heap_free_batch(void **objs, uint32_t count);
+size_t mm_heap_block_size(void *addr);
+
+// magazine缓存参数
+#define MAG_CLASS_COUNT    8       // 尺寸类数量：16B ~ 2KB
+#define MAG_MIN_SHIFT      4       // 最小尺寸类 16B
+#define MAG_MAX_SIZE       (1 << (MAG_MIN_SHIFT + MAG_CLASS_COUNT - 1))
+#define MAG_ROUNDS         32      // 每个magazine容纳的对象数
+#define MAG_BATCH          (MAG_ROUNDS / 2) // 批量补充/回收数量
+
+// magazine缓存统计信息
+typedef struct {
+    uint32_t hits;            // 缓存命中次数
+    uint32_t refills;         // 批量补充次数
+    uint32_t flushes;         // 批量回收次数
+    uint32_t cached_objs;     // 当前缓存的对象数
+} mag_stats_t;
+
+// 堆统计尺寸类：各magazine尺寸类加一个大对象类
+#define MM_STAT_CLASSES    (MAG_CLASS_COUNT + 1)
+
+// 堆统计信息
+typedef struct {
+    uint32_t heap_size;                    // 堆总大小
+    uint32_t bytes_in_use;                 // 已分配字节数
+    uint32_t peak_in_use;                  // 已分配字节峰值
+    uint32_t free_bytes;                   // 堆中空闲字节数
+    uint32_t free_blocks;                  // 空闲块数量
+    uint32_t largest_free;                 // 最大空闲块
+    uint32_t fragmentation;                // 碎片率（百分比）
+    uint32_t alloc_count;                  // 累计分配次数
+    uint32_t free_count;                   // 累计释放次数
+    uint32_t failed_allocs;                // 分配失败次数
+    uint32_t magazine_cached;              // magazine中缓存的对象数
+    uint32_t class_live[MM_STAT_CLASSES];  // 各尺寸类存活对象数
+} mm_stats_t;
+
+// 任务私有缓存（每个尺寸类一个magazine）
+struct mm_task_cache;
+
+// magazine缓存函数
+void mm_magazine_init(void);
+void *mm_magazine_alloc(size_t size);
+bool mm_magazine_free(void *addr);
+void mm_magazine_drain(void);
+void mm_magazine_get_stats(mag_stats_t *stats);
+int mm_task_cache_enable(struct task_struct *task);
+void mm_task_cache_release(struct task_struct *task);
+
+// slab缓存标志
+#define SLAB_HWCACHE_ALIGN 0x01    // 对象按缓存行对齐
+
+// slab缓存统计信息
+typedef struct {
+    uint32_t active_objs;     // 已分配对象数
+    uint32_t peak_objs;       // 已分配对象峰值
+    uint32_t total_objs;      // 所有slab中的对象总数
+    uint32_t slabs;           // slab数量
+    uint32_t allocs;          // 分配次数
+    uint32_t frees;           // 释放次数
+    uint32_t grows;           // slab增长次数
+    uint32_t failures;        // 分配失败次数
+    uint32_t reclaimed_pages; // 回收的页数
+} kmem_cache_stats_t;
+
+typedef struct kmem_cache kmem_cache_t;
+
+// slab分配器函数
+void kmem_cache_init(void);
+kmem_cache_t *kmem_cache_create(const char *name, uint32_t size, uint32_t align,
+                                uint32_t flags, void (*ctor)(void *obj));
+int kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+uint32_t kmem_cache_shrink(kmem_cache_t *cache);
+uint32_t kmem_cache_reap(void);
+void kmem_cache_get_stats(kmem_cache_t *cache, kmem_cache_stats_t *stats);
+const char *kmem_cache_name(kmem_cache_t *cache);
+
+// 区域分配器（单一所有者使用，不加锁）
+#define ARENA_DEFAULT_PAGES 4      // 默认块大小16KB
+
+typedef struct arena arena_t;
+
+// 区域分配位置标记（用于嵌套作用域）
+typedef struct {
+    void *chunk;               // 标记时的当前块
+    uint32_t offset;           // 块内偏移
+    uint32_t used;             // 标记时的用户字节数
+} arena_mark_t;
+
+// 区域统计信息
+typedef struct {
+    uint32_t total_bytes;      // 占用的页总字节数
+    uint32_t used_bytes;       // 已分配给用户的字节数
+    uint32_t peak_bytes;       // 用户字节峰值
+} arena_stats_t;
+
+// 区域分配器函数
+arena_t *arena_create(uint32_t chunk_pages);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align);
+void *arena_zalloc(arena_t *arena, size_t size);
+char *arena_strdup(arena_t *arena, const char *str);
+arena_mark_t arena_save(arena_t *arena);
+void arena_restore(arena_t *arena, arena_mark_t mark);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
+void arena_get_stats(arena_t *arena, arena_stats_t *stats);
+arena_t *task_scratch_arena(void);
+void task_scratch_release(struct task_struct *task);
+
+// 固定块内存池（无锁分配/释放，可在中断上下文使用）
+typedef struct mempool {
+    volatile uint64_t free_head;   // 空闲链表头：低32位块地址，高32位ABA标签
+    uint8_t *base;                 // 块区起始地址
+    uint32_t block_size;           // 块大小（8字节对齐）
+    uint32_t block_count;          // 块总数
+    volatile uint32_t in_use;      // 已分配块数
+    volatile uint32_t high_water;  // 已分配块数峰值
+    volatile uint32_t alloc_failures; // 池空导致的分配失败次数
+    volatile uint32_t waiters;     // 阻塞等待的任务数
+    semaphore_t wait_sem;          // 唤醒计数（只作提示，等待者醒来后重新检查空闲链表）
+    const char *name;
+} mempool_t;
+
+// 内存池统计信息
+typedef struct {
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t in_use;
+    uint32_t high_water;
+    uint32_t alloc_failures;
+} mempool_stats_t;
+
+// 定义内存池的静态存储
+#define MEMPOOL_STORAGE(name, block_size, count) \
+    static uint8_t name[((block_size) + 7) / 8 * 8 * (count)] __attribute__((aligned(8)))
+
+// 内存池函数
+int mempool_init(mempool_t *pool, const char *name, void *buffer,
+                 uint32_t buffer_size, uint32_t block_size);
+void *mempool_alloc(mempool_t *pool);
+void mempool_free(mempool_t *pool, void *ptr);
+void *mempool_alloc_wait(mempool_t *pool, uint32_t timeout_ms);
+void mempool_get_stats(mempool_t *pool, mempool_stats_t *stats);
+
 // 虚拟内存管理函数
 int mm_map(void *addr, size_t length, int prot, int flags);
 int mm_unmap(void *addr, size_t length);
 int mm_protect(void *addr, size_t length, int prot);
+void page_fault_handler(uint32_t fault_addr, uint32_t error_code);
+pte_t *mmu_get_pte(uint32_t va);
+pte_t *mmu_pgd_get_pte(uint32_t *pgd, uint32_t va);
 void *mm_mmap(void *addr, size_t length, int prot, int flags);
+void *mm_mmap_file(void *addr, size_t length, int prot, int flags, int fd, uint32_t offset);
+void *mm_mmap_phys(void *addr, size_t length, int prot, int flags, uint32_t phys);
+int filemap_fault(mm_struct_t *mm, vm_area_t *vma, uint32_t va, uint32_t error_code);
+void mm_mmap_init(void);
+mm_struct_t *mm_create(void);
+void mm_switch(mm_struct_t *mm);
+mm_struct_t *mm_dup(mm_struct_t *old);
+
+// 虚拟内存区域管理
+void vma_cache_init(void);
+vm_area_t *vma_alloc(void);
+void vma_free(vm_area_t *vma);
+vm_area_t *vma_find(mm_struct_t *mm, uint32_t addr);
+vm_area_t *vma_lookup(mm_struct_t *mm, uint32_t addr);
+void vma_link(mm_struct_t *mm, vm_area_t *vma);
+void vma_unlink(mm_struct_t *mm, vm_area_t *vma);
+vm_area_t *vma_split(mm_struct_t *mm, vm_area_t *vma, uint32_t addr);
+vm_area_t *vma_merge(mm_struct_t *mm, vm_area_t *vma);
+void mm_destroy(mm_struct_t *mm);
 
 // 页面替换函数
 void pra_init(pra_type_t type);
 void *pra_alloc_page(void);
 void pra_free_page(void *addr);
+void pra_get_page(void *addr);
+void pra_put_page(void *addr, mm_struct_t *mm);
 void pra_access_page(void *addr);
+void pra_set_mapping(void *addr, mm_struct_t *mm, uint32_t vaddr);
+void pra_mark_dirty(void *addr);
+void pra_mark_clean(void *addr);
+void pra_tick(void);
+void pra_scanner_start(void);
+void pra_kswapd_start(void);
+void *pra_swapcache_get(uint32_t slot);
+int pra_writeback_begin(page_t *page, uint32_t slot);
+void pra_writeback_abort(page_t *page, uint32_t slot);
+
+// 交换统计信息
+typedef struct {
+    uint32_t total_slots;     // 交换槽总数
+    uint32_t used_slots;      // 已用交换槽
+    uint32_t swap_ins;        // 从交换区读入页数
+    uint32_t swap_outs;       // 写入交换区页数
+    uint32_t cache_hits;      // 交换缓存命中（免读盘）次数
+    uint32_t io_errors;       // 磁盘I/O错误次数
+} swap_stats_t;
+
+// 交换函数
+int swap_init(uint8_t pdrv, uint32_t start_sector, uint32_t nr_pages);
+int swap_out(page_t *page);
+void *swap_in(pte_t *pte);
+void swap_free(uint32_t slot);
+bool swap_cache_add(page_t *page);
+page_t *swap_cache_find(uint32_t slot);
+void swap_cache_del(page_t *page);
+void swap_get_stats(swap_stats_t *stats);
+
+// 压缩交换统计信息
+typedef struct {
+    uint32_t pages_stored;          // 已存储页数
+    uint32_t compr_bytes;           // 压缩数据占用字节数
+    uint32_t huge_pages;            // 不可压缩、整页存储的页数
+    uint32_t ratio;                 // 压缩比×100
+    uint32_t avg_compress_cycles;   // 平均压缩耗时（CPU周期）
+    uint32_t avg_decompress_cycles; // 平均解压耗时（CPU周期）
+    uint32_t failures;              // 存储失败次数
+} zram_stats_t;
+
+// 压缩交换函数
+int zram_init(uint32_t max_pages);
+uint32_t zram_reserve(void);
+int zram_store(uint32_t index, const void *src);
+int zram_load(uint32_t index, void *dst);
+void zram_free(uint32_t index);
+void zram_get_stats(zram_stats_t *stats);
 void pra_get_stats(pra_stats_t *stats);
 
 // 调试函数
+void mm_get_stats(mm_stats_t *stats);
 void mm_dump_stats(void);
 void mm_check_leaks(void);
 void mm_debug_info(void);
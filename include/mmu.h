@@ -2,11 +2,102 @@
 #define __MMU_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+// 内存布局
+#define SECTION_SIZE             0x100000    // 1MB
+#define PERIPH_BASE              0x10000000
+#define PERIPH_SIZE              (32 * SECTION_SIZE)  // 32MB
+#define RAM_BASE                 0x70000000
+#define RAM_SIZE                 (128 * SECTION_SIZE) // 128MB
+#define USER_SPACE_BASE          0x80000000
+#define USER_SPACE_SIZE          (256 * SECTION_SIZE) // 256MB
+
+// 页面映射权限
+#define MMU_PERM_READ            0x01
+#define MMU_PERM_WRITE           0x02
+#define MMU_PERM_EXEC            0x04
+#define MMU_PERM_USER            0x08        // 用户态可访问（用户空间地址自动带此权限）
+#define MMU_PERM_MT(t)           ((uint32_t)(t) << 8)  // 内存类型（mmu_mem_type_t）
+#define MMU_PERM_MT_MASK         (7 << 8)
+
+// 映射的内存类型，默认普通内存写回写分配
+typedef enum {
+    MMU_MT_NORMAL = 0,           // 普通内存，写回写分配
+    MMU_MT_NORMAL_WT,            // 普通内存，写通
+    MMU_MT_NORMAL_NC,            // 普通内存，不缓存（写合并）
+    MMU_MT_DEVICE,               // 设备内存
+    MMU_MT_STRONGLY_ORDERED      // 强序
+} mmu_mem_type_t;
+
+#define MMU_MT_WRITE_COMBINE     MMU_MT_NORMAL_NC
+
+// TEX remap属性表（SCTLR.TRE=1时页表项的TEX[0]:C:B作为索引），
+// 各索引按传统TEX/C/B编码的含义排列，开启重映射前后含义一致
+#define MMU_ATTR_SO              0           // 强序
+#define MMU_ATTR_DEVICE          1           // 设备（S=1时为共享设备）
+#define MMU_ATTR_NORMAL_WT       2           // 内外写通
+#define MMU_ATTR_NORMAL_WB       3           // 内外写回写分配
+#define MMU_ATTR_NORMAL_NC       4           // 内外不缓存
+
+// PRRR：TRn为索引n的内存类型（0强序、1设备、2普通），DS1/NS1使S=1的设备与普通内存为共享
+#define MMU_PRRR_TR(n, t)        ((uint32_t)(t) << (2 * (n)))
+#define MMU_PRRR                 (MMU_PRRR_TR(MMU_ATTR_SO, 0) | MMU_PRRR_TR(MMU_ATTR_DEVICE, 1) | \
+                                  MMU_PRRR_TR(MMU_ATTR_NORMAL_WT, 2) | MMU_PRRR_TR(MMU_ATTR_NORMAL_WB, 2) | \
+                                  MMU_PRRR_TR(MMU_ATTR_NORMAL_NC, 2) | (1 << 17) | (1 << 19))
+
+// NMRR：普通内存的内/外缓存策略（0不缓存、1写回写分配、2写通、3写回不写分配）
+#define MMU_NMRR_RGN(n, c)       (((uint32_t)(c) << (2 * (n))) | ((uint32_t)(c) << (2 * (n) + 16)))
+#define MMU_NMRR                 (MMU_NMRR_RGN(MMU_ATTR_NORMAL_WT, 2) | MMU_NMRR_RGN(MMU_ATTR_NORMAL_WB, 1) | \
+                                  MMU_NMRR_RGN(MMU_ATTR_NORMAL_NC, 0))
+
+// TLB维护批处理：批处理期间的页表修改只记录待失效范围，结束时统一失效
+typedef struct mmu_batch {
+    uint32_t start;              // 待失效范围起始
+    uint32_t end;                // 待失效范围结束（0表示无）
+    struct mmu_batch *prev;      // 外层批处理
+} mmu_batch_t;
 
 void mmu_init(void);
 void mmu_enable(void);
 void mmu_disable(void);
 void mmu_map_section(uint32_t va, uint32_t pa, uint32_t flags);
+uint32_t mmu_virt_to_phys(uint32_t va);
+
+// 访问/脏位跟踪（基于SCTLR.AFE访问标志与写保护）
+bool mmu_test_and_clear_accessed(uint32_t va);
+bool mmu_set_accessed(uint32_t va);
+bool mmu_is_writable(uint32_t va);
+bool mmu_write_enable(uint32_t va);
+bool mmu_write_protect(uint32_t va);
+
+// 二级页表映射（4KB小页与64KB大页）
+int mmu_map_page(uint32_t va, uint32_t pa, uint32_t prot);
+int mmu_map_large_page(uint32_t va, uint32_t pa, uint32_t prot);
+void mmu_unmap_page(uint32_t va);
+int mmu_update_prot(uint32_t va, uint32_t prot);
+
+// 物理连续区域映射：自动选择16MB超级段、1MB段、64KB大页或4KB小页
+int mmu_map_range(uint32_t va, uint32_t pa, uint32_t size, uint32_t prot);
+void mmu_unmap_range(uint32_t va, uint32_t size);
+void mmu_batch_begin(mmu_batch_t *batch);
+void mmu_batch_flush(mmu_batch_t *batch);
+void mmu_batch_end(mmu_batch_t *batch);
+
+// 地址空间页表与ASID
+void mmu_asid_free(uint32_t asid);
+void mmu_switch_mm(uint32_t *pgd, uint32_t *context);
+uint32_t *mmu_pgd_alloc(void);
+void mmu_pgd_free(uint32_t *pgd);
+int mmu_pgd_copy_pte(uint32_t *dst_pgd, uint32_t va, bool wrprotect);
+uint32_t mmu_pgd_virt_to_phys(uint32_t *pgd, uint32_t va);
+
+// 指定地址空间的操作（页面回收在其他任务上下文中进行）
+int mmu_pgd_map_page(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t pa, uint32_t prot);
+void mmu_pgd_unmap_page(uint32_t *pgd, uint32_t asid, uint32_t va);
+bool mmu_pgd_test_and_clear_accessed(uint32_t *pgd, uint32_t asid, uint32_t va);
+int mmu_pgd_map_range(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t pa, uint32_t size, uint32_t prot);
+void mmu_pgd_unmap_range(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t size);
 
 // MMU 标志位定义
 #define MMU_FLAG_CACHED      (1 << 3)
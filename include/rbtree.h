@@ -0,0 +1,40 @@
+#ifndef __RBTREE_H__
+#define __RBTREE_H__
+
+#include <stddef.h>
+
+#ifndef container_of
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+// 红黑树节点结构
+typedef struct rb_node {
+    unsigned long rb_parent_color;
+    struct rb_node *rb_right;
+    struct rb_node *rb_left;
+} rb_node_t;
+
+// 红黑树根节点
+typedef struct rb_root {
+    struct rb_node *rb_node;
+} rb_root_t;
+
+// 将新节点挂到查找得到的位置，随后调用rb_insert_color重新平衡
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **link)
+{
+    node->rb_parent_color = (unsigned long)parent;
+    node->rb_left = node->rb_right = NULL;
+    *link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+#endif
@@ -60,16 +60,19 @@ void scheduler_yield(void);
 task_t *scheduler_next_task(void);
 
 // 实时调度函数
+void scheduler_rt_init(void);
 void scheduler_set_realtime_params(task_t *task, realtime_params_t *params);
 int scheduler_check_schedulability(void);
 void scheduler_update_deadlines(void);
 
 // 公平调度函数
+void scheduler_fair_init(void);
 void scheduler_update_vruntime(task_t *task);
 void scheduler_set_weight(task_t *task, uint32_t weight);
 uint64_t scheduler_min_vruntime(void);
 
 // MLFQ函数
+void scheduler_mlfq_init(void);
 void scheduler_mlfq_boost(void);
 void scheduler_mlfq_update_queue(task_t *task);
 void scheduler_mlfq_init_task(task_t *task);
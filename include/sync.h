@@ -59,6 +59,7 @@ void recursive_mutex_unlock(mutex_t *mutex);
 // 信号量函数
 void semaphore_init(semaphore_t *sem, int32_t initial_count, const char *name);
 void semaphore_wait(semaphore_t *sem);
+bool semaphore_timedwait(semaphore_t *sem, uint32_t timeout_ms);
 bool semaphore_trywait(semaphore_t *sem);
 void semaphore_post(semaphore_t *sem);
 int32_t semaphore_get_count(semaphore_t *sem);
@@ -2,6 +2,7 @@
 #define __TASK_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 
 // 任务状态定义
 typedef enum {
@@ -52,12 +53,18 @@ typedef struct task_struct {
     uint32_t ticks_remaining;         // 剩余时间片
     uint32_t total_ticks;             // 总运行时间
     char name[32];                    // 任务名称
+    struct mm_struct *mm;             // 用户地址空间（内核任务为NULL）
+    struct mmu_batch *tlb_batch;      // 进行中的TLB批处理
+    struct mm_task_cache *mm_cache;   // 任务私有内存缓存（可选）
+    struct arena *scratch;            // 任务临时区域分配器（按需创建）
     struct task_struct *next;         // 链表下一个节点
 } task_t;
 
 // 任务管理函数
 void task_init(void);
 task_t *task_create(const char *name, void (*entry)(void), uint8_t priority, uint32_t stack_size);
+task_t *task_create_user(const char *name, void (*entry)(void), uint8_t priority, uint32_t stack_size);
+task_t *task_clone(const char *name, void (*entry)(void), uint8_t priority, uint32_t stack_size);
 void task_delete(task_t *task);
 void task_suspend(task_t *task);
 void task_resume(task_t *task);
@@ -67,9 +74,22 @@ void task_set_priority(task_t *task, uint8_t priority);
 task_t *task_get_current(void);
 void task_schedule(void);
 
+// 抢占控制函数
+void preempt_disable(void);
+void preempt_enable(void);
+uint32_t preempt_count(void);
+
 // 系统任务相关常量
 #define MAX_TASKS           32
 #define DEFAULT_STACK_SIZE  4096
 #define IDLE_TASK_STACK_SIZE 1024
+#define MAX_CPUS            4
+
+// 获取当前CPU编号（MPIDR.Aff0）
+static inline uint32_t smp_processor_id(void) {
+    uint32_t mpidr;
+    __asm__ volatile ("mrc p15, 0, %0, c0, c0, 5" : "=r" (mpidr));
+    return mpidr & 0x3;
+}
 
 #endif 
\ No newline at end of file
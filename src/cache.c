@@ -0,0 +1,120 @@
+#include "cache.h"
+#include "mmu.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// 指令缓存整体失效比逐行失效更快的范围
+#define ICACHE_INV_ALL_THRESHOLD  (32 * 1024)
+
+static uint32_t dcache_line;
+static uint32_t icache_line;
+
+// 从CTR读取最小缓存行大小（DminLine/IminLine为以字为单位的log2值）
+static void cache_probe(void) {
+    uint32_t ctr;
+    __asm__ volatile ("mrc p15, 0, %0, c0, c0, 1" : "=r" (ctr));
+
+    dcache_line = 4u << ((ctr >> 16) & 0xF);
+    icache_line = 4u << (ctr & 0xF);
+}
+
+// 数据缓存行大小
+uint32_t cache_line_size(void) {
+    if (!dcache_line) cache_probe();
+    return dcache_line;
+}
+
+// 清理范围内的数据缓存行到一致性点，设备可以读到CPU写入的数据
+void dcache_clean_range(const void *addr, uint32_t size) {
+    uint32_t line = cache_line_size();
+    uint32_t start = (uint32_t)addr & ~(line - 1);
+    uint32_t end = (uint32_t)addr + size;
+
+    for (uint32_t mva = start; mva < end; mva += line) {
+        __asm__ volatile ("mcr p15, 0, %0, c7, c10, 1" : : "r" (mva));
+    }
+    __asm__ volatile ("dsb" ::: "memory");
+}
+
+// 清理并使范围内的数据缓存行无效
+void dcache_flush_range(const void *addr, uint32_t size) {
+    uint32_t line = cache_line_size();
+    uint32_t start = (uint32_t)addr & ~(line - 1);
+    uint32_t end = (uint32_t)addr + size;
+
+    for (uint32_t mva = start; mva < end; mva += line) {
+        __asm__ volatile ("mcr p15, 0, %0, c7, c14, 1" : : "r" (mva));
+    }
+    __asm__ volatile ("dsb" ::: "memory");
+}
+
+// 使范围内的数据缓存行无效，首尾未对齐的行与相邻数据共享，先清理再失效以免丢失相邻数据
+void dcache_inv_range(void *addr, uint32_t size) {
+    uint32_t line = cache_line_size();
+    uint32_t start = (uint32_t)addr;
+    uint32_t end = start + size;
+
+    if (start & (line - 1)) {
+        start &= ~(line - 1);
+        __asm__ volatile ("mcr p15, 0, %0, c7, c14, 1" : : "r" (start));
+        start += line;
+    }
+    if ((end & (line - 1)) && end > start) {
+        end &= ~(line - 1);
+        __asm__ volatile ("mcr p15, 0, %0, c7, c14, 1" : : "r" (end));
+    }
+
+    for (uint32_t mva = start; mva < end; mva += line) {
+        __asm__ volatile ("mcr p15, 0, %0, c7, c6, 1" : : "r" (mva));
+    }
+    __asm__ volatile ("dsb" ::: "memory");
+}
+
+// 同步指令缓存：数据缓存清理到统一点（DCCMVAU）后使指令缓存与分支预测失效，
+// 范围较大时整体失效指令缓存（ICIALLUIS），仍只按范围清理数据缓存
+void icache_sync_range(const void *addr, uint32_t size) {
+    if (!dcache_line) cache_probe();
+
+    uint32_t start = (uint32_t)addr & ~(dcache_line - 1);
+    uint32_t end = (uint32_t)addr + size;
+
+    for (uint32_t mva = start; mva < end; mva += dcache_line) {
+        __asm__ volatile ("mcr p15, 0, %0, c7, c11, 1" : : "r" (mva));
+    }
+    __asm__ volatile ("dsb");
+
+    if (size >= ICACHE_INV_ALL_THRESHOLD) {
+        __asm__ volatile ("mcr p15, 0, %0, c7, c1, 0" : : "r" (0));
+    } else {
+        start = (uint32_t)addr & ~(icache_line - 1);
+        for (uint32_t mva = start; mva < end; mva += icache_line) {
+            __asm__ volatile ("mcr p15, 0, %0, c7, c5, 1" : : "r" (mva));
+        }
+    }
+    __asm__ volatile ("mcr p15, 0, %0, c7, c1, 6" : : "r" (0));
+    __asm__ volatile ("dsb\n" "isb" ::: "memory");
+}
+
+// 交给设备前的缓存维护：发送只需清理；接收只需失效（丢弃可能在传输期间被写回的脏行）；双向清理并失效
+uint32_t dma_map_single(void *addr, uint32_t size, dma_dir_t dir) {
+    switch (dir) {
+        case DMA_TO_DEVICE:
+            dcache_clean_range(addr, size);
+            break;
+        case DMA_FROM_DEVICE:
+            dcache_inv_range(addr, size);
+            break;
+        case DMA_BIDIRECTIONAL:
+            dcache_flush_range(addr, size);
+            break;
+    }
+
+    return mmu_virt_to_phys((uint32_t)addr);
+}
+
+// 设备完成后的缓存维护：发送无需处理；接收再次失效，丢弃传输期间推测预取的旧数据
+void dma_unmap_single(void *addr, uint32_t size, dma_dir_t dir) {
+    if (dir != DMA_TO_DEVICE) {
+        dcache_inv_range(addr, size);
+    }
+}
@@ -1,4 +1,5 @@
 #include "cjson.h"
+#include "mm.h"
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
@@ -8,6 +9,7 @@
 #include <ctype.h>
 
 static const char *global_ep = NULL;
+static kmem_cache_t *cjson_node_cache = NULL;
 
 /* Helper functions */
 static unsigned char* cJSON_strdup(const unsigned char* str)
@@ -21,10 +23,16 @@ static unsigned char* cJSON_strdup(const unsigned char* str)
     return copy;
 }
 
+/* Create the node cache */
+void cJSON_Init(void)
+{
+    cjson_node_cache = kmem_cache_create("cjson_node", sizeof(cJSON), 0, 0, NULL);
+}
+
 /* Internal constructor */
 static cJSON *cJSON_New_Item(void)
 {
-    cJSON* node = (cJSON*)malloc(sizeof(cJSON));
+    cJSON* node = (cJSON*)kmem_cache_alloc(cjson_node_cache);
     if (node) memset(node, 0, sizeof(cJSON));
     return node;
 }
@@ -39,7 +47,7 @@ void cJSON_Delete(cJSON *c)
         if (!(c->type & cJSON_IsReference) && c->child) cJSON_Delete(c->child);
         if (!(c->type & cJSON_IsReference) && c->valuestring) free(c->valuestring);
         if (!(c->type & cJSON_StringIsConst) && c->string) free(c->string);
-        free(c);
+        kmem_cache_free(cjson_node_cache, c);
         c = next;
     }
 }
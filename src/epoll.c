@@ -1,4 +1,5 @@
 #include "epoll.h"
+#include "mm.h"
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
@@ -9,6 +10,7 @@
 #define MAX_EPOLL_INSTANCES 1024
 static eventpoll_t *epoll_instances[MAX_EPOLL_INSTANCES];
 static pthread_mutex_t instance_lock = PTHREAD_MUTEX_INITIALIZER;
+static kmem_cache_t *epitem_cache;
 
 static int find_available_fd(void)
 {
@@ -36,6 +38,12 @@ int epoll_create(int size)
         return -1;
     }
 
+    pthread_mutex_lock(&instance_lock);
+    if (!epitem_cache) {
+        epitem_cache = kmem_cache_create("epitem", sizeof(epitem_t), 0, 0, NULL);
+    }
+    pthread_mutex_unlock(&instance_lock);
+
     eventpoll_t *ep = calloc(1, sizeof(eventpoll_t));
     if (!ep) {
         errno = ENOMEM;
@@ -112,11 +120,12 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
                 break;
             }
             
-            epi = calloc(1, sizeof(epitem_t));
+            epi = kmem_cache_alloc(epitem_cache);
             if (!epi) {
                 error = ENOMEM;
                 break;
             }
+            memset(epi, 0, sizeof(epitem_t));
             
             epi->fd = fd;
             epi->event = *event;
@@ -137,7 +146,7 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
                 break;
             }
             rb_erase(&epi->rbn, &ep->rbr);
-            free(epi);
+            kmem_cache_free(epitem_cache, epi);
             break;
 
         default:
@@ -220,7 +229,7 @@ void epoll_close(int epfd)
         while ((node = ep->rbr.rb_node)) {
             epitem_t *epi = container_of(node, epitem_t, rbn);
             rb_erase(node, &ep->rbr);
-            free(epi);
+            kmem_cache_free(epitem_cache, epi);
         }
 
         pthread_mutex_destroy(&ep->lock);
@@ -7,12 +7,42 @@
 #include "lwip/etharp.h"
 #include "netif/etharp.h"
 #include "ethernetif.h"
+#include "cache.h"
+#include "mm.h"
 #include <string.h>
 
+/*
+ * 以太网驱动（eth_*接口）不在本源码树中，下面的参数是对驱动的假设，
+ * 驱动头文件提供了对应定义时以驱动为准：
+ * - 每个接收缓冲区ETH_RX_BUFFER_SIZE字节，起始地址与长度按缓存行对齐；
+ * - eth_release_rx_buffer可以按任意顺序归还缓冲区（零拷贝时协议栈释放pbuf的顺序不定）；
+ * - 驱动接收环长度大于ETH_RX_ZC_PBUFS，协议栈积压数据时驱动仍有缓冲区可用。
+ */
+
+// 接收缓冲区大小（假设值：最大帧长，按缓存行对齐）
+#ifndef ETH_RX_BUFFER_SIZE
+#define ETH_RX_BUFFER_SIZE   1536
+#endif
+
+// 同时被协议栈持有的零拷贝接收缓冲区上限，超出时退回到复制方式
+#ifndef ETH_RX_ZC_PBUFS
+#define ETH_RX_ZC_PBUFS      8
+#endif
+
+// 引用驱动接收缓冲区的pbuf，释放时把缓冲区交还驱动
+typedef struct {
+    struct pbuf_custom pc;
+    uint8_t *buffer;
+} eth_rx_pbuf_t;
+
 // 网络接口状态
 static struct netif *active_netif = NULL;
 static uint8_t mac_addr[6] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
 
+// 零拷贝pbuf描述符池（无锁，接收中断与协议栈线程都可分配/释放）
+MEMPOOL_STORAGE(rx_pbuf_storage, sizeof(eth_rx_pbuf_t), ETH_RX_ZC_PBUFS);
+static mempool_t rx_pbuf_pool;
+
 // 初始化网络接口
 static err_t ethernetif_init(struct netif *netif)
 {
@@ -49,6 +79,9 @@ static void low_level_init(struct netif *netif)
     // 初始化以太网控制器
     eth_init();
 
+    mempool_init(&rx_pbuf_pool, "eth_rx_pbuf", rx_pbuf_storage, sizeof(rx_pbuf_storage),
+                 sizeof(eth_rx_pbuf_t));
+
     // 设置中断处理
     eth_set_rx_callback(ethernetif_input);
 }
@@ -72,6 +105,9 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
         len += q->len;
     }
 
+    // 发送缓冲区由驱动分配，缓存属性未知；按可缓存内存在交给DMA前清理，非缓存内存上只是多余的维护操作
+    dma_map_single(buffer, len, DMA_TO_DEVICE);
+
     // 发送数据包
     if (eth_send_packet(buffer, len) != 0) {
         return ERR_IF;
@@ -81,10 +117,40 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
     return ERR_OK;
 }
 
-// 接收数据包
+// 协议栈释放零拷贝pbuf：缓冲区重新交给DMA并归还驱动
+static void ethernetif_rx_free(struct pbuf *p)
+{
+    eth_rx_pbuf_t *rx = (eth_rx_pbuf_t *)p;
+
+    dma_map_single(rx->buffer, ETH_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
+    eth_release_rx_buffer(rx->buffer);
+    mempool_free(&rx_pbuf_pool, rx);
+}
+
+// 复制到PBUF_POOL（零拷贝描述符用尽时）
+static struct pbuf *ethernetif_rx_copy(uint8_t *buffer, uint16_t len)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+    if (p != NULL) {
+        struct pbuf *q;
+        uint16_t offset = 0;
+
+        for(q = p; q != NULL; q = q->next) {
+            memcpy(q->payload, buffer + offset, q->len);
+            offset += q->len;
+        }
+    }
+
+    dma_map_single(buffer, ETH_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
+    eth_release_rx_buffer(buffer);
+    return p;
+}
+
+// 接收数据包：pbuf直接引用DMA接收缓冲区，协议栈释放pbuf时缓冲区才归还驱动
 void ethernetif_input(struct netif *netif)
 {
-    struct pbuf *p;
+    struct pbuf *p = NULL;
+    eth_rx_pbuf_t *rx;
     uint16_t len;
     uint8_t *buffer;
 
@@ -94,28 +160,30 @@ void ethernetif_input(struct netif *netif)
         return;
     }
 
-    // 分配pbuf
-    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-    if (p != NULL) {
-        struct pbuf *q;
-        uint16_t offset = 0;
+    // 丢弃DMA期间推测预取的旧缓存行，CPU读取设备写入的数据
+    dma_unmap_single(buffer, len, DMA_FROM_DEVICE);
 
-        // 复制数据到pbuf
-        for(q = p; q != NULL; q = q->next) {
-            memcpy(q->payload, buffer + offset, q->len);
-            offset += q->len;
+    rx = mempool_alloc(&rx_pbuf_pool);
+    if (rx != NULL) {
+        rx->buffer = buffer;
+        rx->pc.custom_free_function = ethernetif_rx_free;
+        p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rx->pc, buffer, ETH_RX_BUFFER_SIZE);
+        if (p == NULL) {
+            mempool_free(&rx_pbuf_pool, rx);
         }
+    }
 
-        // 传递给协议栈
-        if (netif->input(p, netif) != ERR_OK) {
-            pbuf_free(p);
-        }
+    if (p == NULL) {
+        p = ethernetif_rx_copy(buffer, len);
+    }
+
+    // 传递给协议栈
+    if (p != NULL && netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
     }
 
-    // 释放接收缓冲区
-    eth_release_rx_buffer(buffer);
     LINK_STATS_INC(link.recv);
-} 
+}
 // 智能家居网关应用示例
 
 // 设备状态结构
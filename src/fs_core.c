@@ -1,6 +1,7 @@
 #include "fs.h"
 #include "device.h"
 #include "memory.h"
+#include "mm.h"
 #include <string.h>
 
 // 全局变量
@@ -9,6 +10,15 @@ static file_desc_t file_descs[MAX_OPEN_FILES];
 static cache_block_t *cache_head = NULL;
 static uint32_t cache_size = 0;
 static const uint32_t MAX_CACHE_BLOCKS = 1024;
+static kmem_cache_t *cache_block_cache;
+
+#define CACHE_HASH_SIZE 256    // 缓存哈希桶数（2的幂）
+static cache_block_t *cache_hash[CACHE_HASH_SIZE];
+
+// 文件页查找方式
+#define PAGE_LOAD       0      // 未命中则从设备读入
+#define PAGE_CACHED     1      // 数据块只查缓存（页已固定），inode和间接块按需读入
+#define PAGE_NOIO       2      // inode、间接块和数据块都只查缓存，不发起I/O
 
 // 初始化文件系统
 int fs_init(void) {
@@ -21,6 +31,8 @@ int fs_init(void) {
     // 初始化缓存
     cache_head = NULL;
     cache_size = 0;
+    memset(cache_hash, 0, sizeof(cache_hash));
+    cache_block_cache = kmem_cache_create("cache_block", sizeof(cache_block_t), 0, 0, NULL);
     
     return 0;
 }
@@ -54,56 +66,154 @@ static mount_point_t *find_mount_point(const char *path) {
     return found;
 }
 
-// 读取块数据
-static int read_block(mount_point_t *mp, uint32_t block_no, void *buffer) {
-    // 首先查找缓存
-    cache_block_t *cache = cache_get_block(block_no);
-    if (cache) {
-        memcpy(buffer, cache->data, BLOCK_SIZE);
-        return 0;
+// 查找inode所在的挂载点（inode号不含设备信息，取第一个容纳该inode号的文件系统）
+static mount_point_t *find_mount_point_by_inode(uint32_t inode_no) {
+    for (int i = 0; i < MAX_MOUNT_POINTS; i++) {
+        if (mount_points[i].mounted && inode_no >= 1 &&
+            inode_no <= mount_points[i].sb->inodes_count) {
+            return &mount_points[i];
+        }
     }
     
-    // 从设备读取
-    if (device_read(mp->device, block_no * BLOCK_SIZE, buffer, BLOCK_SIZE) != BLOCK_SIZE) {
-        return -1;
+    return NULL;
+}
+
+static inline uint32_t cache_hashfn(uint32_t block_no) {
+    return (block_no * 2654435761u) & (CACHE_HASH_SIZE - 1);
+}
+
+// 查找缓存块，命中时移到链表头（最近使用）
+cache_block_t *cache_get_block(uint32_t block_no) {
+    cache_block_t *cache = cache_hash[cache_hashfn(block_no)];
+    while (cache && cache->block_no != block_no) {
+        cache = cache->hash_next;
     }
     
-    // 添加到缓存
-    cache = malloc(sizeof(cache_block_t));
-    cache->block_no = block_no;
-    cache->data = malloc(BLOCK_SIZE);
-    memcpy(cache->data, buffer, BLOCK_SIZE);
-    cache->dirty = false;
-    cache->ref_count = 1;
+    if (cache && cache != cache_head) {
+        cache->prev->next = cache->next;
+        cache->next->prev = cache->prev;
+        cache->next = cache_head;
+        cache->prev = cache_head->prev;
+        cache_head->prev->next = cache;
+        cache_head->prev = cache;
+        cache_head = cache;
+    }
+    
+    return cache;
+}
+
+// 释放对缓存块的固定引用（ref_count为1表示仅被缓存持有）
+void cache_release_block(cache_block_t *block) {
+    if (block && block->ref_count > 1) {
+        block->ref_count--;
+    }
+}
+
+// 从链表和哈希表中摘除缓存块并释放
+static void cache_evict(mount_point_t *mp, cache_block_t *cache) {
+    if (cache->dirty) {
+        device_write(mp->device, cache->block_no * BLOCK_SIZE, cache->data, BLOCK_SIZE);
+    }
+    
+    cache_block_t **link = &cache_hash[cache_hashfn(cache->block_no)];
+    while (*link != cache) {
+        link = &(*link)->hash_next;
+    }
+    *link = cache->hash_next;
+    
+    if (cache->next == cache) {
+        cache_head = NULL;
+    } else {
+        cache->prev->next = cache->next;
+        cache->next->prev = cache->prev;
+        if (cache_head == cache) {
+            cache_head = cache->next;
+        }
+    }
+    
+    mm_free_pages(cache->data, 1);
+    kmem_cache_free(cache_block_cache, cache);
+    cache_size--;
+}
+
+// 新块插入链表头；缓存超限时从尾部淘汰最久未用且未被映射固定的块
+static void cache_insert(mount_point_t *mp, cache_block_t *cache) {
+    uint32_t h = cache_hashfn(cache->block_no);
+    cache->hash_next = cache_hash[h];
+    cache_hash[h] = cache;
     
-    // 插入缓存链表
     if (cache_head) {
         cache->next = cache_head;
         cache->prev = cache_head->prev;
         cache_head->prev->next = cache;
         cache_head->prev = cache;
     } else {
-        cache_head = cache;
         cache->next = cache;
         cache->prev = cache;
     }
-    
+    cache_head = cache;
     cache_size++;
     
-    // 如果缓存太大，释放最旧的块
-    while (cache_size > MAX_CACHE_BLOCKS) {
-        cache_block_t *oldest = cache_head->prev;
-        if (oldest->dirty) {
-            device_write(mp->device, oldest->block_no * BLOCK_SIZE,
-                        oldest->data, BLOCK_SIZE);
+    cache_block_t *victim = cache_head->prev;
+    for (uint32_t scanned = 0; cache_size > MAX_CACHE_BLOCKS && scanned < cache_size; scanned++) {
+        cache_block_t *prev = victim->prev;
+        if (victim != cache && victim->ref_count <= 1) {
+            cache_evict(mp, victim);
         }
-        oldest->prev->next = oldest->next;
-        oldest->next->prev = oldest->prev;
-        free(oldest->data);
-        free(oldest);
-        cache_size--;
+        victim = prev;
+    }
+}
+
+// 分配缓存块，数据区使用整页以便直接映射到用户空间
+static cache_block_t *cache_alloc_block(uint32_t block_no) {
+    cache_block_t *cache = kmem_cache_alloc(cache_block_cache);
+    if (!cache) {
+        return NULL;
+    }
+    
+    cache->data = mm_alloc_pages(1);
+    if (!cache->data) {
+        kmem_cache_free(cache_block_cache, cache);
+        return NULL;
+    }
+    
+    cache->block_no = block_no;
+    cache->dirty = false;
+    cache->ref_count = 1;
+    cache->hash_next = NULL;
+    return cache;
+}
+
+// 获取块对应的缓存块，未命中时从设备读入
+static cache_block_t *cache_read_block(mount_point_t *mp, uint32_t block_no) {
+    cache_block_t *cache = cache_get_block(block_no);
+    if (cache) {
+        return cache;
+    }
+    
+    cache = cache_alloc_block(block_no);
+    if (!cache) {
+        return NULL;
+    }
+    
+    if (device_read(mp->device, block_no * BLOCK_SIZE, cache->data, BLOCK_SIZE) != BLOCK_SIZE) {
+        mm_free_pages(cache->data, 1);
+        kmem_cache_free(cache_block_cache, cache);
+        return NULL;
+    }
+    
+    cache_insert(mp, cache);
+    return cache;
+}
+
+// 读取块数据
+static int read_block(mount_point_t *mp, uint32_t block_no, void *buffer) {
+    cache_block_t *cache = cache_read_block(mp, block_no);
+    if (!cache) {
+        return -1;
     }
     
+    memcpy(buffer, cache->data, BLOCK_SIZE);
     return 0;
 }
 
@@ -111,34 +221,16 @@ static int read_block(mount_point_t *mp, uint32_t block_no, void *buffer) {
 static int write_block(mount_point_t *mp, uint32_t block_no, const void *buffer) {
     // 首先查找缓存
     cache_block_t *cache = cache_get_block(block_no);
-    if (cache) {
-        memcpy(cache->data, buffer, BLOCK_SIZE);
-        cache->dirty = true;
-        return 0;
+    if (!cache) {
+        cache = cache_alloc_block(block_no);
+        if (!cache) {
+            return -1;
+        }
+        cache_insert(mp, cache);
     }
     
-    // 添加到缓存
-    cache = malloc(sizeof(cache_block_t));
-    cache->block_no = block_no;
-    cache->data = malloc(BLOCK_SIZE);
     memcpy(cache->data, buffer, BLOCK_SIZE);
     cache->dirty = true;
-    cache->ref_count = 1;
-    
-    // 插入缓存链表
-    if (cache_head) {
-        cache->next = cache_head;
-        cache->prev = cache_head->prev;
-        cache_head->prev->next = cache;
-        cache_head->prev = cache;
-    } else {
-        cache_head = cache;
-        cache->next = cache;
-        cache->prev = cache;
-    }
-    
-    cache_size++;
-    
     return 0;
 }
 
@@ -192,8 +284,13 @@ static void free_block(mount_point_t *mp, uint32_t block_no) {
     write_block(mp, 0, sb);
 }
 
-// 读取inode
-static int read_inode(mount_point_t *mp, uint32_t inode_no, inode_t *inode) {
+// 取块缓存：load为true时未命中则从设备读入，否则只查缓存
+static cache_block_t *fetch_block(mount_point_t *mp, uint32_t block_no, bool load) {
+    return load ? cache_read_block(mp, block_no) : cache_get_block(block_no);
+}
+
+// 读取inode；load为false时inode所在块未缓存则失败，不发起I/O
+static int inode_load(mount_point_t *mp, uint32_t inode_no, inode_t *inode, bool load) {
     superblock_t *sb = mp->sb;
     
     uint32_t group = (inode_no - 1) / sb->inodes_per_group;
@@ -203,15 +300,21 @@ static int read_inode(mount_point_t *mp, uint32_t inode_no, inode_t *inode) {
     uint32_t block = inode_table + index * sb->inode_size / BLOCK_SIZE;
     uint32_t offset = (index * sb->inode_size) % BLOCK_SIZE;
     
-    uint8_t buffer[BLOCK_SIZE];
-    if (read_block(mp, block, buffer) < 0) {
+    // 直接从缓存块复制，避免在栈上放置整块缓冲区（缺页路径也会调用）
+    cache_block_t *cache = fetch_block(mp, block, load);
+    if (!cache) {
         return -1;
     }
     
-    memcpy(inode, buffer + offset, sizeof(inode_t));
+    memcpy(inode, cache->data + offset, sizeof(inode_t));
     return 0;
 }
 
+// 读取inode
+static int read_inode(mount_point_t *mp, uint32_t inode_no, inode_t *inode) {
+    return inode_load(mp, inode_no, inode, true);
+}
+
 // 写入inode
 static int write_inode(mount_point_t *mp, uint32_t inode_no, const inode_t *inode) {
     superblock_t *sb = mp->sb;
@@ -235,4 +338,163 @@ static int write_inode(mount_point_t *mp, uint32_t inode_no, const inode_t *inod
     }
     
     return 0;
-} 
\ No newline at end of file
+} 
+
+// 文件块号转换为磁盘块号，0表示空洞或超出寻址范围（load为false时间接块未缓存也返回0）
+static uint32_t inode_bmap(mount_point_t *mp, const inode_t *inode, uint32_t index, bool load) {
+    const uint32_t per_block = BLOCK_SIZE / sizeof(uint32_t);
+    
+    if (index < 12) {
+        return inode->direct[index];
+    }
+    
+    index -= 12;
+    if (index < per_block) {
+        if (!inode->indirect) {
+            return 0;
+        }
+        cache_block_t *ind = fetch_block(mp, inode->indirect, load);
+        return ind ? ((uint32_t *)ind->data)[index] : 0;
+    }
+    
+    index -= per_block;
+    if (index < per_block * per_block) {
+        if (!inode->double_indirect) {
+            return 0;
+        }
+        cache_block_t *dind = fetch_block(mp, inode->double_indirect, load);
+        if (!dind) {
+            return 0;
+        }
+        
+        uint32_t ind_no = ((uint32_t *)dind->data)[index / per_block];
+        if (!ind_no) {
+            return 0;
+        }
+        cache_block_t *ind = fetch_block(mp, ind_no, load);
+        return ind ? ((uint32_t *)ind->data)[index % per_block] : 0;
+    }
+    
+    return 0;
+}
+
+// 按查找方式取文件页对应的缓存块，PAGE_NOIO下任一块未缓存即返回NULL
+static cache_block_t *file_page_block(uint32_t ino, uint32_t pgoff, int mode) {
+    mount_point_t *mp = find_mount_point_by_inode(ino);
+    if (!mp) {
+        return NULL;
+    }
+    
+    inode_t inode;
+    if (inode_load(mp, ino, &inode, mode != PAGE_NOIO) < 0) {
+        return NULL;
+    }
+    
+    if (pgoff >= (inode.size + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+        return NULL;
+    }
+    
+    uint32_t block_no = inode_bmap(mp, &inode, pgoff, mode != PAGE_NOIO);
+    if (!block_no) {
+        return NULL;
+    }
+    
+    return fetch_block(mp, block_no, mode == PAGE_LOAD);
+}
+
+// 获取文件描述符对应的inode号
+int fs_get_inode(int fd, uint32_t *ino) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES || file_descs[fd].count == 0) {
+        return -1;
+    }
+    
+    *ino = file_descs[fd].inode;
+    return 0;
+}
+
+// 获取文件页数
+uint32_t fs_file_pages(uint32_t ino) {
+    mount_point_t *mp = find_mount_point_by_inode(ino);
+    inode_t inode;
+    
+    if (!mp || read_inode(mp, ino, &inode) < 0) {
+        return 0;
+    }
+    
+    return (inode.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// 获取文件大小（字节）
+uint32_t fs_file_size(uint32_t ino) {
+    mount_point_t *mp = find_mount_point_by_inode(ino);
+    inode_t inode;
+    
+    if (!mp || read_inode(mp, ino, &inode) < 0) {
+        return 0;
+    }
+    
+    return inode.size;
+}
+
+// 获取文件页并固定在缓存中（供mmap直接映射），必要时从设备读入
+void *fs_get_page(uint32_t ino, uint32_t pgoff) {
+    cache_block_t *cache = file_page_block(ino, pgoff, PAGE_LOAD);
+    if (!cache) {
+        return NULL;
+    }
+    
+    cache->ref_count++;
+    return cache->data;
+}
+
+// 仅在文件页及其inode、间接块都已缓存时固定并返回，不发起I/O（供fault-around使用）
+void *fs_find_page(uint32_t ino, uint32_t pgoff) {
+    cache_block_t *cache = file_page_block(ino, pgoff, PAGE_NOIO);
+    if (!cache) {
+        return NULL;
+    }
+    
+    cache->ref_count++;
+    return cache->data;
+}
+
+// 解除文件页的固定
+void fs_put_page(uint32_t ino, uint32_t pgoff) {
+    cache_release_block(file_page_block(ino, pgoff, PAGE_CACHED));
+}
+
+// 共享映射写入后标记文件页为脏，由缓存淘汰或同步时写回
+void fs_set_page_dirty(uint32_t ino, uint32_t pgoff) {
+    cache_block_t *cache = file_page_block(ino, pgoff, PAGE_CACHED);
+    if (cache) {
+        cache->dirty = true;
+    }
+}
+
+// 预读文件页到缓存（不固定），遇到文件末尾或空洞时停止，返回读入的页数
+uint32_t fs_readahead(uint32_t ino, uint32_t pgoff, uint32_t nr_pages) {
+    mount_point_t *mp = find_mount_point_by_inode(ino);
+    inode_t inode;
+    
+    if (!mp || read_inode(mp, ino, &inode) < 0) {
+        return 0;
+    }
+    
+    uint32_t nr_file = (inode.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t done = 0;
+    
+    // 预读量不超过缓存容量的一半，避免把正在使用的块挤出
+    if (nr_pages > MAX_CACHE_BLOCKS / 2) {
+        nr_pages = MAX_CACHE_BLOCKS / 2;
+    }
+    
+    while (done < nr_pages && pgoff + done < nr_file) {
+        uint32_t block_no = inode_bmap(mp, &inode, pgoff + done, true);
+        if (!block_no || !cache_read_block(mp, block_no)) {
+            break;
+        }
+        done++;
+    }
+    
+    return done;
+}
@@ -0,0 +1,176 @@
+#include "ipc.h"
+#include "memory.h"
+#include <string.h>
+
+/*
+ * IPC句柄表：句柄由槽下标与代数组成，按句柄查找只需检查下标范围和代数；
+ * 对象释放后槽的代数加一，持有旧句柄的调用者得到NULL而不是复用该槽的新对象。
+ * 非IPC_PRIVATE的键另外挂入哈希链，供*_open按键查找。
+ * 对象首字段为ipc_object_t引用计数：每个句柄持有一个引用，ipc_handle_get/next
+ * 在表锁内校验句柄并加一个引用，调用者用完后ipc_handle_put。句柄释放后不再产生新引用，
+ * 最后一个put返回true，由对象所属模块销毁对象，进行中的操作不会看到已释放的内存。
+ */
+
+static inline uint32_t handle_index(int handle) {
+    return (uint32_t)handle & ((1u << IPC_HANDLE_INDEX_BITS) - 1);
+}
+
+static inline uint16_t handle_gen(int handle) {
+    return ((uint32_t)handle >> IPC_HANDLE_INDEX_BITS) & IPC_HANDLE_GEN_MASK;
+}
+
+static inline uint32_t key_hash(key_t key) {
+    return ((uint32_t)key * 2654435761u) >> (32 - IPC_KEY_HASH_BITS);
+}
+
+// 初始化句柄表，所有槽链入空闲链
+int ipc_table_init(ipc_table_t *table, uint32_t capacity) {
+    if (!table || capacity == 0 || capacity > (1u << IPC_HANDLE_INDEX_BITS)) return -1;
+
+    table->slots = malloc(capacity * sizeof(ipc_handle_slot_t));
+    if (!table->slots) return -1;
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        table->slots[i].obj = NULL;
+        table->slots[i].key = IPC_PRIVATE;
+        table->slots[i].gen = 1;
+        table->slots[i].next = (i + 1 < capacity) ? (int16_t)(i + 1) : -1;
+    }
+    for (uint32_t i = 0; i < (1u << IPC_KEY_HASH_BITS); i++) {
+        table->buckets[i] = -1;
+    }
+
+    table->capacity = capacity;
+    table->count = 0;
+    table->free_head = 0;
+    mutex_init(&table->lock, "ipc_table_lock");
+    return 0;
+}
+
+static int lookup_locked(ipc_table_t *table, key_t key) {
+    int16_t idx = table->buckets[key_hash(key)];
+    while (idx >= 0) {
+        ipc_handle_slot_t *slot = &table->slots[idx];
+        if (slot->key == key) {
+            return (slot->gen << IPC_HANDLE_INDEX_BITS) | idx;
+        }
+        idx = slot->next;
+    }
+    return -1;
+}
+
+// 分配句柄并关联对象，键已存在或表满返回-1
+int ipc_handle_alloc(ipc_table_t *table, key_t key, void *obj) {
+    mutex_lock(&table->lock);
+
+    if ((key != IPC_PRIVATE && lookup_locked(table, key) >= 0) || table->free_head < 0) {
+        mutex_unlock(&table->lock);
+        return -1;
+    }
+
+    int16_t idx = table->free_head;
+    ipc_handle_slot_t *slot = &table->slots[idx];
+    table->free_head = slot->next;
+
+    slot->key = key;
+    slot->next = -1;
+    if (key != IPC_PRIVATE) {
+        slot->next = table->buckets[key_hash(key)];
+        table->buckets[key_hash(key)] = idx;
+    }
+
+    // 句柄持有对象的一个引用，直到ipc_handle_free后由调用者put
+    __atomic_add_fetch(&((ipc_object_t *)obj)->refs, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->obj, obj, __ATOMIC_RELEASE);
+    table->count++;
+
+    int handle = (slot->gen << IPC_HANDLE_INDEX_BITS) | idx;
+    mutex_unlock(&table->lock);
+    return handle;
+}
+
+// 按句柄查找对象并加一个引用（O(1)），句柄已失效返回NULL；用完后调用ipc_handle_put
+void *ipc_handle_get(ipc_table_t *table, int handle) {
+    uint32_t idx = handle_index(handle);
+    if (handle < 0 || idx >= table->capacity) return NULL;
+
+    mutex_lock(&table->lock);
+
+    ipc_handle_slot_t *slot = &table->slots[idx];
+    void *obj = slot->obj;
+    if (!obj || slot->gen != handle_gen(handle)) {
+        mutex_unlock(&table->lock);
+        return NULL;
+    }
+    __atomic_add_fetch(&((ipc_object_t *)obj)->refs, 1, __ATOMIC_RELAXED);
+
+    mutex_unlock(&table->lock);
+    return obj;
+}
+
+// 释放一个对象引用，返回true表示这是最后一个引用，调用者须销毁对象
+bool ipc_handle_put(void *obj) {
+    return __atomic_sub_fetch(&((ipc_object_t *)obj)->refs, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+// 按键查找句柄
+int ipc_handle_lookup(ipc_table_t *table, key_t key) {
+    if (key == IPC_PRIVATE) return -1;
+
+    mutex_lock(&table->lock);
+    int handle = lookup_locked(table, key);
+    mutex_unlock(&table->lock);
+    return handle;
+}
+
+// 释放句柄，返回原关联的对象；代数加一使该句柄失效。
+// 句柄持有的引用转交调用者，调用者用完对象后须ipc_handle_put
+void *ipc_handle_free(ipc_table_t *table, int handle) {
+    uint32_t idx = handle_index(handle);
+    if (handle < 0 || idx >= table->capacity) return NULL;
+
+    mutex_lock(&table->lock);
+
+    ipc_handle_slot_t *slot = &table->slots[idx];
+    void *obj = slot->obj;
+    if (!obj || slot->gen != handle_gen(handle)) {
+        mutex_unlock(&table->lock);
+        return NULL;
+    }
+
+    // 从键哈希链摘除
+    if (slot->key != IPC_PRIVATE) {
+        int16_t *link = &table->buckets[key_hash(slot->key)];
+        while (*link != (int16_t)idx) {
+            link = &table->slots[*link].next;
+        }
+        *link = slot->next;
+    }
+
+    uint16_t gen = (slot->gen + 1) & IPC_HANDLE_GEN_MASK;
+    slot->gen = gen ? gen : 1;
+    slot->obj = NULL;
+    slot->key = IPC_PRIVATE;
+    slot->next = table->free_head;
+    table->free_head = idx;
+    table->count--;
+
+    mutex_unlock(&table->lock);
+    return obj;
+}
+
+// 遍历已分配的对象并加一个引用，pos从0开始，遍历结束返回NULL；每个返回的对象都须ipc_handle_put
+void *ipc_handle_next(ipc_table_t *table, uint32_t *pos) {
+    void *obj = NULL;
+
+    mutex_lock(&table->lock);
+    while (*pos < table->capacity && !obj) {
+        obj = table->slots[(*pos)++].obj;
+    }
+    if (obj) {
+        __atomic_add_fetch(&((ipc_object_t *)obj)->refs, 1, __ATOMIC_RELAXED);
+    }
+    mutex_unlock(&table->lock);
+
+    return obj;
+}
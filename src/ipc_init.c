@@ -2,6 +2,8 @@
 #include "task.h"
 #include "memory.h"
 
+ipc_stats_t ipc_stats;
+
 // IPC 系统初始化
 void ipc_init(void) {
     // 初始化消息队列系统
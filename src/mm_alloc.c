@@ -1,5 +1,6 @@
 #include "mm.h"
 #include "sync.h"
+#include <stdio.h>
 #include <string.h>
 
 // 内存块头部
@@ -7,6 +8,7 @@ typedef struct block_header {
     uint32_t size;              // 块大小
     uint32_t magic;             // 魔数，用于检测内存越界
     bool is_free;               // 是否空闲
+    uint32_t caller;            // 分配者返回地址，0表示位于缓存中
     struct block_header *next;  // 下一个块
     struct block_header *prev;  // 上一个块
 } block_header_t;
@@ -14,15 +16,83 @@ typedef struct block_header {
 // 内存块尾部
 typedef struct block_footer {
     block_header_t *header;    // 指向块头部
+    uint32_t canary;           // 尾部魔数，用于检测写越界
 } block_footer_t;
 
 #define BLOCK_MAGIC    0xDEADBEEF
 #define MIN_BLOCK_SIZE (sizeof(block_header_t) + sizeof(block_footer_t) + 16)
+#define BLOCK_OVERHEAD (sizeof(block_header_t) + sizeof(block_footer_t))
+#define LEAK_SLOTS     32
 
-// 空闲块链表（按大小排序）
+// 堆块链表（包含空闲与已分配块）
 static block_header_t *free_list = NULL;
 static mutex_t mm_lock;
 
+// 运行时统计（原子更新，无需持有mm_lock）
+static uint32_t heap_size;
+static uint32_t bytes_in_use;
+static uint32_t peak_in_use;
+static uint32_t alloc_count;
+static uint32_t free_count;
+static uint32_t failed_allocs;
+static uint32_t class_live[MM_STAT_CLASSES];
+
+static inline block_header_t *ptr_to_block(void *addr) {
+    return (block_header_t *)((char *)addr - sizeof(block_header_t));
+}
+
+static inline block_footer_t *block_footer(block_header_t *block) {
+    return (block_footer_t *)((char *)block + sizeof(block_header_t) + block->size);
+}
+
+// 两个块在物理上是否相邻（不同页块之间不能合并）
+static inline bool blocks_adjacent(block_header_t *a, block_header_t *b) {
+    return (char *)a + BLOCK_OVERHEAD + a->size == (char *)b;
+}
+
+static inline void set_footer(block_header_t *block) {
+    block_footer_t *footer = block_footer(block);
+    footer->header = block;
+    footer->canary = BLOCK_MAGIC;
+}
+
+// 统计尺寸类：16B ~ 2KB 的2的幂，其余为大对象
+static inline int stat_class(uint32_t size) {
+    if (size <= (1 << MAG_MIN_SHIFT)) return 0;
+    int cls = 32 - __builtin_clz(size - 1) - MAG_MIN_SHIFT;
+    return cls < MAG_CLASS_COUNT ? cls : MAG_CLASS_COUNT;
+}
+
+static void stats_account_alloc(uint32_t size) {
+    uint32_t in_use = __atomic_add_fetch(&bytes_in_use, size, __ATOMIC_RELAXED);
+    uint32_t peak = __atomic_load_n(&peak_in_use, __ATOMIC_RELAXED);
+
+    while (in_use > peak &&
+           !__atomic_compare_exchange_n(&peak_in_use, &peak, in_use, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&class_live[stat_class(size)], 1, __ATOMIC_RELAXED);
+}
+
+static void stats_account_free(uint32_t size) {
+    __atomic_sub_fetch(&bytes_in_use, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&free_count, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&class_live[stat_class(size)], 1, __ATOMIC_RELAXED);
+}
+
+// 初始化内存管理子系统
+void mm_init(void) {
+    // 物理页分配器必须最先初始化
+    buddy_init();
+    mm_alloc_init();
+
+    // 地址空间与区域描述符缓存依赖slab分配器
+    mm_mmap_init();
+    vma_cache_init();
+}
+
 // 初始化内存分配器
 void mm_alloc_init(void) {
     mutex_init(&mm_lock, "mm_lock");
@@ -30,42 +100,48 @@ void mm_alloc_init(void) {
     // 初始化第一个大块
     void *initial_heap = mm_alloc_pages(1024); // 4MB初始堆
     block_header_t *initial_block = (block_header_t *)initial_heap;
-    initial_block->size = 1024 * PAGE_SIZE - sizeof(block_header_t) - sizeof(block_footer_t);
+    initial_block->size = 1024 * PAGE_SIZE - BLOCK_OVERHEAD;
     initial_block->magic = BLOCK_MAGIC;
     initial_block->is_free = true;
+    initial_block->caller = 0;
     initial_block->next = NULL;
     initial_block->prev = NULL;
     
     // 设置尾部
-    block_footer_t *footer = (block_footer_t *)((char *)initial_block + initial_block->size + sizeof(block_header_t));
-    footer->header = initial_block;
+    set_footer(initial_block);
     
     // 加入空闲链表
     free_list = initial_block;
+    heap_size = 1024 * PAGE_SIZE;
+    
+    // 初始化magazine缓存层
+    mm_magazine_init();
+    
+    // 初始化slab分配器
+    kmem_cache_init();
 }
 
 // 分割内存块
 static void split_block(block_header_t *block, size_t size) {
     if (block->size - size >= MIN_BLOCK_SIZE) {
-        // 创建新块
-        block_header_t *new_block = (block_header_t *)((char *)block + sizeof(block_header_t) + size);
-        new_block->size = block->size - size - sizeof(block_header_t) - sizeof(block_footer_t);
+        // 创建新块（位于原块尾部之后）
+        block_header_t *new_block = (block_header_t *)((char *)block + BLOCK_OVERHEAD + size);
+        new_block->size = block->size - size - BLOCK_OVERHEAD;
         new_block->magic = BLOCK_MAGIC;
         new_block->is_free = true;
+        new_block->caller = 0;
         new_block->next = block->next;
         new_block->prev = block;
         
         // 设置新块的尾部
-        block_footer_t *new_footer = (block_footer_t *)((char *)new_block + new_block->size + sizeof(block_header_t));
-        new_footer->header = new_block;
+        set_footer(new_block);
         
         // 更新原块
         block->size = size;
         block->next = new_block;
         
         // 更新原块的尾部
-        block_footer_t *footer = (block_footer_t *)((char *)block + block->size + sizeof(block_header_t));
-        footer->header = block;
+        set_footer(block);
         
         // 加入空闲链表
         if (new_block->next) {
@@ -77,21 +153,20 @@ static void split_block(block_header_t *block, size_t size) {
 // 合并相邻的空闲块
 static block_header_t *coalesce(block_header_t *block) {
     // 检查并合并后一个块
-    if (block->next && block->next->is_free) {
-        block->size += sizeof(block_header_t) + sizeof(block_footer_t) + block->next->size;
+    if (block->next && block->next->is_free && blocks_adjacent(block, block->next)) {
+        block->size += BLOCK_OVERHEAD + block->next->size;
         block->next = block->next->next;
         if (block->next) {
             block->next->prev = block;
         }
         
         // 更新尾部
-        block_footer_t *footer = (block_footer_t *)((char *)block + block->size + sizeof(block_header_t));
-        footer->header = block;
+        set_footer(block);
     }
     
     // 检查并合并前一个块
-    if (block->prev && block->prev->is_free) {
-        block->prev->size += sizeof(block_header_t) + sizeof(block_footer_t) + block->size;
+    if (block->prev && block->prev->is_free && blocks_adjacent(block->prev, block)) {
+        block->prev->size += BLOCK_OVERHEAD + block->size;
         block->prev->next = block->next;
         if (block->next) {
             block->next->prev = block->prev;
@@ -99,22 +174,14 @@ static block_header_t *coalesce(block_header_t *block) {
         block = block->prev;
         
         // 更新尾部
-        block_footer_t *footer = (block_footer_t *)((char *)block + block->size + sizeof(block_header_t));
-        footer->header = block;
+        set_footer(block);
     }
     
     return block;
 }
 
-// 分配内存
-void *mm_alloc(size_t size) {
-    if (size == 0) return NULL;
-    
-    // 对齐到8字节
-    size = (size + 7) & ~7;
-    
-    mutex_lock(&mm_lock);
-    
+// 从堆中分配（调用者持有mm_lock）
+static void *heap_alloc_locked(size_t size) {
     // 查找合适的空闲块
     block_header_t *block = free_list;
     block_header_t *best_fit = NULL;
@@ -129,19 +196,20 @@ void *mm_alloc(size_t size) {
     }
     
     if (!best_fit) {
-        // 没有合适的块，申请新页面
-        size_t pages = (size + sizeof(block_header_t) + sizeof(block_footer_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+        // 没有合适的块，申请新页面（伙伴分配器按2的幂取整，全部纳入堆）
+        size_t pages = (size + BLOCK_OVERHEAD + PAGE_SIZE - 1) / PAGE_SIZE;
+        pages = 1u << pages_to_order(pages);
         void *new_mem = mm_alloc_pages(pages);
         if (!new_mem) {
-            mutex_unlock(&mm_lock);
             return NULL;
         }
         
         // 初始化新块
         block = (block_header_t *)new_mem;
-        block->size = pages * PAGE_SIZE - sizeof(block_header_t) - sizeof(block_footer_t);
+        block->size = pages * PAGE_SIZE - BLOCK_OVERHEAD;
         block->magic = BLOCK_MAGIC;
         block->is_free = true;
+        set_footer(block);
         
         // 加入空闲链表
         block->next = free_list;
@@ -150,6 +218,7 @@ void *mm_alloc(size_t size) {
             free_list->prev = block;
         }
         free_list = block;
+        heap_size += pages * PAGE_SIZE;
         
         best_fit = block;
     }
@@ -159,35 +228,407 @@ void *mm_alloc(size_t size) {
     
     // 标记为已使用
     best_fit->is_free = false;
-    
-    mutex_unlock(&mm_lock);
+    best_fit->caller = 0;
     
     // 返回数据区域指针
     return (void *)((char *)best_fit + sizeof(block_header_t));
 }
 
+// 释放到堆中（调用者持有mm_lock）
+static void heap_free_locked(void *addr) {
+    // 获取块头部
+    block_header_t *block = ptr_to_block(addr);
+    
+    // 验证魔数
+    if (block->magic != BLOCK_MAGIC || block->is_free) {
+        return;
+    }
+    
+    // 标记为空闲
+    block->is_free = true;
+    block->caller = 0;
+    
+    // 尝试合并相邻的空闲块
+    coalesce(block);
+}
+
+// 从全局堆分配内存（不经过magazine缓存）
+void *mm_heap_alloc(size_t size) {
+    if (size == 0) return NULL;
+    
+    // 对齐到8字节
+    size = (size + 7) & ~7;
+    
+    mutex_lock(&mm_lock);
+    void *ptr = heap_alloc_locked(size);
+    if (ptr) {
+        ptr_to_block(ptr)->caller = (uint32_t)__builtin_return_address(0);
+    }
+    mutex_unlock(&mm_lock);
+    
+    return ptr;
+}
+
+// 释放内存到全局堆（不经过magazine缓存）
+void mm_heap_free(void *addr) {
+    if (!addr) return;
+    
+    mutex_lock(&mm_lock);
+    heap_free_locked(addr);
+    mutex_unlock(&mm_lock);
+}
+
+// 批量分配同尺寸对象，只获取一次mm_lock，返回实际分配数量
+uint32_t mm_heap_alloc_batch(size_t size, void **objs, uint32_t count) {
+    uint32_t n = 0;
+    
+    size = (size + 7) & ~7;
+    
+    mutex_lock(&mm_lock);
+    while (n < count) {
+        void *ptr = heap_alloc_locked(size);
+        if (!ptr) break;
+        objs[n++] = ptr;
+    }
+    mutex_unlock(&mm_lock);
+    
+    return n;
+}
+
+// 批量释放对象，只获取一次mm_lock
+void mm_heap_free_batch(void **objs, uint32_t count) {
+    mutex_lock(&mm_lock);
+    for (uint32_t i = 0; i < count; i++) {
+        if (objs[i]) {
+            heap_free_locked(objs[i]);
+        }
+    }
+    mutex_unlock(&mm_lock);
+}
+
+// 获取已分配块的可用大小，非法指针返回0
+size_t mm_heap_block_size(void *addr) {
+    block_header_t *block = ptr_to_block(addr);
+    
+    if (block->magic != BLOCK_MAGIC || block->is_free) {
+        return 0;
+    }
+    return block->size;
+}
+
+// 分配内存并记录调用者标签（malloc等封装使用）
+void *mm_alloc_tagged(size_t size, uint32_t caller) {
+    if (size == 0) return NULL;
+    
+    void *ptr = NULL;
+    
+    // 小对象优先走magazine缓存，无需获取mm_lock
+    if (size <= MAG_MAX_SIZE) {
+        ptr = mm_magazine_alloc(size);
+    }
+    if (!ptr) {
+        ptr = mm_heap_alloc(size);
+    }
+    if (!ptr) {
+        __atomic_add_fetch(&failed_allocs, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    
+    block_header_t *block = ptr_to_block(ptr);
+    block->caller = caller;
+    stats_account_alloc(block->size);
+    
+    return ptr;
+}
+
+// 分配内存
+void *mm_alloc(size_t size) {
+    return mm_alloc_tagged(size, (uint32_t)__builtin_return_address(0));
+}
+
 // 释放内存
 void mm_free(void *addr) {
     if (!addr) return;
     
+    block_header_t *block = ptr_to_block(addr);
+    
+    // 拒绝非法指针和重复释放（缓存中的对象标签为0）
+    if (block->magic != BLOCK_MAGIC || block->is_free || block->caller == 0) {
+        return;
+    }
+    
+    stats_account_free(block->size);
+    block->caller = 0;
+    
+    // 小对象优先放回magazine缓存
+    if (mm_magazine_free(addr)) return;
+    
+    mm_heap_free(addr);
+}
+
+// 原地扩展：吸收物理相邻的后继空闲块（调用者持有mm_lock）
+static bool grow_in_place_locked(block_header_t *block, size_t size) {
+    block_header_t *next = block->next;
+    
+    if (!next || !next->is_free || !blocks_adjacent(block, next)) {
+        return false;
+    }
+    if (block->size + BLOCK_OVERHEAD + next->size < size) {
+        return false;
+    }
+    
+    block->size += BLOCK_OVERHEAD + next->size;
+    block->next = next->next;
+    if (block->next) {
+        block->next->prev = block;
+    }
+    set_footer(block);
+    
+    // 多余部分重新切分为空闲块
+    split_block(block, size);
+    return true;
+}
+
+// 调整已分配内存的大小，优先原地扩展/收缩
+void *mm_realloc_tagged(void *addr, size_t size, uint32_t caller) {
+    if (!addr) return mm_alloc_tagged(size, caller);
+    
+    if (size == 0) {
+        mm_free(addr);
+        return NULL;
+    }
+    
+    block_header_t *block = ptr_to_block(addr);
+    if (block->magic != BLOCK_MAGIC || block->is_free || block->caller == 0) {
+        return NULL;
+    }
+    
+    uint32_t old_size = block->size;
+    size = (size + 7) & ~7;
+    
+    // 当前块已足够：大块收缩时把尾部归还堆，小块保持不变以免反复切分
+    if (old_size >= size) {
+        if (old_size > MAG_MAX_SIZE && old_size - size >= MIN_BLOCK_SIZE) {
+            mutex_lock(&mm_lock);
+            split_block(block, size);
+            if (block->next && block->next->is_free) {
+                coalesce(block->next);
+            }
+            mutex_unlock(&mm_lock);
+            stats_account_free(old_size);
+            stats_account_alloc(block->size);
+        }
+        return addr;
+    }
+    
+    // 尝试吸收相邻空闲块原地扩展
     mutex_lock(&mm_lock);
+    bool grown = grow_in_place_locked(block, size);
+    mutex_unlock(&mm_lock);
     
-    // 获取块头部
-    block_header_t *block = (block_header_t *)((char *)addr - sizeof(block_header_t));
+    if (grown) {
+        stats_account_free(old_size);
+        stats_account_alloc(block->size);
+        block->caller = caller;
+        return addr;
+    }
     
-    // 验证魔数
-    if (block->magic != BLOCK_MAGIC) {
+    // 只能重新分配并复制
+    void *new_addr = mm_alloc_tagged(size, caller);
+    if (!new_addr) return NULL;
+    
+    memcpy(new_addr, addr, old_size);
+    mm_free(addr);
+    return new_addr;
+}
+
+// 调整已分配内存的大小
+void *mm_realloc(void *addr, size_t size) {
+    return mm_realloc_tagged(addr, size, (uint32_t)__builtin_return_address(0));
+}
+
+// 按指定对齐分配内存（对齐必须是2的幂），记录调用者标签
+void *mm_alloc_aligned_tagged(size_t size, size_t align, uint32_t caller) {
+    if (size == 0 || (align & (align - 1))) return NULL;
+    
+    // 8字节对齐是堆的默认保证
+    if (align <= 8) return mm_alloc_tagged(size, caller);
+    
+    size = (size + 7) & ~7;
+    
+    mutex_lock(&mm_lock);
+    
+    // 多分配align + MIN_BLOCK_SIZE，保证能切出满足对齐的块和独立的前导空闲块
+    void *raw = heap_alloc_locked(size + align + MIN_BLOCK_SIZE);
+    if (!raw) {
         mutex_unlock(&mm_lock);
-        return;
+        __atomic_add_fetch(&failed_allocs, 1, __ATOMIC_RELAXED);
+        return NULL;
     }
     
-    // 标记为空闲
-    block->is_free = true;
+    block_header_t *block = ptr_to_block(raw);
+    uint32_t data = (uint32_t)raw;
+    uint32_t aligned = (data + align - 1) & ~(align - 1);
     
-    // 尝试合并相邻的空闲块
-    block = coalesce(block);
+    if (aligned != data) {
+        // 前导部分必须足够组成一个空闲块
+        while (aligned - data < MIN_BLOCK_SIZE) {
+            aligned += align;
+        }
+        
+        block_header_t *aligned_block = ptr_to_block((void *)aligned);
+        uint32_t lead = (char *)aligned_block - (char *)block;
+        
+        aligned_block->size = block->size - lead;
+        aligned_block->magic = BLOCK_MAGIC;
+        aligned_block->is_free = false;
+        aligned_block->next = block->next;
+        aligned_block->prev = block;
+        if (aligned_block->next) {
+            aligned_block->next->prev = aligned_block;
+        }
+        set_footer(aligned_block);
+        
+        // 前导部分作为空闲块归还
+        block->size = lead - BLOCK_OVERHEAD;
+        block->next = aligned_block;
+        block->is_free = true;
+        set_footer(block);
+        coalesce(block);
+        
+        block = aligned_block;
+    }
+    
+    // 归还尾部多余空间
+    split_block(block, size);
+    if (block->next && block->next->is_free) {
+        coalesce(block->next);
+    }
+    
+    block->caller = caller;
+    mutex_unlock(&mm_lock);
+    
+    stats_account_alloc(block->size);
+    return (void *)((char *)block + sizeof(block_header_t));
+}
+
+// 按指定对齐分配内存（缓存行对齐、DMA缓冲区等）
+void *mm_alloc_aligned(size_t size, size_t align) {
+    return mm_alloc_aligned_tagged(size, align, (uint32_t)__builtin_return_address(0));
+}
+
+// 获取内存统计信息
+void mm_get_stats(mm_stats_t *stats) {
+    if (!stats) return;
+    
+    memset(stats, 0, sizeof(mm_stats_t));
+    
+    // 遍历堆计算空闲空间分布
+    mutex_lock(&mm_lock);
+    for (block_header_t *block = free_list; block; block = block->next) {
+        if (block->is_free) {
+            stats->free_bytes += block->size;
+            stats->free_blocks++;
+            if (block->size > stats->largest_free) {
+                stats->largest_free = block->size;
+            }
+        }
+    }
+    stats->heap_size = heap_size;
+    mutex_unlock(&mm_lock);
     
+    // 碎片率：空闲空间中不能被一次性分配出去的比例
+    if (stats->free_bytes) {
+        stats->fragmentation = 100 - (uint32_t)((uint64_t)stats->largest_free * 100 / stats->free_bytes);
+    }
+    
+    stats->bytes_in_use = bytes_in_use;
+    stats->peak_in_use = peak_in_use;
+    stats->alloc_count = alloc_count;
+    stats->free_count = free_count;
+    stats->failed_allocs = failed_allocs;
+    for (int i = 0; i < MM_STAT_CLASSES; i++) {
+        stats->class_live[i] = class_live[i];
+    }
+    
+    mag_stats_t mag;
+    mm_magazine_get_stats(&mag);
+    stats->magazine_cached = mag.cached_objs;
+}
+
+// 打印内存统计信息
+void mm_dump_stats(void) {
+    mm_stats_t stats;
+    mm_get_stats(&stats);
+    
+    printf("Heap: size %u, in use %u, peak %u\n",
+           stats.heap_size, stats.bytes_in_use, stats.peak_in_use);
+    printf("Free: %u bytes in %u blocks, largest %u, fragmentation %u%%\n",
+           stats.free_bytes, stats.free_blocks, stats.largest_free, stats.fragmentation);
+    printf("Ops: %u allocs, %u frees, %u failed, %u cached in magazines\n",
+           stats.alloc_count, stats.free_count, stats.failed_allocs, stats.magazine_cached);
+    
+    for (int i = 0; i < MAG_CLASS_COUNT; i++) {
+        printf("  <=%5u: %u live\n", 1u << (i + MAG_MIN_SHIFT), stats.class_live[i]);
+    }
+    printf("  large : %u live\n", stats.class_live[MAG_CLASS_COUNT]);
+    
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        zone_info_t info;
+        if (buddy_get_zone_info(z, &info) == 0) {
+            printf("Zone %s: %u/%u pages free, %u in per-CPU caches\n",
+                   info.name, info.free_pages, info.nr_pages, info.pcp_pages);
+        }
+    }
+}
+
+// 按分配者汇总存活的分配，并检查尾部魔数
+void mm_check_leaks(void) {
+    struct {
+        uint32_t caller;
+        uint32_t count;
+        uint32_t bytes;
+    } slots[LEAK_SLOTS];
+    uint32_t used = 0;
+    uint32_t untracked = 0;
+    uint32_t corrupted = 0;
+    
+    memset(slots, 0, sizeof(slots));
+    
+    mutex_lock(&mm_lock);
+    for (block_header_t *block = free_list; block; block = block->next) {
+        if (block_footer(block)->canary != BLOCK_MAGIC) {
+            corrupted++;
+            printf("Heap overrun: block %p (caller %p)\n", (void *)block, (void *)block->caller);
+        }
+        if (block->is_free || block->caller == 0) continue;
+        
+        uint32_t i;
+        for (i = 0; i < used; i++) {
+            if (slots[i].caller == block->caller) break;
+        }
+        if (i == used) {
+            if (used == LEAK_SLOTS) {
+                untracked++;
+                continue;
+            }
+            slots[used++].caller = block->caller;
+        }
+        slots[i].count++;
+        slots[i].bytes += block->size;
+    }
     mutex_unlock(&mm_lock);
+    
+    printf("Live allocations by caller:\n");
+    for (uint32_t i = 0; i < used; i++) {
+        printf("  %p: %u blocks, %u bytes\n", (void *)slots[i].caller, slots[i].count, slots[i].bytes);
+    }
+    if (untracked) {
+        printf("  (%u blocks from other callers)\n", untracked);
+    }
+    if (corrupted) {
+        printf("%u corrupted blocks\n", corrupted);
+    }
 } 
 
 // 内存管理系统使用示例
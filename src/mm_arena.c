@@ -0,0 +1,188 @@
+#include "mm.h"
+#include "task.h"
+#include <string.h>
+
+#define ARENA_ALIGN         8
+
+// 区域块（由mm_alloc_pages分配，首部之后为可用空间）
+typedef struct arena_chunk {
+    struct arena_chunk *prev;  // 上一个块（链表从当前块向前）
+    uint32_t size;             // 块总大小（字节）
+    uint32_t pages;            // 块页数
+} arena_chunk_t;
+
+// 区域分配器（位于第一个块的首部之后）
+struct arena {
+    arena_chunk_t *current;    // 当前分配块
+    uint32_t offset;           // 当前块内已用偏移
+    uint32_t chunk_pages;      // 默认块页数
+    uint32_t total_bytes;      // 已分配的页总字节数
+    uint32_t used_bytes;       // 已分配给用户的字节数
+    uint32_t peak_bytes;       // 用户字节峰值
+};
+
+static inline uint32_t align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static arena_chunk_t *chunk_alloc(uint32_t pages) {
+    arena_chunk_t *chunk = mm_alloc_pages(pages);
+    if (!chunk) return NULL;
+
+    chunk->prev = NULL;
+    chunk->pages = pages;
+    chunk->size = pages * PAGE_SIZE;
+    return chunk;
+}
+
+// 释放从current到stop（不含）之间的所有块
+static void chunk_free_until(arena_t *arena, arena_chunk_t *stop) {
+    arena_chunk_t *chunk = arena->current;
+
+    while (chunk && chunk != stop) {
+        arena_chunk_t *prev = chunk->prev;
+        arena->total_bytes -= chunk->size;
+        mm_free_pages(chunk, chunk->pages);
+        chunk = prev;
+    }
+}
+
+// 创建区域分配器，chunk_pages为每次向页分配器申请的页数
+arena_t *arena_create(uint32_t chunk_pages) {
+    if (chunk_pages == 0) chunk_pages = ARENA_DEFAULT_PAGES;
+
+    arena_chunk_t *chunk = chunk_alloc(chunk_pages);
+    if (!chunk) return NULL;
+
+    // 描述符放在第一个块内，不占用全局堆
+    arena_t *arena = (arena_t *)(chunk + 1);
+    arena->current = chunk;
+    arena->offset = align_up(sizeof(arena_chunk_t) + sizeof(arena_t), ARENA_ALIGN);
+    arena->chunk_pages = chunk_pages;
+    arena->total_bytes = chunk->size;
+    arena->used_bytes = 0;
+    arena->peak_bytes = 0;
+
+    return arena;
+}
+
+// 按指定对齐从区域分配内存（无单独释放，随reset/destroy整体回收）
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align) {
+    if (!arena || size == 0 || (align & (align - 1))) return NULL;
+    if (align < ARENA_ALIGN) align = ARENA_ALIGN;
+
+    uint32_t start = align_up((uint32_t)arena->current + arena->offset, align);
+    uint32_t end = (uint32_t)arena->current + arena->current->size;
+
+    if (start + size > end) {
+        // 当前块不足：申请新块，超大请求单独成块
+        uint32_t need = align_up(sizeof(arena_chunk_t), align) + size;
+        uint32_t pages = arena->chunk_pages;
+        if (need > pages * PAGE_SIZE) {
+            pages = (need + PAGE_SIZE - 1) / PAGE_SIZE;
+        }
+
+        arena_chunk_t *chunk = chunk_alloc(pages);
+        if (!chunk) return NULL;
+
+        chunk->prev = arena->current;
+        arena->current = chunk;
+        arena->total_bytes += chunk->size;
+        start = align_up((uint32_t)chunk + sizeof(arena_chunk_t), align);
+    }
+
+    arena->offset = start + size - (uint32_t)arena->current;
+    arena->used_bytes += size;
+    if (arena->used_bytes > arena->peak_bytes) {
+        arena->peak_bytes = arena->used_bytes;
+    }
+
+    return (void *)start;
+}
+
+// 从区域分配内存
+void *arena_alloc(arena_t *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGN);
+}
+
+// 从区域分配并清零
+void *arena_zalloc(arena_t *arena, size_t size) {
+    void *ptr = arena_alloc(arena, size);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+// 复制字符串到区域
+char *arena_strdup(arena_t *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc_aligned(arena, len, 1);
+    if (copy) memcpy(copy, str, len);
+    return copy;
+}
+
+// 保存当前分配位置，用于嵌套作用域
+arena_mark_t arena_save(arena_t *arena) {
+    arena_mark_t mark = { arena->current, arena->offset, arena->used_bytes };
+    return mark;
+}
+
+// 回退到保存的位置，释放其后分配的全部内存
+void arena_restore(arena_t *arena, arena_mark_t mark) {
+    if (!arena || !mark.chunk) return;
+
+    chunk_free_until(arena, mark.chunk);
+    arena->current = mark.chunk;
+    arena->offset = mark.offset;
+    arena->used_bytes = mark.used;
+}
+
+// 释放区域内的全部分配，只保留第一个块供复用
+void arena_reset(arena_t *arena) {
+    if (!arena) return;
+
+    // 第一个块即包含描述符的块
+    arena_chunk_t *first = (arena_chunk_t *)arena - 1;
+
+    chunk_free_until(arena, first);
+    arena->current = first;
+    arena->offset = align_up(sizeof(arena_chunk_t) + sizeof(arena_t), ARENA_ALIGN);
+    arena->used_bytes = 0;
+}
+
+// 销毁区域分配器
+void arena_destroy(arena_t *arena) {
+    if (!arena) return;
+
+    arena_chunk_t *first = (arena_chunk_t *)arena - 1;
+
+    chunk_free_until(arena, first);
+    mm_free_pages(first, first->pages);
+}
+
+// 获取区域统计信息
+void arena_get_stats(arena_t *arena, arena_stats_t *stats) {
+    if (!arena || !stats) return;
+
+    stats->total_bytes = arena->total_bytes;
+    stats->used_bytes = arena->used_bytes;
+    stats->peak_bytes = arena->peak_bytes;
+}
+
+// 获取当前任务的临时区域（首次使用时创建）
+arena_t *task_scratch_arena(void) {
+    task_t *current = task_get_current();
+    if (!current) return NULL;
+
+    if (!current->scratch) {
+        current->scratch = arena_create(ARENA_DEFAULT_PAGES);
+    }
+    return current->scratch;
+}
+
+// 释放任务的临时区域（任务删除时调用）
+void task_scratch_release(task_t *task) {
+    if (!task || !task->scratch) return;
+
+    arena_destroy(task->scratch);
+    task->scratch = NULL;
+}
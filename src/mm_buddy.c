@@ -0,0 +1,405 @@
+#include "mm.h"
+#include "mmu.h"
+#include "sync.h"
+#include "task.h"
+#include <string.h>
+
+// 链接脚本导出的内核镜像结束地址
+extern char _kernel_end[];
+
+#define DMA_ZONE_PAGES     (DMA_ZONE_SIZE >> PAGE_SHIFT)
+
+// 每CPU order-0页缓存参数
+#define PCP_HIGH           64      // 超过该数量时批量归还
+#define PCP_BATCH          16      // 批量补充/归还的页数
+
+// 空闲链表
+typedef struct {
+    page_t *head;
+    uint32_t nr_free;
+} free_area_t;
+
+// 内存区域
+typedef struct {
+    const char *name;
+    uint32_t start_pfn;                    // 起始页帧号
+    uint32_t nr_pages;                     // 页数
+    uint32_t free_pages;                   // 空闲页数（不含每CPU缓存）
+    free_area_t free_area[MAX_ORDER];      // 各阶空闲链表
+    spinlock_t lock;                       // 区域锁
+} zone_t;
+
+// 每CPU页缓存
+typedef struct {
+    page_t *list;
+    uint32_t count;
+} __attribute__((aligned(CACHE_LINE_SIZE))) pcp_t;
+
+// 页描述符数组
+page_t mem_map[RAM_PAGES];
+
+static zone_t zones[ZONE_COUNT];
+static pcp_t pcp[MAX_CPUS][ZONE_COUNT];
+
+// 每阶空闲位图：块首页为某阶空闲块时置位
+static uint32_t free_bitmap_storage[(RAM_PAGES * 2) / 32];
+static uint32_t *free_bitmap[MAX_ORDER];
+
+static inline bool bitmap_test(uint32_t order, uint32_t pfn) {
+    uint32_t idx = pfn >> order;
+    return free_bitmap[order][idx / 32] & (1u << (idx % 32));
+}
+
+static inline void bitmap_set(uint32_t order, uint32_t pfn) {
+    uint32_t idx = pfn >> order;
+    free_bitmap[order][idx / 32] |= (1u << (idx % 32));
+}
+
+static inline void bitmap_clear(uint32_t order, uint32_t pfn) {
+    uint32_t idx = pfn >> order;
+    free_bitmap[order][idx / 32] &= ~(1u << (idx % 32));
+}
+
+static inline uint32_t page_to_pfn(page_t *page) {
+    return page - mem_map;
+}
+
+// 物理页帧号转换为页描述符
+page_t *pfn_to_page(uint32_t pfn) {
+    return pfn < RAM_PAGES ? &mem_map[pfn] : NULL;
+}
+
+// 地址转换为页描述符（RAM恒等映射）
+page_t *virt_to_page(void *addr) {
+    uint32_t a = (uint32_t)addr;
+    if (a < RAM_BASE || a >= RAM_BASE + RAM_SIZE) return NULL;
+    return &mem_map[(a - RAM_BASE) >> PAGE_SHIFT];
+}
+
+// 页描述符转换为地址
+void *page_to_virt(page_t *page) {
+    return (void *)(RAM_BASE + (page_to_pfn(page) << PAGE_SHIFT));
+}
+
+// 页数转换为阶数（向上取整）
+uint32_t pages_to_order(uint32_t count) {
+    uint32_t order = 0;
+    while ((1u << order) < count) {
+        order++;
+    }
+    return order;
+}
+
+static void free_list_add(zone_t *zone, page_t *page, uint32_t order) {
+    free_area_t *area = &zone->free_area[order];
+
+    page->order = order;
+    page->flags |= PG_BUDDY;
+    page->prev = NULL;
+    page->next = area->head;
+    if (area->head) {
+        area->head->prev = page;
+    }
+    area->head = page;
+    area->nr_free++;
+    bitmap_set(order, page_to_pfn(page));
+}
+
+static void free_list_del(zone_t *zone, page_t *page, uint32_t order) {
+    free_area_t *area = &zone->free_area[order];
+
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        area->head = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->next = page->prev = NULL;
+    page->flags &= ~PG_BUDDY;
+    area->nr_free--;
+    bitmap_clear(order, page_to_pfn(page));
+}
+
+// 从区域中分配2^order页（调用者持有zone->lock）
+static page_t *zone_alloc_locked(zone_t *zone, uint32_t order) {
+    uint32_t current;
+
+    // 找到满足要求的最小阶空闲块
+    for (current = order; current < MAX_ORDER; current++) {
+        if (zone->free_area[current].head) break;
+    }
+    if (current == MAX_ORDER) return NULL;
+
+    page_t *page = zone->free_area[current].head;
+    free_list_del(zone, page, current);
+
+    // 逐级拆分，后半部分放回低阶链表
+    while (current > order) {
+        current--;
+        page_t *buddy = page + (1u << current);
+        free_list_add(zone, buddy, current);
+    }
+
+    page->order = order;
+    zone->free_pages -= 1u << order;
+    return page;
+}
+
+// 释放2^order页到区域并与伙伴合并（调用者持有zone->lock）
+static void zone_free_locked(zone_t *zone, page_t *page, uint32_t order) {
+    uint32_t pfn = page_to_pfn(page);
+
+    zone->free_pages += 1u << order;
+
+    while (order < MAX_ORDER - 1) {
+        uint32_t buddy_pfn = pfn ^ (1u << order);
+
+        // 伙伴必须在同一区域内且为同阶空闲块
+        if (buddy_pfn < zone->start_pfn ||
+            buddy_pfn >= zone->start_pfn + zone->nr_pages ||
+            !bitmap_test(order, buddy_pfn)) {
+            break;
+        }
+
+        free_list_del(zone, &mem_map[buddy_pfn], order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+
+    free_list_add(zone, &mem_map[pfn], order);
+}
+
+// 将一段连续页按最大对齐块加入空闲链表
+static void zone_add_range(zone_t *zone, uint32_t start_pfn, uint32_t end_pfn) {
+    uint32_t pfn = start_pfn;
+
+    while (pfn < end_pfn) {
+        uint32_t order = MAX_ORDER - 1;
+        while (order > 0 &&
+               ((pfn & ((1u << order) - 1)) || pfn + (1u << order) > end_pfn)) {
+            order--;
+        }
+        zone_free_locked(zone, &mem_map[pfn], order);
+        pfn += 1u << order;
+    }
+}
+
+// 初始化伙伴分配器
+void buddy_init(void) {
+    memset(mem_map, 0, sizeof(mem_map));
+    memset(free_bitmap_storage, 0, sizeof(free_bitmap_storage));
+    memset(pcp, 0, sizeof(pcp));
+
+    uint32_t *bitmap = free_bitmap_storage;
+    for (uint32_t order = 0; order < MAX_ORDER; order++) {
+        free_bitmap[order] = bitmap;
+        bitmap += ((RAM_PAGES >> order) + 31) / 32;
+    }
+
+    zones[ZONE_DMA].name = "DMA";
+    zones[ZONE_DMA].start_pfn = 0;
+    zones[ZONE_DMA].nr_pages = DMA_ZONE_PAGES;
+    zones[ZONE_NORMAL].name = "Normal";
+    zones[ZONE_NORMAL].start_pfn = DMA_ZONE_PAGES;
+    zones[ZONE_NORMAL].nr_pages = RAM_PAGES - DMA_ZONE_PAGES;
+
+    // 内核镜像、页表等保留区域不进入分配器
+    uint32_t reserved_end = ((uint32_t)_kernel_end - RAM_BASE + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    for (uint32_t pfn = 0; pfn < reserved_end && pfn < RAM_PAGES; pfn++) {
+        mem_map[pfn].flags = PG_RESERVED;
+    }
+
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        zone_t *zone = &zones[z];
+        uint32_t start = zone->start_pfn;
+        uint32_t end = zone->start_pfn + zone->nr_pages;
+
+        spinlock_init(&zone->lock, zone->name);
+        if (start < reserved_end) start = reserved_end;
+        if (start < end) {
+            zone_add_range(zone, start, end);
+        }
+    }
+}
+
+// 将每CPU缓存的页全部归还伙伴系统
+static void pcp_drain(uint32_t cpu) {
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        zone_t *zone = &zones[z];
+        pcp_t *p = &pcp[cpu][z];
+
+        spinlock_lock(&zone->lock);
+        while (p->list) {
+            page_t *page = p->list;
+            p->list = page->next;
+            page->next = NULL;
+            zone_free_locked(zone, page, 0);
+        }
+        p->count = 0;
+        spinlock_unlock(&zone->lock);
+    }
+}
+
+// 从每CPU缓存分配单页（调用者已禁止抢占）
+static page_t *pcp_alloc(zone_t *zone, pcp_t *p) {
+    if (!p->list) {
+        // 批量从伙伴系统补充，只获取一次区域锁
+        spinlock_lock(&zone->lock);
+        for (int i = 0; i < PCP_BATCH; i++) {
+            page_t *page = zone_alloc_locked(zone, 0);
+            if (!page) break;
+            page->next = p->list;
+            p->list = page;
+            p->count++;
+        }
+        spinlock_unlock(&zone->lock);
+
+        if (!p->list) return NULL;
+    }
+
+    page_t *page = p->list;
+    p->list = page->next;
+    page->next = NULL;
+    p->count--;
+    return page;
+}
+
+// 释放单页到每CPU缓存（调用者已禁止抢占）
+static void pcp_free(zone_t *zone, pcp_t *p, page_t *page) {
+    page->next = p->list;
+    p->list = page;
+    p->count++;
+
+    if (p->count > PCP_HIGH) {
+        spinlock_lock(&zone->lock);
+        for (int i = 0; i < PCP_BATCH && p->list; i++) {
+            page_t *victim = p->list;
+            p->list = victim->next;
+            victim->next = NULL;
+            p->count--;
+            zone_free_locked(zone, victim, 0);
+        }
+        spinlock_unlock(&zone->lock);
+    }
+}
+
+static page_t *zone_alloc(zone_t *zone, uint32_t order) {
+    page_t *page;
+
+    preempt_disable();
+    if (order == 0) {
+        page = pcp_alloc(zone, &pcp[smp_processor_id()][zone - zones]);
+    } else {
+        spinlock_lock(&zone->lock);
+        page = zone_alloc_locked(zone, order);
+        spinlock_unlock(&zone->lock);
+    }
+    preempt_enable();
+
+    return page;
+}
+
+// 分配2^order个连续物理页
+page_t *alloc_pages(uint32_t gfp, uint32_t order) {
+    if (order >= MAX_ORDER) return NULL;
+
+    page_t *page = NULL;
+
+    // 普通分配优先使用Normal区，保留DMA区给设备缓冲
+    if (!(gfp & GFP_DMA)) {
+        page = zone_alloc(&zones[ZONE_NORMAL], order);
+    }
+    if (!page) {
+        page = zone_alloc(&zones[ZONE_DMA], order);
+    }
+
+    // 高阶分配失败时，归还本CPU缓存的单页以便合并后重试
+    if (!page && order > 0) {
+        preempt_disable();
+        pcp_drain(smp_processor_id());
+        preempt_enable();
+
+        if (!(gfp & GFP_DMA)) {
+            page = zone_alloc(&zones[ZONE_NORMAL], order);
+        }
+        if (!page) {
+            page = zone_alloc(&zones[ZONE_DMA], order);
+        }
+    }
+
+    if (page) {
+        page->order = order;
+        page->flags &= ~PG_BUDDY;
+        if (gfp & GFP_ZERO) {
+            memset(page_to_virt(page), 0, PAGE_SIZE << order);
+        }
+    }
+
+    return page;
+}
+
+// 释放2^order个连续物理页
+void free_pages(page_t *page, uint32_t order) {
+    if (!page || (page->flags & (PG_RESERVED | PG_BUDDY))) return;
+
+    uint32_t pfn = page_to_pfn(page);
+    zone_t *zone = &zones[pfn < DMA_ZONE_PAGES ? ZONE_DMA : ZONE_NORMAL];
+
+    preempt_disable();
+    if (order == 0) {
+        pcp_free(zone, &pcp[smp_processor_id()][zone - zones], page);
+    } else {
+        spinlock_lock(&zone->lock);
+        zone_free_locked(zone, page, order);
+        spinlock_unlock(&zone->lock);
+    }
+    preempt_enable();
+}
+
+// 分配count个连续页（按2的幂向上取整，块按自身大小自然对齐）
+void *mm_alloc_pages(uint32_t count) {
+    if (count == 0) return NULL;
+
+    page_t *page = alloc_pages(GFP_KERNEL, pages_to_order(count));
+    return page ? page_to_virt(page) : NULL;
+}
+
+// 释放mm_alloc_pages分配的页
+void mm_free_pages(void *addr, uint32_t count) {
+    if (!addr || count == 0) return;
+
+    free_pages(virt_to_page(addr), pages_to_order(count));
+}
+
+// 分配DMA区连续页（设备可直接访问的低端内存）
+void *mm_alloc_dma_pages(uint32_t count) {
+    if (count == 0) return NULL;
+
+    page_t *page = alloc_pages(GFP_DMA, pages_to_order(count));
+    return page ? page_to_virt(page) : NULL;
+}
+
+// 获取区域统计信息
+int buddy_get_zone_info(zone_type_t type, zone_info_t *info) {
+    if (type >= ZONE_COUNT || !info) return -1;
+
+    zone_t *zone = &zones[type];
+
+    spinlock_lock(&zone->lock);
+    info->name = zone->name;
+    info->nr_pages = zone->nr_pages;
+    info->free_pages = zone->free_pages;
+    for (uint32_t order = 0; order < MAX_ORDER; order++) {
+        info->nr_free[order] = zone->free_area[order].nr_free;
+    }
+    spinlock_unlock(&zone->lock);
+
+    info->pcp_pages = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        info->pcp_pages += pcp[cpu][type].count;
+    }
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include "mm.h"
+#include "task.h"
+#include <string.h>
+
+// magazine：固定容量的对象指针栈
+typedef struct magazine {
+    uint32_t rounds;                // 当前对象数
+    void *objs[MAG_ROUNDS];         // 对象指针
+} magazine_t;
+
+// 每CPU的尺寸类缓存：loaded为当前使用，previous用于满/空时交换
+typedef struct {
+    magazine_t *loaded;
+    magazine_t *previous;
+    magazine_t mags[2];
+} mag_class_cache_t;
+
+// 每CPU缓存
+typedef struct {
+    mag_class_cache_t classes[MAG_CLASS_COUNT];
+    mag_stats_t stats;
+} __attribute__((aligned(64))) mag_cpu_cache_t;
+
+// 任务私有缓存
+struct mm_task_cache {
+    magazine_t mags[MAG_CLASS_COUNT];
+};
+
+static mag_cpu_cache_t cpu_caches[MAX_CPUS];
+
+// 根据请求大小计算尺寸类（向上取整到2的幂）
+static inline int size_to_class(size_t size) {
+    if (size <= (1 << MAG_MIN_SHIFT)) return 0;
+    int cls = 32 - __builtin_clz(size - 1) - MAG_MIN_SHIFT;
+    return cls < MAG_CLASS_COUNT ? cls : -1;
+}
+
+// 根据块实际大小计算可放入的尺寸类（向下取整，避免浪费过多）
+static inline int block_to_class(size_t block_size) {
+    if (block_size < (1 << MAG_MIN_SHIFT)) return -1;
+    int cls = 31 - __builtin_clz(block_size) - MAG_MIN_SHIFT;
+    return cls < MAG_CLASS_COUNT ? cls : -1;
+}
+
+static inline size_t class_size(int cls) {
+    return (size_t)1 << (cls + MAG_MIN_SHIFT);
+}
+
+// 初始化magazine缓存
+void mm_magazine_init(void) {
+    memset(cpu_caches, 0, sizeof(cpu_caches));
+
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        for (int cls = 0; cls < MAG_CLASS_COUNT; cls++) {
+            mag_class_cache_t *cc = &cpu_caches[cpu].classes[cls];
+            cc->loaded = &cc->mags[0];
+            cc->previous = &cc->mags[1];
+        }
+    }
+}
+
+// 从任务私有缓存分配
+static void *task_cache_alloc(struct mm_task_cache *tc, int cls) {
+    magazine_t *mag = &tc->mags[cls];
+
+    if (mag->rounds == 0) {
+        mag->rounds = mm_heap_alloc_batch(class_size(cls), mag->objs, MAG_BATCH);
+        if (mag->rounds == 0) return NULL;
+    }
+    return mag->objs[--mag->rounds];
+}
+
+// 放回任务私有缓存
+static void task_cache_free(struct mm_task_cache *tc, int cls, void *addr) {
+    magazine_t *mag = &tc->mags[cls];
+
+    if (mag->rounds == MAG_ROUNDS) {
+        mm_heap_free_batch(&mag->objs[MAG_BATCH], MAG_ROUNDS - MAG_BATCH);
+        mag->rounds = MAG_BATCH;
+    }
+    mag->objs[mag->rounds++] = addr;
+}
+
+// 分配小对象：快速路径只需禁止抢占
+void *mm_magazine_alloc(size_t size) {
+    int cls = size_to_class(size);
+    if (cls < 0) return NULL;
+
+    task_t *current = task_get_current();
+    if (current && current->mm_cache) {
+        return task_cache_alloc(current->mm_cache, cls);
+    }
+
+    preempt_disable();
+    mag_cpu_cache_t *cpu = &cpu_caches[smp_processor_id()];
+    mag_class_cache_t *cc = &cpu->classes[cls];
+
+    // loaded为空时与previous交换
+    if (cc->loaded->rounds == 0 && cc->previous->rounds > 0) {
+        magazine_t *tmp = cc->loaded;
+        cc->loaded = cc->previous;
+        cc->previous = tmp;
+    }
+
+    if (cc->loaded->rounds > 0) {
+        void *ptr = cc->loaded->objs[--cc->loaded->rounds];
+        cpu->stats.hits++;
+        cpu->stats.cached_objs--;
+        preempt_enable();
+        return ptr;
+    }
+    preempt_enable();
+
+    // 慢速路径：批量从全局堆补充（可能在mm_lock上睡眠，必须允许抢占）
+    void *batch[MAG_BATCH];
+    uint32_t n = mm_heap_alloc_batch(class_size(cls), batch, MAG_BATCH);
+    if (n == 0) return NULL;
+
+    // 重新获取当前CPU（期间可能发生迁移），装入剩余对象
+    preempt_disable();
+    cpu = &cpu_caches[smp_processor_id()];
+    cc = &cpu->classes[cls];
+    uint32_t kept = 1;
+    while (kept < n && cc->loaded->rounds < MAG_ROUNDS) {
+        cc->loaded->objs[cc->loaded->rounds++] = batch[kept++];
+    }
+    cpu->stats.refills++;
+    cpu->stats.cached_objs += kept - 1;
+    preempt_enable();
+
+    // 装不下的对象归还全局堆
+    if (kept < n) {
+        mm_heap_free_batch(&batch[kept], n - kept);
+    }
+
+    return batch[0];
+}
+
+// 释放小对象到缓存，返回false表示不属于缓存尺寸类
+bool mm_magazine_free(void *addr) {
+    int cls = block_to_class(mm_heap_block_size(addr));
+    if (cls < 0) return false;
+
+    task_t *current = task_get_current();
+    if (current && current->mm_cache) {
+        task_cache_free(current->mm_cache, cls, addr);
+        return true;
+    }
+
+    void *flush[MAG_ROUNDS];
+    uint32_t flush_count = 0;
+
+    preempt_disable();
+    mag_cpu_cache_t *cpu = &cpu_caches[smp_processor_id()];
+    mag_class_cache_t *cc = &cpu->classes[cls];
+
+    // loaded已满时与previous交换；两者都满则回收previous
+    if (cc->loaded->rounds == MAG_ROUNDS) {
+        magazine_t *tmp = cc->previous;
+        cc->previous = cc->loaded;
+        cc->loaded = tmp;
+
+        if (cc->loaded->rounds == MAG_ROUNDS) {
+            flush_count = MAG_ROUNDS - MAG_BATCH;
+            memcpy(flush, &cc->loaded->objs[MAG_BATCH], flush_count * sizeof(void *));
+            cc->loaded->rounds = MAG_BATCH;
+            cpu->stats.flushes++;
+            cpu->stats.cached_objs -= flush_count;
+        }
+    }
+
+    cc->loaded->objs[cc->loaded->rounds++] = addr;
+    cpu->stats.cached_objs++;
+    preempt_enable();
+
+    // 在允许抢占的情况下批量归还全局堆
+    if (flush_count) {
+        mm_heap_free_batch(flush, flush_count);
+    }
+
+    return true;
+}
+
+// 将当前CPU缓存的全部对象归还全局堆（内存紧张时调用）
+void mm_magazine_drain(void) {
+    void *flush[MAG_ROUNDS];
+
+    for (int cls = 0; cls < MAG_CLASS_COUNT; cls++) {
+        for (int m = 0; m < 2; m++) {
+            uint32_t count;
+
+            preempt_disable();
+            mag_cpu_cache_t *cpu = &cpu_caches[smp_processor_id()];
+            magazine_t *mag = &cpu->classes[cls].mags[m];
+            count = mag->rounds;
+            memcpy(flush, mag->objs, count * sizeof(void *));
+            mag->rounds = 0;
+            cpu->stats.cached_objs -= count;
+            preempt_enable();
+
+            if (count) {
+                mm_heap_free_batch(flush, count);
+            }
+        }
+    }
+}
+
+// 获取所有CPU的汇总统计
+void mm_magazine_get_stats(mag_stats_t *stats) {
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(mag_stats_t));
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        stats->hits += cpu_caches[cpu].stats.hits;
+        stats->refills += cpu_caches[cpu].stats.refills;
+        stats->flushes += cpu_caches[cpu].stats.flushes;
+        stats->cached_objs += cpu_caches[cpu].stats.cached_objs;
+    }
+}
+
+// 为任务启用私有缓存（适合分配密集、生命周期长的任务）
+int mm_task_cache_enable(task_t *task) {
+    if (!task) return -1;
+    if (task->mm_cache) return 0;
+
+    struct mm_task_cache *tc = mm_heap_alloc(sizeof(struct mm_task_cache));
+    if (!tc) return -1;
+
+    memset(tc, 0, sizeof(struct mm_task_cache));
+    task->mm_cache = tc;
+    return 0;
+}
+
+// 释放任务私有缓存（任务删除时调用）
+void mm_task_cache_release(task_t *task) {
+    if (!task || !task->mm_cache) return;
+
+    struct mm_task_cache *tc = task->mm_cache;
+    task->mm_cache = NULL;
+
+    for (int cls = 0; cls < MAG_CLASS_COUNT; cls++) {
+        mm_heap_free_batch(tc->mags[cls].objs, tc->mags[cls].rounds);
+    }
+    mm_heap_free(tc);
+}
@@ -0,0 +1,148 @@
+#include "mm.h"
+#include "sync.h"
+#include "timer.h"
+#include <string.h>
+
+/*
+ * 固定块内存池：块从静态缓冲区切分，空闲块组成无锁LIFO链表。
+ * 链表头为64位 {块地址, ABA标签}，通过ldrexd/strexd整体比较交换，
+ * 因此mempool_alloc/mempool_free可在中断上下文中调用。
+ * mempool_alloc_wait的等待者通过计数信号量唤醒，semaphore_post只关中断，
+ * 有任务阻塞等待时mempool_free仍可在中断上下文调用。
+ */
+
+static inline uint64_t make_head(uint32_t block, uint32_t tag) {
+    return ((uint64_t)tag << 32) | block;
+}
+
+static inline uint32_t head_block(uint64_t head) {
+    return (uint32_t)head;
+}
+
+static inline uint32_t head_tag(uint64_t head) {
+    return (uint32_t)(head >> 32);
+}
+
+// 初始化内存池，buffer由调用者提供（通常为静态数组）
+int mempool_init(mempool_t *pool, const char *name, void *buffer,
+                 uint32_t buffer_size, uint32_t block_size) {
+    if (!pool || !buffer) return -1;
+
+    // 块大小至少容纳一个指针并保持8字节对齐
+    if (block_size < sizeof(void *)) block_size = sizeof(void *);
+    block_size = (block_size + 7) & ~7;
+
+    uint32_t start = ((uint32_t)buffer + 7) & ~7;
+    uint32_t usable = buffer_size - (start - (uint32_t)buffer);
+    uint32_t count = usable / block_size;
+    if (count == 0) return -1;
+
+    memset(pool, 0, sizeof(mempool_t));
+    pool->name = name;
+    pool->base = (uint8_t *)start;
+    pool->block_size = block_size;
+    pool->block_count = count;
+    semaphore_init(&pool->wait_sem, 0, name);
+
+    // 逆序串联，使首次分配得到低地址块
+    uint32_t head = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        uint32_t block = start + i * block_size;
+        *(uint32_t *)block = head;
+        head = block;
+    }
+    pool->free_head = make_head(head, 0);
+
+    return 0;
+}
+
+// 从内存池分配一个块（无锁，可在中断上下文调用），池空时返回NULL
+void *mempool_alloc(mempool_t *pool) {
+    uint64_t old_head, new_head;
+
+    old_head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+    do {
+        uint32_t block = head_block(old_head);
+        if (!block) {
+            __atomic_add_fetch(&pool->alloc_failures, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        // 块始终位于池缓冲区内，即使已被其他CPU取走读取也是安全的，标签保证不会误交换
+        uint32_t next = *(volatile uint32_t *)block;
+        new_head = make_head(next, head_tag(old_head) + 1);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &old_head, new_head, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    // 更新使用量与高水位
+    uint32_t in_use = __atomic_add_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+    uint32_t high = __atomic_load_n(&pool->high_water, __ATOMIC_RELAXED);
+    while (in_use > high &&
+           !__atomic_compare_exchange_n(&pool->high_water, &high, in_use, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    return (void *)head_block(old_head);
+}
+
+// 归还块到内存池（无锁，可在中断上下文调用）
+void mempool_free(mempool_t *pool, void *ptr) {
+    uint32_t block = (uint32_t)ptr;
+    uint64_t old_head, new_head;
+
+    // 校验块属于本池且地址对齐
+    if (block < (uint32_t)pool->base ||
+        block >= (uint32_t)pool->base + pool->block_count * pool->block_size ||
+        (block - (uint32_t)pool->base) % pool->block_size) {
+        return;
+    }
+
+    old_head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+    do {
+        *(volatile uint32_t *)block = head_block(old_head);
+        new_head = make_head(block, head_tag(old_head) + 1);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &old_head, new_head, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_sub_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+
+    // 有任务在等待时唤醒一个。屏障与等待方的屏障配对：要么看到等待者，要么等待方的重试能拿到此块；
+    // 等待方尚未睡眠时释放的计数保留在信号量中，随后的等待立即返回，唤醒不会丢失
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->waiters, __ATOMIC_RELAXED)) {
+        semaphore_post(&pool->wait_sem);
+    }
+}
+
+// 分配块，池空时阻塞等待（仅限任务上下文），timeout_ms为0表示不等待
+void *mempool_alloc_wait(mempool_t *pool, uint32_t timeout_ms) {
+    void *block = mempool_alloc(pool);
+    if (block || timeout_ms == 0) return block;
+
+    uint32_t start = timer_get_ticks();
+
+    // 先登记等待者再重试，每次被唤醒后重新检查空闲链表（计数只作提示，块可能已被他人取走）
+    __atomic_add_fetch(&pool->waiters, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    while (!(block = mempool_alloc(pool))) {
+        uint32_t elapsed = timer_get_ticks() - start;
+        if (elapsed >= timeout_ms) break;
+
+        semaphore_timedwait(&pool->wait_sem, timeout_ms - elapsed);
+    }
+
+    __atomic_sub_fetch(&pool->waiters, 1, __ATOMIC_RELAXED);
+
+    return block;
+}
+
+// 获取内存池统计信息
+void mempool_get_stats(mempool_t *pool, mempool_stats_t *stats) {
+    if (!pool || !stats) return;
+
+    stats->block_size = pool->block_size;
+    stats->block_count = pool->block_count;
+    stats->in_use = pool->in_use;
+    stats->high_water = pool->high_water;
+    stats->alloc_failures = pool->alloc_failures;
+}
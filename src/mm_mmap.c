@@ -0,0 +1,535 @@
+#include "mm.h"
+#include "mmu.h"
+#include "fs.h"
+#include "task.h"
+#include <string.h>
+
+#define FAULT_AROUND_PAGES  16      // 每次缺页最多映射的相邻缓存页数（2的幂）
+#define RA_MIN_PAGES        4       // 检测到顺序访问后的初始预读窗口
+#define RA_MAX_PAGES        64      // 预读窗口上限
+#define ZAP_BATCH           16      // 解除映射时每批延迟释放的页数
+
+static kmem_cache_t *mm_cache;
+
+static inline uint32_t vma_prot(vm_area_t *vma, bool writable) {
+    uint32_t prot = 0;
+    if (vma->flags & PROT_READ) prot |= MMU_PERM_READ;
+    if (writable) prot |= MMU_PERM_WRITE;
+    if (vma->flags & PROT_EXEC) prot |= MMU_PERM_EXEC;
+    return prot | MMU_PERM_MT((vma->flags & PROT_MT_MASK) >> 8);
+}
+
+// 区域内虚拟地址对应的文件页号
+static inline uint32_t vma_pgoff(vm_area_t *vma, uint32_t va) {
+    return vma->pgoff + ((va - vma->start) >> PAGE_SHIFT);
+}
+
+// 查找与[start, end)重叠的第一个区域
+static vm_area_t *vma_find_overlap(mm_struct_t *mm, uint32_t start, uint32_t end) {
+    vm_area_t *vma = vma_find(mm, start);
+    return (vma && vma->start < end) ? vma : NULL;
+}
+
+// 向上对齐到align，并保持与phase同余（物理映射的虚拟地址与物理地址在块内偏移一致才能使用大块映射）
+static inline uint32_t gap_align(uint32_t addr, uint32_t align, uint32_t phase) {
+    phase &= align - 1;
+    return ((addr - phase + align - 1) & ~(align - 1)) + phase;
+}
+
+// 在用户空间中查找足够大的空闲区间（区域链表按起始地址有序），起始地址按align对齐
+static uint32_t vma_find_gap(mm_struct_t *mm, uint32_t length, uint32_t align, uint32_t phase) {
+    uint32_t addr = gap_align(USER_SPACE_BASE, align, phase);
+
+    for (vm_area_t *vma = mm->mmap; vma; vma = vma->next) {
+        if (vma->start >= addr + length) {
+            break;
+        }
+        if (vma->end > addr) {
+            addr = gap_align(vma->end, align, phase);
+        }
+    }
+
+    if (addr + length > USER_SPACE_BASE + USER_SPACE_SIZE || addr + length < addr) {
+        return 0;
+    }
+    return addr;
+}
+
+// 物理映射的虚拟地址对齐：取长度能容纳的最大映射粒度
+static uint32_t phys_map_align(uint32_t len) {
+    if (len >= 16 * SECTION_SIZE) return 16 * SECTION_SIZE;
+    if (len >= SECTION_SIZE) return SECTION_SIZE;
+    if (len >= 16 * PAGE_SIZE) return 16 * PAGE_SIZE;
+    return PAGE_SIZE;
+}
+
+// 建立映射区域，ino为0时为匿名映射；页面在首次访问时按需建立，物理映射立即建立
+static void *do_mmap(void *addr, size_t length, int prot, int flags,
+                     uint32_t ino, uint32_t pgoff, uint32_t phys) {
+    mm_struct_t *mm = task_get_current()->mm;
+    if (!mm || length == 0) {
+        return NULL;
+    }
+
+    if (!(flags & (MAP_PRIVATE | MAP_SHARED)) ||
+        ((flags & MAP_PRIVATE) && (flags & MAP_SHARED))) {
+        return NULL;
+    }
+
+    // 匿名页与文件页会经内核可缓存映射清零、复制、换出和压缩，只有物理映射能指定内存类型
+    if ((prot & PROT_MT_MASK) && !(flags & MAP_PHYS)) {
+        return NULL;
+    }
+
+    uint32_t len = (length + PAGE_SIZE - 1) & PAGE_MASK;
+    uint32_t start;
+
+    if (flags & MAP_FIXED) {
+        start = (uint32_t)addr;
+        if ((start & ~PAGE_MASK) || start < USER_SPACE_BASE ||
+            start + len > USER_SPACE_BASE + USER_SPACE_SIZE ||
+            vma_find_overlap(mm, start, start + len)) {
+            return NULL;
+        }
+    } else {
+        uint32_t align = (flags & MAP_PHYS) ? phys_map_align(len) : PAGE_SIZE;
+        start = vma_find_gap(mm, len, align, phys);
+        if (!start) {
+            return NULL;
+        }
+    }
+
+    vm_area_t *vma = vma_alloc();
+    if (!vma) {
+        return NULL;
+    }
+
+    vma->start = start;
+    vma->end = start + len;
+    vma->flags = prot;
+    vma->map_flags = flags;
+    vma->ino = ino;
+    vma->pgoff = pgoff;
+    vma->ra_next = pgoff;
+    vma->phys = phys;
+
+    if ((flags & MAP_PHYS) &&
+        mmu_map_range(start, phys, len, vma_prot(vma, prot & PROT_WRITE)) < 0) {
+        mmu_unmap_range(start, len);
+        vma_free(vma);
+        return NULL;
+    }
+
+    // 与相邻的兼容区域合并，避免连续的小映射使区域数无限增长
+    vma_link(mm, vma);
+    vma_merge(mm, vma);
+    return (void *)start;
+}
+
+// 匿名内存映射
+void *mm_mmap(void *addr, size_t length, int prot, int flags) {
+    return do_mmap(addr, length, prot, (flags | MAP_ANONYMOUS) & ~MAP_PHYS, 0, 0, 0);
+}
+
+// 文件映射：页面直接取自块缓存，offset必须页对齐
+void *mm_mmap_file(void *addr, size_t length, int prot, int flags, int fd, uint32_t offset) {
+    uint32_t ino;
+
+    if ((offset & ~PAGE_MASK) || (flags & (MAP_ANONYMOUS | MAP_PHYS))) {
+        return NULL;
+    }
+    if (fs_get_inode(fd, &ino) < 0) {
+        return NULL;
+    }
+
+    return do_mmap(addr, length, prot, flags, ino, offset >> PAGE_SHIFT, 0);
+}
+
+// 映射物理连续区域（共享内存段、音频特征缓冲区等）：虚拟地址按长度对齐，
+// 建立时按对齐情况选用超级段、段、64KB大页或4KB小页，减少TLB项占用
+void *mm_mmap_phys(void *addr, size_t length, int prot, int flags, uint32_t phys) {
+    if (phys & ~PAGE_MASK) {
+        return NULL;
+    }
+
+    return do_mmap(addr, length, prot, (flags | MAP_PHYS) & ~MAP_ANONYMOUS, 0, 0, phys);
+}
+
+// 释放mm对单个页面的映射引用：匿名页（含私有映射的副本）交还页面替换器，缓存页解除固定，换出页释放交换槽
+static void vma_release_page(mm_struct_t *mm, vm_area_t *vma, uint32_t va, uint32_t pa, pte_t *pte) {
+    if (pa) {
+        page_t *page = virt_to_page((void *)pa);
+        if (page && (page->flags & PG_LRU)) {
+            pra_put_page((void *)pa, mm);
+        } else if (vma->ino) {
+            fs_put_page(vma->ino, vma_pgoff(vma, va));
+        }
+        return;
+    }
+
+    if (pte && pte->swap_offset) {
+        swap_free(pte->swap_offset);
+        pte->swap_offset = 0;
+    }
+}
+
+// 解除当前地址空间中整个区域的映射并释放页面引用；TLB按批失效，
+// 页面在对应TLB项失效之后才释放，避免其他核经残留TLB项访问已复用的页面
+static void vma_zap(mm_struct_t *mm, vm_area_t *vma) {
+    struct {
+        uint32_t va;
+        uint32_t pa;
+    } pending[ZAP_BATCH];
+    uint32_t nr = 0;
+    mmu_batch_t batch;
+
+    // 物理映射不持有页面引用，整段解除映射即可
+    if (vma->map_flags & MAP_PHYS) {
+        mmu_batch_begin(&batch);
+        mmu_unmap_range(vma->start, vma->end - vma->start);
+        mmu_batch_end(&batch);
+        return;
+    }
+
+    mmu_batch_begin(&batch);
+
+    for (uint32_t va = vma->start; va < vma->end; va += PAGE_SIZE) {
+        uint32_t pa = mmu_virt_to_phys(va) & PAGE_MASK;
+        if (!pa) {
+            vma_release_page(mm, vma, va, 0, mmu_get_pte(va));
+            continue;
+        }
+
+        mmu_unmap_page(va);
+        pending[nr].va = va;
+        pending[nr].pa = pa;
+
+        if (++nr == ZAP_BATCH) {
+            mmu_batch_flush(&batch);
+            for (uint32_t i = 0; i < nr; i++) {
+                vma_release_page(mm, vma, pending[i].va, pending[i].pa, NULL);
+            }
+            nr = 0;
+        }
+    }
+
+    mmu_batch_end(&batch);
+    for (uint32_t i = 0; i < nr; i++) {
+        vma_release_page(mm, vma, pending[i].va, pending[i].pa, NULL);
+    }
+}
+
+// 解除映射，部分覆盖的区域先拆分，释放范围内的页面与交换槽
+int mm_unmap(void *addr, size_t length) {
+    mm_struct_t *mm = task_get_current()->mm;
+    uint32_t start = (uint32_t)addr & PAGE_MASK;
+    uint32_t end = ((uint32_t)addr + length + PAGE_SIZE - 1) & PAGE_MASK;
+
+    if (!mm || start >= end) {
+        return -1;
+    }
+
+    vm_area_t *vma = vma_find(mm, start);
+    if (!vma || vma->start >= end) {
+        return 0;
+    }
+
+    if (vma->start < start) {
+        vma = vma_split(mm, vma, start);
+        if (!vma) {
+            return -1;
+        }
+    }
+
+    while (vma && vma->start < end) {
+        if (vma->end > end && !vma_split(mm, vma, end)) {
+            return -1;
+        }
+
+        vm_area_t *next = vma->next;
+        vma_zap(mm, vma);
+        vma_unlink(mm, vma);
+        vma_free(vma);
+        vma = next;
+    }
+
+    return 0;
+}
+
+// 换入页面并映射到当前地址空间（保持只读，交换副本仍有效），返回物理地址
+static uint32_t vma_swapin_page(mm_struct_t *mm, vm_area_t *vma, uint32_t va, pte_t *pte) {
+    void *page = swap_in(pte);
+    if (!page) {
+        return 0;
+    }
+
+    mmu_map_page(va, (uint32_t)page, vma_prot(vma, false));
+    pra_set_mapping(page, mm, va);
+    pte->swap_offset = 0;
+    return (uint32_t)page;
+}
+
+// 把区域内已建立的映射复制到子地址空间：私有映射两边都改为只读，写入时再复制
+static int vma_dup_pages(mm_struct_t *old, mm_struct_t *mm, vm_area_t *vma) {
+    bool cow = !(vma->map_flags & MAP_SHARED);
+
+    // 物理映射两边共享同一块物理内存，按相同粒度重新建立
+    if (vma->map_flags & MAP_PHYS) {
+        return mmu_pgd_map_range((uint32_t *)mm->pgd, mm->asid, vma->start, vma->phys,
+                                 vma->end - vma->start, vma_prot(vma, vma->flags & PROT_WRITE));
+    }
+
+    for (uint32_t va = vma->start; va < vma->end; va += PAGE_SIZE) {
+        uint32_t pa = mmu_virt_to_phys(va) & PAGE_MASK;
+
+        if (!pa) {
+            // 交换槽没有引用计数，先为父地址空间换入再共享物理页
+            pte_t *pte = mmu_get_pte(va);
+            if (!pte || !pte->swap_offset) {
+                continue;
+            }
+            pa = vma_swapin_page(old, vma, va, pte);
+            if (!pa) {
+                return -1;
+            }
+        }
+
+        page_t *page = virt_to_page((void *)pa);
+        bool anon = page && (page->flags & PG_LRU);
+
+        if (anon) {
+            pra_get_page((void *)pa);
+        } else if (!vma->ino || !fs_get_page(vma->ino, vma_pgoff(vma, va))) {
+            return -1;
+        }
+
+        if (mmu_pgd_copy_pte((uint32_t *)mm->pgd, va, cow) < 0) {
+            vma_release_page(mm, vma, va, pa, NULL);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// 创建地址空间描述符缓存
+void mm_mmap_init(void) {
+    mm_cache = kmem_cache_create("mm_struct", sizeof(mm_struct_t), 0, 0, NULL);
+}
+
+// 分配地址空间描述符、一级页表与ASID
+static mm_struct_t *mm_struct_alloc(void) {
+    mm_struct_t *mm = kmem_cache_alloc(mm_cache);
+    if (!mm) {
+        return NULL;
+    }
+    memset(mm, 0, sizeof(mm_struct_t));
+
+    // ASID在首次切换到该地址空间时分配
+    mm->pgd = (pde_t *)mmu_pgd_alloc();
+    if (!mm->pgd) {
+        kmem_cache_free(mm_cache, mm);
+        return NULL;
+    }
+
+    return mm;
+}
+
+// 创建空的用户地址空间
+mm_struct_t *mm_create(void) {
+    return mm_struct_alloc();
+}
+
+// 切换到任务的地址空间（上下文切换时调用），内核任务只使用内核页表
+void mm_switch(mm_struct_t *mm) {
+    if (!mm) {
+        mmu_switch_mm(NULL, NULL);
+        return;
+    }
+    mmu_switch_mm((uint32_t *)mm->pgd, &mm->asid);
+}
+
+// 复制地址空间（任务克隆）：只复制区域与页表，页面以写时复制方式共享；old必须是当前地址空间
+mm_struct_t *mm_dup(mm_struct_t *old) {
+    if (!old) {
+        return NULL;
+    }
+
+    mm_struct_t *mm = mm_struct_alloc();
+    if (!mm) {
+        return NULL;
+    }
+
+    mm->start_code = old->start_code;
+    mm->end_code = old->end_code;
+    mm->start_data = old->start_data;
+    mm->end_data = old->end_data;
+    mm->start_brk = old->start_brk;
+    mm->brk = old->brk;
+    mm->start_stack = old->start_stack;
+
+    // 父地址空间的写保护统一在复制结束时失效TLB
+    mmu_batch_t batch;
+    mmu_batch_begin(&batch);
+
+    for (vm_area_t *vma = old->mmap; vma; vma = vma->next) {
+        vm_area_t *copy = vma_alloc();
+        if (!copy) {
+            mmu_batch_end(&batch);
+            mm_destroy(mm);
+            return NULL;
+        }
+
+        *copy = *vma;
+        vma_link(mm, copy);
+
+        if (vma_dup_pages(old, mm, vma) < 0) {
+            mmu_batch_end(&batch);
+            mm_destroy(mm);
+            return NULL;
+        }
+    }
+
+    mmu_batch_end(&batch);
+    return mm;
+}
+
+// 销毁地址空间：释放所有区域的页面引用、交换槽与页表；调用时该地址空间不能是当前地址空间
+void mm_destroy(mm_struct_t *mm) {
+    if (!mm) {
+        return;
+    }
+
+    uint32_t *pgd = (uint32_t *)mm->pgd;
+
+    while (mm->mmap) {
+        vm_area_t *vma = mm->mmap;
+        mm->mmap = vma->next;
+
+        if (vma->map_flags & MAP_PHYS) {
+            vma_free(vma);
+            continue;
+        }
+
+        for (uint32_t va = vma->start; pgd && va < vma->end; va += PAGE_SIZE) {
+            uint32_t pa = mmu_pgd_virt_to_phys(pgd, va) & PAGE_MASK;
+            vma_release_page(mm, vma, va, pa, pa ? NULL : mmu_pgd_get_pte(pgd, va));
+        }
+
+        vma_free(vma);
+    }
+
+    mmu_pgd_free(pgd);
+    mmu_asid_free(mm->asid);
+    kmem_cache_free(mm_cache, mm);
+}
+
+// 私有映射写入：复制文件页到匿名页，此后该页与文件脱离
+static int filemap_copy_page(mm_struct_t *mm, vm_area_t *vma, uint32_t va, void *src) {
+    void *page = pra_alloc_page();
+    if (!page) {
+        return -1;
+    }
+
+    memcpy(page, src, PAGE_SIZE);
+    mmu_map_page(va, (uint32_t)page, vma_prot(vma, true));
+    pra_set_mapping(page, mm, va);
+    pra_mark_dirty(page);
+    return 0;
+}
+
+// 顺序访问检测：缺页落在上次映射范围之后时扩大预读窗口，否则视为随机访问
+static void filemap_readahead(vm_area_t *vma, uint32_t pgoff) {
+    if (pgoff >= vma->ra_next && pgoff < vma->ra_next + FAULT_AROUND_PAGES) {
+        vma->ra_window = vma->ra_window ? vma->ra_window * 2 : RA_MIN_PAGES;
+        if (vma->ra_window > RA_MAX_PAGES) {
+            vma->ra_window = RA_MAX_PAGES;
+        }
+    } else {
+        vma->ra_window = 0;
+    }
+
+    if (!vma->ra_window) {
+        return;
+    }
+
+    uint32_t vma_end = vma->pgoff + ((vma->end - vma->start) >> PAGE_SHIFT);
+    uint32_t nr = vma->ra_window;
+    if (pgoff + 1 + nr > vma_end) {
+        nr = vma_end > pgoff + 1 ? vma_end - pgoff - 1 : 0;
+    }
+    if (nr) {
+        fs_readahead(vma->ino, pgoff + 1, nr);
+    }
+}
+
+// 文件映射缺页处理：映射缓存页（私有映射写入时复制），并映射已缓存的相邻页
+int filemap_fault(mm_struct_t *mm, vm_area_t *vma, uint32_t va, uint32_t error_code) {
+    uint32_t pgoff = vma_pgoff(vma, va);
+    bool shared = vma->map_flags & MAP_SHARED;
+    bool write = error_code & FAULT_WRITE;
+    uint32_t pa = mmu_virt_to_phys(va) & PAGE_MASK;
+
+    // 已映射的缓存页发生写权限错误
+    if (pa) {
+        if (shared) {
+            fs_set_page_dirty(vma->ino, pgoff);
+            mmu_write_enable(va);
+            return 0;
+        }
+
+        // 私有映射：用副本替换缓存页映射
+        if (filemap_copy_page(mm, vma, va, (void *)pa) < 0) {
+            return -1;
+        }
+        fs_put_page(vma->ino, pgoff);
+        return 0;
+    }
+
+    filemap_readahead(vma, pgoff);
+
+    void *data = fs_get_page(vma->ino, pgoff);
+    if (!data) {
+        // 超出文件末尾或读取失败
+        return -1;
+    }
+
+    if (write && !shared) {
+        int ret = filemap_copy_page(mm, vma, va, data);
+        fs_put_page(vma->ino, pgoff);
+        return ret;
+    }
+
+    // 共享映射的写入直接落到缓存页；只读映射保持写保护，首次写入时再标记为脏
+    if (write) {
+        fs_set_page_dirty(vma->ino, pgoff);
+    }
+    mmu_map_page(va, (uint32_t)data, vma_prot(vma, write));
+
+    // fault-around：在对齐窗口内映射已在缓存中的相邻页，不发起I/O
+    uint32_t win_start = va & ~(FAULT_AROUND_PAGES * PAGE_SIZE - 1);
+    uint32_t win_end = win_start + FAULT_AROUND_PAGES * PAGE_SIZE;
+    if (win_start < vma->start) win_start = vma->start;
+    if (win_end > vma->end) win_end = vma->end;
+
+    uint32_t last = pgoff;
+    for (uint32_t addr = win_start; addr < win_end; addr += PAGE_SIZE) {
+        if (addr == va || mmu_virt_to_phys(addr)) {
+            continue;
+        }
+
+        uint32_t index = vma_pgoff(vma, addr);
+        void *page = fs_find_page(vma->ino, index);
+        if (!page) {
+            continue;
+        }
+
+        mmu_map_page(addr, (uint32_t)page, vma_prot(vma, false));
+        if (index > last) {
+            last = index;
+        }
+    }
+
+    vma->ra_next = last + 1;
+    return 0;
+}
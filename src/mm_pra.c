@@ -1,211 +1,629 @@
 #include "mm.h"
 #include "sync.h"
+#include "task.h"
 #include <string.h>
 
-// 页面框架描述符
-typedef struct page_frame {
-    uint32_t vaddr;            // 虚拟地址
-    uint32_t accessed;         // 访问位
-    uint32_t dirty;            // 脏位
-    uint32_t reference;        // 引用计数
-    struct page_frame *next;   // 链表指针
-} page_frame_t;
+#define PRA_MAX_FRAMES      1024    // 常驻帧上限（4MB物理内存）
+#define PRA_FREE_HIGH       64      // 空闲帧链表上限，超出部分归还伙伴系统
+#define PRA_LOW_WMARK       16      // 空闲帧低水位，低于时唤醒kswapd
+#define PRA_HIGH_WMARK      48      // 空闲帧高水位，kswapd回收到此为止
+#define PRA_SCAN_MAX        32      // 每次选择牺牲页最多检查的帧数
+#define PRA_AGING_INTERVAL  10      // NFU老化周期（tick）
+#define PRA_AGING_BATCH     64      // 每次老化处理的帧数
+#define PRA_AGE_MSB         0x80    // 8位老化计数的最高位
+#define PRA_HARVEST_BATCH   512     // 每轮扫描的页帧数
+#define PRA_HARVEST_PERIOD_MS 50    // 访问标志扫描周期
 
-// 页面替换算法上下文
+// 页面替换链表（双向链表，头部最旧）
+typedef struct {
+    page_t *head;
+    page_t *tail;
+    uint32_t count;
+} pra_list_t;
+
+// 页面替换算法上下文（帧描述符即伙伴系统的mem_map，按页帧号索引）
 typedef struct {
     pra_type_t type;          // 算法类型
-    page_frame_t *frames;     // 页面框架数组
-    uint32_t frame_count;     // 页面框架数量
-    uint32_t clock_hand;      // 时钟算法指针
+    pra_list_t free;          // 空闲帧链表
+    pra_list_t inactive;      // FIFO/时钟队列、2Q的A1队列、NFU冷页
+    pra_list_t active;        // 2Q的Am队列、NFU热页
+    uint32_t max_frames;      // 常驻帧上限
+    uint32_t allocated;       // 从伙伴系统取得的帧数（常驻+空闲）
+    uint32_t aging_ticks;     // 距上次老化的tick数
+    bool kswapd_pending;      // kswapd已被唤醒尚未完成
+    semaphore_t kswapd_wait;  // kswapd唤醒信号量
     pra_stats_t stats;        // 统计信息
-    mutex_t lock;             // 互斥锁
+    spinlock_t lock;          // 链表锁（tick中只尝试获取）
 } pra_context_t;
 
 static pra_context_t pra_ctx;
 
+static void list_add_tail(pra_list_t *list, page_t *page) {
+    page->next = NULL;
+    page->prev = list->tail;
+    if (list->tail) {
+        list->tail->next = page;
+    } else {
+        list->head = page;
+    }
+    list->tail = page;
+    list->count++;
+}
+
+static void list_del(pra_list_t *list, page_t *page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        list->head = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    } else {
+        list->tail = page->prev;
+    }
+    page->next = page->prev = NULL;
+    list->count--;
+}
+
+static page_t *list_pop_head(pra_list_t *list) {
+    page_t *page = list->head;
+    if (page) list_del(list, page);
+    return page;
+}
+
+static inline pra_list_t *page_list(page_t *page) {
+    return (page->flags & PG_ACTIVE) ? &pra_ctx.active : &pra_ctx.inactive;
+}
+
+// 移动到活跃链表尾部
+static void activate_page(page_t *page) {
+    list_del(page_list(page), page);
+    page->flags |= PG_ACTIVE;
+    page->flags &= ~PG_REFERENCED;
+    list_add_tail(&pra_ctx.active, page);
+}
+
+// 移动到非活跃链表尾部
+static void deactivate_page(page_t *page) {
+    list_del(page_list(page), page);
+    page->flags &= ~(PG_ACTIVE | PG_REFERENCED);
+    list_add_tail(&pra_ctx.inactive, page);
+}
+
+static inline void pra_lock(void) {
+    preempt_disable();
+    spinlock_lock(&pra_ctx.lock);
+}
+
+static inline void pra_unlock(void) {
+    spinlock_unlock(&pra_ctx.lock);
+    preempt_enable();
+}
+
 // 初始化页面替换算法
 void pra_init(pra_type_t type) {
     memset(&pra_ctx, 0, sizeof(pra_ctx));
     pra_ctx.type = type;
-    mutex_init(&pra_ctx.lock, "pra_lock");
-    
-    // 分配页面框架数组
-    pra_ctx.frame_count = 1024; // 4MB物理内存
-    pra_ctx.frames = mm_alloc(sizeof(page_frame_t) * pra_ctx.frame_count);
-    memset(pra_ctx.frames, 0, sizeof(page_frame_t) * pra_ctx.frame_count);
-    
-    // 初始化链表
-    for (uint32_t i = 0; i < pra_ctx.frame_count - 1; i++) {
-        pra_ctx.frames[i].next = &pra_ctx.frames[i + 1];
-    }
+    pra_ctx.max_frames = PRA_MAX_FRAMES;
+    spinlock_init(&pra_ctx.lock, "pra_lock");
+    semaphore_init(&pra_ctx.kswapd_wait, 0, "kswapd");
 }
 
 // FIFO算法选择被替换页面
-static page_frame_t *fifo_select(void) {
-    static page_frame_t *fifo_head = NULL;
-    
-    if (!fifo_head) {
-        fifo_head = pra_ctx.frames;
+static page_t *fifo_select(void) {
+    return list_pop_head(&pra_ctx.inactive);
+}
+
+// 时钟算法选择被替换页面（二次机会，检查数有上限）
+static page_t *clock_select(void) {
+    for (uint32_t i = 0; i < PRA_SCAN_MAX; i++) {
+        page_t *page = pra_ctx.inactive.head;
+        if (!page) return NULL;
+
+        if (!(page->flags & PG_REFERENCED)) break;
+
+        page->flags &= ~PG_REFERENCED;
+        list_del(&pra_ctx.inactive, page);
+        list_add_tail(&pra_ctx.inactive, page);
     }
-    
-    page_frame_t *victim = fifo_head;
-    fifo_head = fifo_head->next;
-    return victim;
+
+    return list_pop_head(&pra_ctx.inactive);
 }
 
-// 时钟算法选择被替换页面
-static page_frame_t *clock_select(void) {
-    while (1) {
-        page_frame_t *frame = &pra_ctx.frames[pra_ctx.clock_hand];
-        pra_ctx.clock_hand = (pra_ctx.clock_hand + 1) % pra_ctx.frame_count;
-        
-        if (frame->accessed) {
-            frame->accessed = 0;
-        } else {
-            return frame;
+// LRU近似（2Q）：新页进入A1，再次访问提升到Am，Am过大时尾部降级
+static page_t *lru_select(void) {
+    // 保持非活跃链表不小于活跃链表的一半
+    for (uint32_t i = 0; i < PRA_SCAN_MAX &&
+         pra_ctx.inactive.count < pra_ctx.active.count / 2 + 1 && pra_ctx.active.head; i++) {
+        deactivate_page(pra_ctx.active.head);
+    }
+
+    for (uint32_t i = 0; i < PRA_SCAN_MAX; i++) {
+        page_t *page = pra_ctx.inactive.head;
+        if (!page) break;
+
+        if (!(page->flags & PG_REFERENCED)) {
+            list_del(&pra_ctx.inactive, page);
+            return page;
         }
+        activate_page(page);
     }
+
+    page_t *page = list_pop_head(&pra_ctx.inactive);
+    return page ? page : list_pop_head(&pra_ctx.active);
 }
 
-// LRU算法选择被替换页面
-static page_frame_t *lru_select(void) {
-    page_frame_t *victim = NULL;
-    uint32_t min_ref = UINT32_MAX;
-    
-    for (uint32_t i = 0; i < pra_ctx.frame_count; i++) {
-        if (pra_ctx.frames[i].reference < min_ref) {
-            min_ref = pra_ctx.frames[i].reference;
-            victim = &pra_ctx.frames[i];
-        }
+// NFU算法选择被替换页面（老化在tick中进行，计数归零的页位于非活跃链表）
+static page_t *nfu_select(void) {
+    page_t *page = list_pop_head(&pra_ctx.inactive);
+    return page ? page : list_pop_head(&pra_ctx.active);
+}
+
+// 选择牺牲页并从链表摘除
+static page_t *select_victim(void) {
+    page_t *page = NULL;
+
+    switch (pra_ctx.type) {
+        case PRA_FIFO:
+            page = fifo_select();
+            break;
+        case PRA_CLOCK:
+            page = clock_select();
+            break;
+        case PRA_LRU:
+            page = lru_select();
+            break;
+        case PRA_NFU:
+            page = nfu_select();
+            break;
     }
-    
-    return victim;
-}
-
-// NFU算法选择被替换页面
-static page_frame_t *nfu_select(void) {
-    page_frame_t *victim = NULL;
-    uint32_t min_ref = UINT32_MAX;
-    
-    for (uint32_t i = 0; i < pra_ctx.frame_count; i++) {
-        uint32_t ref = pra_ctx.frames[i].reference >> 1; // 老化
-        pra_ctx.frames[i].reference = ref;
-        
-        if (ref < min_ref) {
-            min_ref = ref;
-            victim = &pra_ctx.frames[i];
+
+    if (page) {
+        page->flags &= ~(PG_LRU | PG_ACTIVE | PG_REFERENCED);
+    }
+    return page;
+}
+
+// 回收一个常驻页：选择牺牲页，写回脏页并解除映射，返回已摘下的页
+// to_free为真时放入空闲链表（保留在交换缓存中），否则撤出交换缓存交给调用者复用
+static page_t *reclaim_page(bool to_free) {
+    pra_lock();
+    page_t *page = NULL;
+    for (uint32_t i = 0; i < PRA_SCAN_MAX; i++) {
+        page = select_victim();
+        if (!page) break;
+
+        // 写时复制共享页或归属未知的页无法逐一解除映射，放回活跃链表
+        if (page->mapcount <= 1 && !(page->flags & PG_UNOWNED)) break;
+
+        page->flags |= PG_LRU | PG_ACTIVE;
+        list_add_tail(&pra_ctx.active, page);
+        page = NULL;
+    }
+    pra_unlock();
+    if (!page) return NULL;
+
+    int written = 0;
+    if (page->vaddr) {
+        written = swap_out(page);
+        if (written < 0) {
+            // 写回失败，放回活跃链表尾部，避免立即再次选中
+            pra_lock();
+            page->flags |= PG_LRU | PG_ACTIVE;
+            list_add_tail(&pra_ctx.active, page);
+            pra_unlock();
+            return NULL;
         }
     }
-    
-    return victim;
+
+    // 与清除写回标记在同一临界区内完成去向，等待的缺页随后命中空闲帧或直接读槽位
+    pra_lock();
+    page->vaddr = 0;
+    page->mm = NULL;
+    if (to_free) {
+        list_add_tail(&pra_ctx.free, page);
+    } else {
+        swap_cache_del(page);
+    }
+    page->flags &= ~PG_WRITEBACK;
+    pra_ctx.stats.replaced_pages++;
+    if (written) pra_ctx.stats.page_outs++;
+    pra_unlock();
+
+    return page;
+}
+
+// 可立即使用的帧数（空闲链表加上尚未从伙伴系统取得的额度）
+static inline uint32_t free_frames(void) {
+    return pra_ctx.free.count + (pra_ctx.max_frames - pra_ctx.allocated);
 }
 
 // 分配页面
 void *pra_alloc_page(void) {
-    mutex_lock(&pra_ctx.lock);
-    
-    // 查找空闲页面
-    page_frame_t *frame = NULL;
-    for (uint32_t i = 0; i < pra_ctx.frame_count; i++) {
-        if (pra_ctx.frames[i].vaddr == 0) {
-            frame = &pra_ctx.frames[i];
-            break;
-        }
+    pra_lock();
+
+    // 优先使用空闲帧，取用后其交换缓存失效
+    page_t *page = list_pop_head(&pra_ctx.free);
+    if (page) {
+        swap_cache_del(page);
+    } else if (pra_ctx.allocated < pra_ctx.max_frames) {
+        pra_ctx.allocated++;
+        pra_unlock();
+
+        page = alloc_pages(GFP_KERNEL, 0);
+
+        pra_lock();
+        if (!page) pra_ctx.allocated--;
     }
-    
-    if (!frame) {
-        // 没有空闲页面，需要替换
+
+    // 低于低水位时唤醒kswapd提前回收
+    bool wake = free_frames() < PRA_LOW_WMARK && !pra_ctx.kswapd_pending;
+    if (wake) pra_ctx.kswapd_pending = true;
+
+    if (!page) {
+        // 没有空闲页面，直接回收
         pra_ctx.stats.page_faults++;
-        
-        // 选择被替换页面
-        switch (pra_ctx.type) {
-            case PRA_FIFO:
-                frame = fifo_select();
-                break;
-            case PRA_CLOCK:
-                frame = clock_select();
-                break;
-            case PRA_LRU:
-                frame = lru_select();
-                break;
-            case PRA_NFU:
-                frame = nfu_select();
-                break;
-        }
-        
-        if (frame->dirty) {
-            // 写回脏页面
-            void *swap_addr = swap_out(frame->vaddr);
-            if (!swap_addr) {
-                mutex_unlock(&pra_ctx.lock);
-                return NULL;
-            }
-            pra_ctx.stats.page_outs++;
-        }
-        
-        // 解除原映射
-        mmu_unmap_page(frame->vaddr);
-        pra_ctx.stats.replaced_pages++;
-    }
-    
-    // 分配新的物理页面
-    void *page = mm_alloc_pages(1);
+        pra_unlock();
+        if (wake) semaphore_post(&pra_ctx.kswapd_wait);
+
+        page = reclaim_page(false);
+        if (!page) return NULL;
+
+        pra_lock();
+    } else if (wake) {
+        pra_unlock();
+        semaphore_post(&pra_ctx.kswapd_wait);
+        pra_lock();
+    }
+
+    // 初始化页面框架，新页面进入非活跃链表（NFU直接进入活跃链表）；
+    // 新页面没有任何后备副本，默认为脏，只有调用者确认内容可重建时才清除
+    page->flags &= ~(PG_ACTIVE | PG_REFERENCED | PG_UNOWNED);
+    page->flags |= PG_LRU | PG_DIRTY;
+    page->vaddr = 0;
+    page->mm = NULL;
+    page->age = PRA_AGE_MSB;
+    page->swap_slot = 0;
+    page->mapcount = 1;
+
+    if (pra_ctx.type == PRA_NFU) {
+        page->flags |= PG_ACTIVE;
+        list_add_tail(&pra_ctx.active, page);
+    } else {
+        list_add_tail(&pra_ctx.inactive, page);
+    }
+
+    pra_ctx.stats.page_ins++;
+
+    pra_unlock();
+    return page_to_virt(page);
+}
+
+// 从交换缓存取回仍在空闲链表上的页，命中时无需读盘
+void *pra_swapcache_get(uint32_t slot) {
+    pra_lock();
+
+    // 页面仍在换出中：槽位尚未写完，等回收者确定去向后重新查找
+    page_t *page = swap_cache_find(slot);
+    while (page && (page->flags & PG_WRITEBACK)) {
+        pra_unlock();
+        task_sleep(1);
+        pra_lock();
+        page = swap_cache_find(slot);
+    }
+
     if (!page) {
-        mutex_unlock(&pra_ctx.lock);
+        pra_unlock();
         return NULL;
     }
-    
-    // 初始化页面框架
-    frame->vaddr = (uint32_t)page;
-    frame->accessed = 1;
-    frame->dirty = 0;
-    frame->reference = 0;
-    
-    pra_ctx.stats.page_ins++;
-    
-    mutex_unlock(&pra_ctx.lock);
-    return page;
+
+    swap_cache_del(page);
+    list_del(&pra_ctx.free, page);
+
+    // 重新成为常驻页，槽中的副本仍然有效
+    page->flags &= ~(PG_ACTIVE | PG_REFERENCED | PG_DIRTY | PG_UNOWNED);
+    page->flags |= PG_LRU;
+    page->age = PRA_AGE_MSB;
+    page->swap_slot = slot;
+    page->mapcount = 1;
+
+    if (pra_ctx.type == PRA_NFU) {
+        page->flags |= PG_ACTIVE;
+        list_add_tail(&pra_ctx.active, page);
+    } else {
+        list_add_tail(&pra_ctx.inactive, page);
+    }
+
+    pra_unlock();
+    return page_to_virt(page);
+}
+
+// kswapd：空闲帧低于低水位时被唤醒，提前写回并回收页面直到高水位
+static void kswapd_task(void) {
+    while (1) {
+        semaphore_wait(&pra_ctx.kswapd_wait);
+
+        while (1) {
+            pra_lock();
+            bool done = free_frames() >= PRA_HIGH_WMARK;
+            pra_unlock();
+            if (done) break;
+
+            // 回收的页放入空闲链表，有交换副本的已在换出时进入交换缓存
+            if (!reclaim_page(true)) break;
+        }
+
+        pra_lock();
+        pra_ctx.kswapd_pending = false;
+        pra_unlock();
+    }
+}
+
+// 启动kswapd任务
+void pra_kswapd_start(void) {
+    task_create("kswapd", kswapd_task, TASK_PRIORITY_LOW, DEFAULT_STACK_SIZE);
+}
+
+// 记录页面的用户映射（缺页处理建立映射后调用，换出时据此解除映射）
+void pra_set_mapping(void *addr, mm_struct_t *mm, uint32_t vaddr) {
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    page->mm = mm;
+    page->vaddr = vaddr & PAGE_MASK;
+    page->flags &= ~PG_UNOWNED;
+    pra_unlock();
+}
+
+// 增加页面的映射计数（写时复制共享时调用）
+void pra_get_page(void *addr) {
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    if (page->flags & PG_LRU) {
+        page->mapcount++;
+    }
+    pra_unlock();
+}
+
+// 解除mm对页面的一个映射；仍有其他映射时只减计数，最后一个映射解除时释放页面
+void pra_put_page(void *addr, mm_struct_t *mm) {
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    if ((page->flags & PG_LRU) && page->mapcount > 1) {
+        page->mapcount--;
+
+        // 记录的映射者离开后无法得知剩余映射属于谁，待其下次缺页时重新登记
+        if (!mm || page->mm == mm) {
+            page->flags |= PG_UNOWNED;
+            page->mm = NULL;
+        }
+        pra_unlock();
+        return;
+    }
+    pra_unlock();
+
+    pra_free_page(addr);
 }
 
 // 释放页面
 void pra_free_page(void *addr) {
-    mutex_lock(&pra_ctx.lock);
-    
-    // 查找页面框架
-    for (uint32_t i = 0; i < pra_ctx.frame_count; i++) {
-        if (pra_ctx.frames[i].vaddr == (uint32_t)addr) {
-            // 清除页面框架
-            pra_ctx.frames[i].vaddr = 0;
-            pra_ctx.frames[i].accessed = 0;
-            pra_ctx.frames[i].dirty = 0;
-            pra_ctx.frames[i].reference = 0;
-            
-            // 释放物理页面
-            mm_free_pages(addr, 1);
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+
+    if (!(page->flags & PG_LRU)) {
+        pra_unlock();
+        return;
+    }
+
+    // 仍被其他地址空间共享时只解除一个映射
+    if (page->mapcount > 1) {
+        page->mapcount--;
+        page->flags |= PG_UNOWNED;
+        page->mm = NULL;
+        pra_unlock();
+        return;
+    }
+
+    list_del(page_list(page), page);
+    page->flags &= ~(PG_LRU | PG_ACTIVE | PG_REFERENCED | PG_DIRTY | PG_UNOWNED);
+    page->mapcount = 0;
+    page->vaddr = 0;
+    page->mm = NULL;
+    page->age = 0;
+
+    // 映射已不存在，交换副本随之作废
+    uint32_t slot = page->swap_slot;
+    page->swap_slot = 0;
+
+    if (pra_ctx.free.count < PRA_FREE_HIGH) {
+        list_add_tail(&pra_ctx.free, page);
+        pra_unlock();
+        swap_free(slot);
+        return;
+    }
+
+    pra_ctx.allocated--;
+    pra_unlock();
+    swap_free(slot);
+
+    // 释放物理页面
+    free_pages(page, 0);
+}
+
+// 记录一次页面访问（调用者持有锁）
+static void mark_accessed_locked(page_t *page) {
+    switch (pra_ctx.type) {
+        case PRA_FIFO:
+            break;
+        case PRA_CLOCK:
+            page->flags |= PG_REFERENCED;
+            break;
+        case PRA_NFU:
+            // 冷页被访问后回到活跃链表，老化计数在tick中更新
+            if (!(page->flags & PG_ACTIVE)) {
+                activate_page(page);
+            }
+            page->flags |= PG_REFERENCED;
+            break;
+        case PRA_LRU:
+            if (page->flags & PG_ACTIVE) {
+                // Am队列内按LRU顺序移到尾部
+                list_del(&pra_ctx.active, page);
+                list_add_tail(&pra_ctx.active, page);
+            } else if (page->flags & PG_REFERENCED) {
+                activate_page(page);
+            } else {
+                page->flags |= PG_REFERENCED;
+            }
             break;
-        }
     }
-    
-    mutex_unlock(&pra_ctx.lock);
 }
 
 // 页面访问
 void pra_access_page(void *addr) {
-    mutex_lock(&pra_ctx.lock);
-    
-    // 查找页面框架
-    for (uint32_t i = 0; i < pra_ctx.frame_count; i++) {
-        if (pra_ctx.frames[i].vaddr == (uint32_t)addr) {
-            // 更新访问信息
-            pra_ctx.frames[i].accessed = 1;
-            pra_ctx.frames[i].reference++;
-            
-            if (pra_ctx.type == PRA_NFU) {
-                pra_ctx.frames[i].reference |= 0x80000000; // 设置最高位
-            }
-            break;
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    if (page->flags & PG_LRU) {
+        mark_accessed_locked(page);
+    }
+    pra_unlock();
+}
+
+// 标记页面已修改（写保护错误处理中调用）
+void pra_mark_dirty(void *addr) {
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    if (page->flags & PG_LRU) {
+        page->flags |= PG_DIRTY;
+    }
+    pra_unlock();
+}
+
+// 换出前以目标槽位登记交换缓存并标记写回中（swap_out解除映射前调用），缓存已满返回-1
+int pra_writeback_begin(page_t *page, uint32_t slot) {
+    pra_lock();
+    uint32_t valid = page->swap_slot;
+    page->swap_slot = slot;
+    if (!swap_cache_add(page)) {
+        page->swap_slot = valid;
+        pra_unlock();
+        return -1;
+    }
+    page->flags |= PG_WRITEBACK;
+    pra_unlock();
+    return 0;
+}
+
+// 写回失败：撤出交换缓存并恢复原有效槽位
+void pra_writeback_abort(page_t *page, uint32_t slot) {
+    pra_lock();
+    swap_cache_del(page);
+    page->swap_slot = slot;
+    page->flags &= ~PG_WRITEBACK;
+    pra_unlock();
+}
+
+// 标记页面干净（仅在交换槽副本有效或内容可重建为零页时调用）
+void pra_mark_clean(void *addr) {
+    page_t *page = virt_to_page(addr);
+    if (!page) return;
+
+    pra_lock();
+    if (page->flags & PG_LRU) {
+        page->flags &= ~PG_DIRTY;
+    }
+    pra_unlock();
+}
+
+// 按页帧号扫描一批常驻页，收集硬件访问标志
+static void pra_scan(void) {
+    static uint32_t scan_pfn = 0;
+
+    pra_lock();
+
+    for (uint32_t i = 0; i < PRA_HARVEST_BATCH; i++) {
+        page_t *page = pfn_to_page(scan_pfn);
+        scan_pfn = (scan_pfn + 1) % RAM_PAGES;
+
+        if (!(page->flags & PG_LRU) || !page->vaddr) continue;
+
+        // 访问标志已置位说明上次扫描后被访问过，清除后下次访问会再次置位
+        // 扫描在kscand上下文中进行，需在页面所属地址空间的页表中检查
+        bool accessed = page->mm
+            ? mmu_pgd_test_and_clear_accessed((uint32_t *)page->mm->pgd, page->mm->asid, page->vaddr)
+            : mmu_test_and_clear_accessed(page->vaddr);
+        if (accessed) {
+            mark_accessed_locked(page);
+            pra_ctx.stats.harvested++;
+        }
+    }
+
+    pra_unlock();
+}
+
+// 访问标志扫描任务
+static void pra_scanner_task(void) {
+    while (1) {
+        if (pra_ctx.type != PRA_FIFO) {
+            pra_scan();
+        }
+        task_sleep(PRA_HARVEST_PERIOD_MS);
+    }
+}
+
+// 启动访问标志扫描任务
+void pra_scanner_start(void) {
+    task_create("kscand", pra_scanner_task, TASK_PRIORITY_LOW, DEFAULT_STACK_SIZE);
+}
+
+// 周期性NFU老化（定时器中断中调用，每次只处理一批帧，锁被占用时跳过）
+void pra_tick(void) {
+    if (pra_ctx.type != PRA_NFU) return;
+    if (++pra_ctx.aging_ticks < PRA_AGING_INTERVAL) return;
+
+    if (!spinlock_trylock(&pra_ctx.lock)) return;
+    pra_ctx.aging_ticks = 0;
+
+    // 活跃链表轮转老化，计数归零的页面降入非活跃链表
+    uint32_t batch = pra_ctx.active.count < PRA_AGING_BATCH ?
+                     pra_ctx.active.count : PRA_AGING_BATCH;
+    for (uint32_t i = 0; i < batch; i++) {
+        page_t *page = pra_ctx.active.head;
+        list_del(&pra_ctx.active, page);
+
+        page->age >>= 1;
+        if (page->flags & PG_REFERENCED) {
+            page->age |= PRA_AGE_MSB;
+            page->flags &= ~PG_REFERENCED;
+        }
+
+        if (page->age == 0) {
+            page->flags &= ~PG_ACTIVE;
+            list_add_tail(&pra_ctx.inactive, page);
+        } else {
+            list_add_tail(&pra_ctx.active, page);
         }
     }
-    
-    mutex_unlock(&pra_ctx.lock);
-} 
\ No newline at end of file
+
+    spinlock_unlock(&pra_ctx.lock);
+}
+
+// 获取页面替换统计信息
+void pra_get_stats(pra_stats_t *stats) {
+    if (!stats) return;
+
+    pra_lock();
+    *stats = pra_ctx.stats;
+    pra_unlock();
+}
@@ -3,18 +3,49 @@
 #include "interrupt.h"
 #include <string.h>
 
+// 计算区域的页表权限
+static uint32_t vma_mmu_prot(vm_area_t *vma, bool writable) {
+    uint32_t prot = 0;
+    if (vma->flags & PROT_READ) prot |= MMU_PERM_READ;
+    if ((vma->flags & PROT_WRITE) && writable) prot |= MMU_PERM_WRITE;
+    if (vma->flags & PROT_EXEC) prot |= MMU_PERM_EXEC;
+    return prot | MMU_PERM_MT((vma->flags & PROT_MT_MASK) >> 8);
+}
+
+// 匿名页首次写入：私有映射中仍被共享的页面复制一份（写时复制），否则直接开放写权限并标记为脏
+static int do_write_fault(mm_struct_t *mm, vm_area_t *vma, uint32_t va, uint32_t pa) {
+    page_t *page = virt_to_page((void *)pa);
+    
+    if (page && page->mapcount > 1 && !(vma->map_flags & MAP_SHARED)) {
+        void *copy = pra_alloc_page();
+        if (!copy) {
+            return -1;
+        }
+        
+        memcpy(copy, (void *)pa, PAGE_SIZE);
+        mmu_map_page(va, (uint32_t)copy, vma_mmu_prot(vma, true));
+        pra_set_mapping(copy, mm, va);
+        pra_mark_dirty(copy);
+        pra_put_page((void *)pa, mm);
+        return 0;
+    }
+    
+    // 共享者都已离开，由最后的映射者重新登记归属
+    if (page && (page->flags & PG_UNOWNED)) {
+        pra_set_mapping((void *)pa, mm, va);
+    }
+    
+    mmu_write_enable(va);
+    pra_mark_dirty((void *)pa);
+    return 0;
+}
+
 // 页面错误处理函数
 void page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
     mm_struct_t *mm = task_get_current()->mm;
     
     // 查找对应的虚拟内存区域
-    vm_area_t *vma = mm->mmap;
-    while (vma) {
-        if (fault_addr >= vma->start && fault_addr < vma->end) {
-            break;
-        }
-        vma = vma->next;
-    }
+    vm_area_t *vma = vma_lookup(mm, fault_addr);
     
     if (!vma) {
         // 访问非法地址
@@ -23,74 +54,191 @@ void page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
     }
     
     // 检查访问权限
-    if ((error_code & 2) && !(vma->flags & PROT_WRITE)) {
+    if ((error_code & FAULT_WRITE) && !(vma->flags & PROT_WRITE)) {
         // 写保护错误
         task_exit(-1);
         return;
     }
     
-    if (!(error_code & 1) && !(vma->flags & PROT_READ)) {
+    if (!(error_code & FAULT_PRESENT) && !(vma->flags & PROT_READ)) {
         // 读保护错误
         task_exit(-1);
         return;
     }
     
-    if ((error_code & 4) && !(vma->flags & PROT_EXEC)) {
+    if ((error_code & FAULT_EXEC) && !(vma->flags & PROT_EXEC)) {
         // 执行保护错误
         task_exit(-1);
         return;
     }
     
-    // 分配新页面
-    void *page = pra_alloc_page();
+    uint32_t va = fault_addr & PAGE_MASK;
+    
+    // 物理映射在建立时已全部映射，缺页说明映射建立失败，按页补建
+    if (vma->map_flags & MAP_PHYS) {
+        if (mmu_map_page(va, vma->phys + (va - vma->start), vma_mmu_prot(vma, true)) < 0) {
+            task_exit(-1);
+        }
+        return;
+    }
+    
+    uint32_t pa = mmu_virt_to_phys(va) & PAGE_MASK;
+    
+    // 文件映射中仍指向块缓存的页面（私有映射写入后的副本属于页面替换器）
+    page_t *ppage = pa ? virt_to_page((void *)pa) : NULL;
+    bool file_page = vma->ino && !(ppage && (ppage->flags & PG_LRU));
+    
+    // 访问标志错误：页面已在内存中，置位访问标志并记录访问
+    if (pa && (error_code & FAULT_ACCESS_FLAG)) {
+        mmu_set_accessed(va);
+        pra_access_page((void *)pa);
+        
+        // 写时复制共享后归属未知的页面，由访问者重新登记
+        if (ppage && (ppage->flags & PG_UNOWNED) && !(error_code & FAULT_WRITE)) {
+            pra_set_mapping((void *)pa, mm, va);
+        }
+        
+        // 写访问时一并处理干净页的首次写入，省去一次权限错误
+        if ((error_code & FAULT_WRITE) && !mmu_is_writable(va)) {
+            int ret = file_page ? filemap_fault(mm, vma, va, error_code)
+                                : do_write_fault(mm, vma, va, pa);
+            if (ret < 0) {
+                task_exit(-1);
+            }
+        }
+        return;
+    }
+    
+    // 只读页首次写入：干净页解除写保护，共享页写时复制
+    if (pa && (error_code & FAULT_PERMISSION) && (error_code & FAULT_WRITE)) {
+        int ret = file_page ? filemap_fault(mm, vma, va, error_code)
+                            : do_write_fault(mm, vma, va, pa);
+        if (ret < 0) {
+            task_exit(-1);
+        }
+        return;
+    }
+    
+    // 页面已换出时从交换区换入（包括私有文件映射的副本）
+    pte_t *pte = mmu_get_pte(va);
+    bool swapped = pte && !pte->flags.present && pte->swap_offset;
+    
+    // 文件映射从块缓存取页，否则分配新的零页
+    if (!swapped && vma->ino) {
+        if (filemap_fault(mm, vma, va, error_code) < 0) {
+            task_exit(-1);
+        }
+        return;
+    }
+    
+    void *page = swapped ? swap_in(pte) : pra_alloc_page();
     if (!page) {
+        // 换出失败后页面已恢复映射，返回后重新执行访问
+        if (swapped && pte->flags.present) return;
         task_exit(-1);
         return;
     }
+    if (!swapped) {
+        memset(page, 0, PAGE_SIZE);
+    }
     
-    // 建立映射
-    uint32_t prot = 0;
-    if (vma->flags & PROT_READ) prot |= MMU_PERM_READ;
-    if (vma->flags & PROT_WRITE) prot |= MMU_PERM_WRITE;
-    if (vma->flags & PROT_EXEC) prot |= MMU_PERM_EXEC;
+    // 建立映射，可写区域在首次写入前保持写保护以跟踪脏页
+    uint32_t prot = vma_mmu_prot(vma, error_code & FAULT_WRITE);
     
-    mmu_map_page(fault_addr & PAGE_MASK, (uint32_t)page, prot);
+    mmu_map_page(va, (uint32_t)page, prot);
+    pra_set_mapping(page, mm, fault_addr);
+    
+    // 交换槽的所有权已转到物理页（page_t.swap_slot）
+    if (swapped) {
+        pte->swap_offset = 0;
+    }
+    
+    // 新页面默认为脏；只读映射的零页回收时可直接丢弃，下次缺页重新清零
+    if (!swapped && !(prot & MMU_PERM_WRITE)) {
+        pra_mark_clean(page);
+    }
 }
 
-// 设置内存保护
+// 按新权限更新区域内已映射页面的页表项
+static void vma_update_ptes(vm_area_t *vma, int prot) {
+    // 物理映射按新权限整体重建，保留大块映射
+    if (vma->map_flags & MAP_PHYS) {
+        uint32_t size = vma->end - vma->start;
+        mmu_unmap_range(vma->start, size);
+        if (prot & (PROT_READ | PROT_WRITE | PROT_EXEC)) {
+            mmu_map_range(vma->start, vma->phys, size, vma_mmu_prot(vma, true));
+        }
+        return;
+    }
+    
+    for (uint32_t addr = vma->start; addr < vma->end; addr += PAGE_SIZE) {
+        pte_t *pte = mmu_get_pte(addr);
+        if (pte && pte->flags.present) {
+            uint32_t new_prot = MMU_PERM_MT((prot & PROT_MT_MASK) >> 8);
+            if (prot & PROT_READ) new_prot |= MMU_PERM_READ;
+            if (prot & PROT_EXEC) new_prot |= MMU_PERM_EXEC;
+            
+            // 干净页保持写保护，首次写入时再标记为脏；写时复制共享页同样保持只读
+            page_t *page = virt_to_page((void *)(mmu_virt_to_phys(addr) & PAGE_MASK));
+            bool shared = page && page->mapcount > 1 && !(vma->map_flags & MAP_SHARED);
+            if ((prot & PROT_WRITE) && page && (page->flags & PG_DIRTY) && !shared) {
+                new_prot |= MMU_PERM_WRITE;
+            }
+            
+            mmu_update_prot(addr, new_prot);
+        }
+    }
+}
+
+// 设置内存保护，部分覆盖的区域先拆分，修改后与相邻区域合并
 int mm_protect(void *addr, size_t length, int prot) {
     uint32_t start = (uint32_t)addr & PAGE_MASK;
     uint32_t end = ((uint32_t)addr + length + PAGE_SIZE - 1) & PAGE_MASK;
     
     mm_struct_t *mm = task_get_current()->mm;
+    if (!mm || start >= end) {
+        return -1;
+    }
     
-    // 查找并更新虚拟内存区域
-    vm_area_t *vma = mm->mmap;
-    while (vma) {
-        if (start >= vma->start && end <= vma->end) {
-            // 更新保护标志
-            vma->flags = prot;
-            
-            // 更新页表项
-            for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
-                pte_t *pte = mmu_get_pte(addr);
-                if (pte && pte->flags.present) {
-                    uint32_t new_prot = 0;
-                    if (prot & PROT_READ) new_prot |= MMU_PERM_READ;
-                    if (prot & PROT_WRITE) new_prot |= MMU_PERM_WRITE;
-                    if (prot & PROT_EXEC) new_prot |= MMU_PERM_EXEC;
-                    
-                    mmu_update_prot(addr, new_prot);
-                }
-            }
-            
-            return 0;
+    // 整个范围必须被连续的区域覆盖
+    vm_area_t *vma = vma_lookup(mm, start);
+    uint32_t covered = start;
+    for (vm_area_t *v = vma; v && v->start <= covered && covered < end; v = v->next) {
+        covered = v->end;
+    }
+    if (covered < end) {
+        return -1;
+    }
+    
+    if (vma->start < start) {
+        vma = vma_split(mm, vma, start);
+        if (!vma) {
+            return -1;
         }
+    }
+    
+    // 整个范围的TLB失效在返回前统一完成
+    mmu_batch_t batch;
+    mmu_batch_begin(&batch);
+    
+    vm_area_t *first = vma;
+    int ret = 0;
+    while (vma && vma->start < end) {
+        if (vma->end > end && !vma_split(mm, vma, end)) {
+            ret = -1;
+            break;
+        }
+        
+        // 更新保护标志和页表项，内存类型在建立映射时确定，保持不变
+        vma->flags = (prot & ~PROT_MT_MASK) | (vma->flags & PROT_MT_MASK);
+        vma_update_ptes(vma, vma->flags);
         vma = vma->next;
     }
     
-    return -1;
-} 
+    mmu_batch_end(&batch);
+    vma_merge(mm, first);
+    return ret;
+}
 // 内存管理系统使用示例
 
 // 1. 动态内存分配
@@ -0,0 +1,379 @@
+#include "mm.h"
+#include "sync.h"
+#include <string.h>
+
+#define SLAB_MAGIC          0x51AB51AB
+#define SLAB_MAX_ORDER      3       // 单个slab最多8页
+#define SLAB_MIN_OBJS       8       // 每个slab至少容纳的对象数
+#define SLAB_KEEP_EMPTY     1       // 每个缓存保留的空slab数量
+
+// slab描述符（位于slab首部）
+typedef struct slab {
+    uint32_t magic;            // 魔数，用于校验对象归属
+    struct kmem_cache *cache;  // 所属缓存
+    struct slab *next;         // 链表下一个slab
+    struct slab *prev;         // 链表上一个slab
+    void *free;                // 空闲对象链表
+    uint32_t inuse;            // 已分配对象数
+} slab_t;
+
+// slab链表
+typedef struct {
+    slab_t *head;
+    uint32_t count;
+} slab_list_t;
+
+// 对象缓存
+struct kmem_cache {
+    const char *name;              // 缓存名称
+    uint32_t obj_size;             // 用户对象大小
+    uint32_t stride;               // 对象间距（含对齐与空闲指针）
+    uint32_t free_offset;          // 空闲指针在对象中的偏移
+    uint32_t align;                // 对齐要求
+    uint32_t order;                // slab页阶数
+    uint32_t objs_per_slab;        // 每个slab的对象数
+    uint32_t first_offset;         // 第一个对象相对slab首部的偏移
+    uint32_t flags;                // 缓存标志
+    void (*ctor)(void *obj);       // 对象构造函数
+    slab_list_t full;              // 满slab
+    slab_list_t partial;           // 部分使用slab
+    slab_list_t empty;             // 空slab
+    kmem_cache_stats_t stats;      // 统计信息
+    mutex_t lock;                  // 缓存锁
+    struct kmem_cache *next;       // 全局缓存链表
+};
+
+// 全局缓存链表
+static kmem_cache_t *cache_chain = NULL;
+static mutex_t cache_chain_lock;
+static bool slab_initialized = false;
+
+// 缓存描述符本身的缓存
+static kmem_cache_t cache_cache;
+
+static inline uint32_t align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline void **free_ptr(kmem_cache_t *cache, void *obj) {
+    return (void **)((char *)obj + cache->free_offset);
+}
+
+static void list_add(slab_list_t *list, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = list->head;
+    if (list->head) {
+        list->head->prev = slab;
+    }
+    list->head = slab;
+    list->count++;
+}
+
+static void list_del(slab_list_t *list, slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list->head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = slab->prev = NULL;
+    list->count--;
+}
+
+// 计算缓存布局：选择最小的能容纳SLAB_MIN_OBJS个对象的页阶数
+static void cache_compute_layout(kmem_cache_t *cache) {
+    uint32_t size = cache->obj_size;
+
+    // 有构造函数时空闲指针不能覆盖对象内容，放在对象之后
+    if (cache->ctor) {
+        size = align_up(size, sizeof(void *));
+        cache->free_offset = size;
+        size += sizeof(void *);
+    } else {
+        cache->free_offset = 0;
+        if (size < sizeof(void *)) size = sizeof(void *);
+    }
+
+    cache->stride = align_up(size, cache->align);
+    cache->first_offset = align_up(sizeof(slab_t), cache->align);
+
+    for (cache->order = 0; cache->order < SLAB_MAX_ORDER; cache->order++) {
+        uint32_t slab_bytes = PAGE_SIZE << cache->order;
+        if ((slab_bytes - cache->first_offset) / cache->stride >= SLAB_MIN_OBJS) {
+            break;
+        }
+    }
+
+    cache->objs_per_slab = ((PAGE_SIZE << cache->order) - cache->first_offset) / cache->stride;
+}
+
+static void cache_setup(kmem_cache_t *cache, const char *name, uint32_t size,
+                        uint32_t align, uint32_t flags, void (*ctor)(void *)) {
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+    cache->obj_size = size;
+    cache->flags = flags;
+    cache->ctor = ctor;
+
+    if (flags & SLAB_HWCACHE_ALIGN) {
+        if (align < CACHE_LINE_SIZE) align = CACHE_LINE_SIZE;
+    }
+    if (align < sizeof(void *)) align = sizeof(void *);
+    cache->align = align;
+
+    cache_compute_layout(cache);
+    mutex_init(&cache->lock, name);
+}
+
+// 初始化slab分配器
+void kmem_cache_init(void) {
+    mutex_init(&cache_chain_lock, "cache_chain_lock");
+    cache_setup(&cache_cache, "kmem_cache", sizeof(kmem_cache_t), 0, SLAB_HWCACHE_ALIGN, NULL);
+    cache_chain = &cache_cache;
+    slab_initialized = true;
+}
+
+// 为缓存增加一个新slab（调用者持有cache->lock）
+static slab_t *cache_grow(kmem_cache_t *cache) {
+    uint32_t pages = 1 << cache->order;
+    void *mem = mm_alloc_pages(pages);
+
+    if (!mem) {
+        // 内存不足：先回收其他缓存的空slab再重试
+        mutex_unlock(&cache->lock);
+        kmem_cache_reap();
+        mutex_lock(&cache->lock);
+
+        // 回收期间可能已有其他任务为本缓存补充了slab
+        if (cache->partial.head) return cache->partial.head;
+        if (cache->empty.head) return cache->empty.head;
+
+        mem = mm_alloc_pages(pages);
+        if (!mem) return NULL;
+    }
+
+    slab_t *slab = (slab_t *)mem;
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+
+    // 构造所有对象并串成空闲链表（逆序插入，使分配按地址递增）
+    char *base = (char *)slab + cache->first_offset;
+    for (int i = cache->objs_per_slab - 1; i >= 0; i--) {
+        void *obj = base + i * cache->stride;
+        if (cache->ctor) {
+            cache->ctor(obj);
+        }
+        *free_ptr(cache, obj) = slab->free;
+        slab->free = obj;
+    }
+
+    list_add(&cache->empty, slab);
+    cache->stats.slabs++;
+    cache->stats.total_objs += cache->objs_per_slab;
+    cache->stats.grows++;
+
+    return slab;
+}
+
+// 释放空slab的页面（调用者持有cache->lock）
+static void cache_destroy_slab(kmem_cache_t *cache, slab_t *slab) {
+    list_del(&cache->empty, slab);
+    slab->magic = 0;
+    cache->stats.slabs--;
+    cache->stats.total_objs -= cache->objs_per_slab;
+    cache->stats.reclaimed_pages += 1 << cache->order;
+    mm_free_pages(slab, 1 << cache->order);
+}
+
+// 创建对象缓存
+kmem_cache_t *kmem_cache_create(const char *name, uint32_t size, uint32_t align,
+                                uint32_t flags, void (*ctor)(void *obj)) {
+    if (!slab_initialized || size == 0) return NULL;
+
+    // 对齐必须是2的幂
+    if (align & (align - 1)) return NULL;
+
+    kmem_cache_t *cache = kmem_cache_alloc(&cache_cache);
+    if (!cache) return NULL;
+
+    cache_setup(cache, name, size, align, flags, ctor);
+
+    // 对象太大无法放入slab
+    if (cache->objs_per_slab == 0) {
+        kmem_cache_free(&cache_cache, cache);
+        return NULL;
+    }
+
+    mutex_lock(&cache_chain_lock);
+    cache->next = cache_chain;
+    cache_chain = cache;
+    mutex_unlock(&cache_chain_lock);
+
+    return cache;
+}
+
+// 销毁对象缓存（所有对象必须已释放）
+int kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!cache || cache == &cache_cache) return -1;
+
+    mutex_lock(&cache->lock);
+    if (cache->full.head || cache->partial.head) {
+        mutex_unlock(&cache->lock);
+        return -1;
+    }
+    while (cache->empty.head) {
+        cache_destroy_slab(cache, cache->empty.head);
+    }
+    mutex_unlock(&cache->lock);
+
+    // 从全局链表移除
+    mutex_lock(&cache_chain_lock);
+    kmem_cache_t **pp = &cache_chain;
+    while (*pp) {
+        if (*pp == cache) {
+            *pp = cache->next;
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    mutex_unlock(&cache_chain_lock);
+
+    kmem_cache_free(&cache_cache, cache);
+    return 0;
+}
+
+// 从缓存分配对象
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!cache) return NULL;
+
+    mutex_lock(&cache->lock);
+
+    // 优先使用部分使用的slab，减少碎片
+    slab_t *slab = cache->partial.head;
+    if (!slab) {
+        slab = cache->empty.head;
+        if (!slab) {
+            slab = cache_grow(cache);
+            if (!slab) {
+                cache->stats.failures++;
+                mutex_unlock(&cache->lock);
+                return NULL;
+            }
+        }
+    }
+
+    void *obj = slab->free;
+    slab->free = *free_ptr(cache, obj);
+
+    // 更新slab所在链表
+    if (slab->inuse == 0) {
+        list_del(&cache->empty, slab);
+        list_add(slab->free ? &cache->partial : &cache->full, slab);
+    } else if (!slab->free) {
+        list_del(&cache->partial, slab);
+        list_add(&cache->full, slab);
+    }
+    slab->inuse++;
+
+    cache->stats.active_objs++;
+    cache->stats.allocs++;
+    if (cache->stats.active_objs > cache->stats.peak_objs) {
+        cache->stats.peak_objs = cache->stats.active_objs;
+    }
+
+    mutex_unlock(&cache->lock);
+    return obj;
+}
+
+// 释放对象到缓存
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!cache || !obj) return;
+
+    // mm_alloc_pages按阶自然对齐，slab首部即对象地址按slab大小向下对齐
+    uint32_t slab_bytes = PAGE_SIZE << cache->order;
+    slab_t *slab = (slab_t *)((uint32_t)obj & ~(slab_bytes - 1));
+
+    // 校验对象归属
+    if (slab->magic != SLAB_MAGIC || slab->cache != cache) {
+        return;
+    }
+
+    mutex_lock(&cache->lock);
+
+    bool was_full = (slab->free == NULL);
+    *free_ptr(cache, obj) = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+
+    if (slab->inuse == 0) {
+        list_del(was_full ? &cache->full : &cache->partial, slab);
+        list_add(&cache->empty, slab);
+
+        // 空slab过多时直接归还页面
+        if (cache->empty.count > SLAB_KEEP_EMPTY) {
+            cache_destroy_slab(cache, slab);
+        }
+    } else if (was_full) {
+        list_del(&cache->full, slab);
+        list_add(&cache->partial, slab);
+    }
+
+    cache->stats.active_objs--;
+    cache->stats.frees++;
+
+    mutex_unlock(&cache->lock);
+}
+
+// 回收缓存中所有空slab，返回释放的页数
+uint32_t kmem_cache_shrink(kmem_cache_t *cache) {
+    if (!cache) return 0;
+
+    mutex_lock(&cache->lock);
+    uint32_t before = cache->stats.reclaimed_pages;
+    while (cache->empty.head) {
+        cache_destroy_slab(cache, cache->empty.head);
+    }
+    uint32_t freed = cache->stats.reclaimed_pages - before;
+    mutex_unlock(&cache->lock);
+
+    return freed;
+}
+
+// 内存紧张时回收所有缓存的空slab，返回释放的页数
+uint32_t kmem_cache_reap(void) {
+    uint32_t freed = 0;
+
+    mutex_lock(&cache_chain_lock);
+    for (kmem_cache_t *cache = cache_chain; cache; cache = cache->next) {
+        // 跳过正被持有的缓存，避免与cache_grow中的调用者死锁
+        if (!mutex_trylock(&cache->lock)) continue;
+
+        uint32_t before = cache->stats.reclaimed_pages;
+        while (cache->empty.head) {
+            cache_destroy_slab(cache, cache->empty.head);
+        }
+        freed += cache->stats.reclaimed_pages - before;
+        mutex_unlock(&cache->lock);
+    }
+    mutex_unlock(&cache_chain_lock);
+
+    return freed;
+}
+
+// 获取缓存统计信息
+void kmem_cache_get_stats(kmem_cache_t *cache, kmem_cache_stats_t *stats) {
+    if (!cache || !stats) return;
+
+    mutex_lock(&cache->lock);
+    memcpy(stats, &cache->stats, sizeof(kmem_cache_stats_t));
+    mutex_unlock(&cache->lock);
+}
+
+// 获取缓存名称
+const char *kmem_cache_name(kmem_cache_t *cache) {
+    return cache ? cache->name : NULL;
+}
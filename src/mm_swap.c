@@ -0,0 +1,308 @@
+#include "mm.h"
+#include "sync.h"
+#include "ff.h"
+#include "diskio.h"
+#include <string.h>
+
+#define SWAP_SECTOR_SIZE    512
+#define SWAP_PAGE_SECTORS   (PAGE_SIZE / SWAP_SECTOR_SIZE)
+#define SWAP_MAX_SLOTS      16384   // 最大交换区64MB
+#define SWAP_CACHE_SIZE     256     // 交换缓存哈希表大小（2的幂）
+#define SWAP_ZRAM_BIT       0x80000000 // 槽位位于压缩内存层
+
+// 交换区描述符
+typedef struct {
+    bool active;                   // 是否已启用
+    uint8_t pdrv;                  // diskio物理驱动器号
+    uint32_t start_sector;         // 交换区起始扇区
+    uint32_t nr_slots;             // 槽位数（每槽一页，槽0保留）
+    uint32_t next_slot;            // 下次分配的起始搜索位置
+    uint32_t bitmap[SWAP_MAX_SLOTS / 32]; // 槽位位图
+    swap_stats_t stats;            // 统计信息
+    mutex_t lock;                  // 位图与磁盘I/O锁
+} swap_area_t;
+
+static swap_area_t swap_area;
+
+// 交换缓存：槽位 -> 仍在内存中的页（正在换出或换出后尚未被复用的空闲帧），由页面替换锁保护
+static page_t *swap_cache[SWAP_CACHE_SIZE];
+
+// 初始化交换区
+int swap_init(uint8_t pdrv, uint32_t start_sector, uint32_t nr_pages) {
+    if (disk_initialize(pdrv) & STA_NOINIT) return -1;
+
+    memset(&swap_area, 0, sizeof(swap_area));
+    mutex_init(&swap_area.lock, "swap_lock");
+
+    swap_area.pdrv = pdrv;
+    swap_area.start_sector = start_sector;
+    swap_area.nr_slots = nr_pages < SWAP_MAX_SLOTS ? nr_pages : SWAP_MAX_SLOTS;
+    swap_area.next_slot = 1;
+    swap_area.stats.total_slots = swap_area.nr_slots - 1;
+
+    // 槽0保留，swap_offset为0表示页面没有交换副本
+    swap_area.bitmap[0] = 1;
+    swap_area.active = true;
+
+    return 0;
+}
+
+// 分配交换槽（调用者持有swap_area.lock），失败返回0
+static uint32_t slot_alloc_locked(void) {
+    uint32_t words = (swap_area.nr_slots + 31) / 32;
+    uint32_t start = swap_area.next_slot / 32;
+
+    for (uint32_t i = 0; i < words; i++) {
+        uint32_t w = (start + i) % words;
+        if (swap_area.bitmap[w] == 0xFFFFFFFF) continue;
+
+        uint32_t slot = w * 32 + __builtin_ctz(~swap_area.bitmap[w]);
+        if (slot >= swap_area.nr_slots) continue;
+
+        swap_area.bitmap[w] |= 1u << (slot % 32);
+        swap_area.stats.used_slots++;
+        swap_area.next_slot = slot + 1;
+        return slot;
+    }
+
+    return 0;
+}
+
+// 释放交换槽
+void swap_free(uint32_t slot) {
+    if (slot & SWAP_ZRAM_BIT) {
+        zram_free(slot & ~SWAP_ZRAM_BIT);
+        return;
+    }
+
+    if (!swap_area.active || slot == 0 || slot >= swap_area.nr_slots) return;
+
+    mutex_lock(&swap_area.lock);
+    if (swap_area.bitmap[slot / 32] & (1u << (slot % 32))) {
+        swap_area.bitmap[slot / 32] &= ~(1u << (slot % 32));
+        swap_area.stats.used_slots--;
+    }
+    mutex_unlock(&swap_area.lock);
+}
+
+static inline uint32_t slot_sector(uint32_t slot) {
+    return swap_area.start_sector + slot * SWAP_PAGE_SECTORS;
+}
+
+// 在页面所属地址空间中操作映射（换出由kswapd发起，当前页表不一定是页面所属的页表）
+static pte_t *page_get_pte(page_t *page) {
+    if (!page->mm) return mmu_get_pte(page->vaddr);
+    return mmu_pgd_get_pte((uint32_t *)page->mm->pgd, page->vaddr);
+}
+
+static void page_unmap(page_t *page) {
+    if (!page->mm) {
+        mmu_unmap_page(page->vaddr);
+        return;
+    }
+    mmu_pgd_unmap_page((uint32_t *)page->mm->pgd, page->mm->asid, page->vaddr);
+}
+
+static void page_map_readonly(page_t *page) {
+    uint32_t pa = (uint32_t)page_to_virt(page);
+    if (!page->mm) {
+        mmu_map_page(page->vaddr, pa, MMU_PERM_READ);
+        return;
+    }
+    mmu_pgd_map_page((uint32_t *)page->mm->pgd, page->mm->asid, page->vaddr, pa, MMU_PERM_READ);
+}
+
+// 写回失败：恢复为只读映射，页面保持为脏，下次写入时重新开放写权限
+static void swap_out_abort(page_t *page, pte_t *pte, uint32_t slot, uint32_t valid) {
+    if (pte) pte->swap_offset = 0;
+    page_map_readonly(page);
+    pra_writeback_abort(page, valid);
+    if (slot != valid) swap_free(slot);
+}
+
+// 换出页面：脏页优先压缩到内存，否则写入磁盘交换槽；解除映射并在页表项中记录槽位
+// 返回1表示已写回，0表示干净页直接丢弃，-1表示失败（页面仍保持映射）
+int swap_out(page_t *page) {
+    uint32_t slot = page->swap_slot;
+    bool dirty = page->flags & PG_DIRTY;
+
+    if (dirty) {
+        // 压缩副本已过期，直接丢弃；磁盘槽位可原地重写
+        if (slot & SWAP_ZRAM_BIT) {
+            swap_free(slot);
+            page->swap_slot = slot = 0;
+        }
+
+        if (!slot) {
+            uint32_t index = zram_reserve();
+            if (index) slot = SWAP_ZRAM_BIT | index;
+        }
+
+        if (!slot && swap_area.active) {
+            mutex_lock(&swap_area.lock);
+            slot = slot_alloc_locked();
+            mutex_unlock(&swap_area.lock);
+        }
+
+        if (!slot) return -1;
+    }
+
+    // 有槽位的页先以目标槽位进入交换缓存再解除映射，写回期间的缺页在缓存中等待写回完成
+    uint32_t valid = page->swap_slot;
+    if (slot && pra_writeback_begin(page, slot) < 0) {
+        if (slot != valid) swap_free(slot);
+        return -1;
+    }
+
+    // 先解除映射再写回，避免写回期间的修改丢失
+    pte_t *pte = page_get_pte(page);
+    page_unmap(page);
+    if (pte) {
+        pte->flags.present = 0;
+        pte->swap_offset = slot;
+    }
+
+    if (!dirty) return 0;
+
+    if (slot & SWAP_ZRAM_BIT) {
+        if (zram_store(slot & ~SWAP_ZRAM_BIT, page_to_virt(page)) < 0) {
+            swap_out_abort(page, pte, slot, valid);
+            return -1;
+        }
+    } else {
+        mutex_lock(&swap_area.lock);
+        DRESULT res = disk_write(swap_area.pdrv, page_to_virt(page), slot_sector(slot),
+                                 SWAP_PAGE_SECTORS);
+        if (res == RES_OK) {
+            swap_area.stats.swap_outs++;
+        } else {
+            swap_area.stats.io_errors++;
+        }
+        mutex_unlock(&swap_area.lock);
+
+        if (res != RES_OK) {
+            swap_out_abort(page, pte, slot, valid);
+            return -1;
+        }
+    }
+
+    page->flags &= ~PG_DIRTY;
+    return 1;
+}
+
+// 换入页面：优先从交换缓存取回，否则解压或从交换区读取
+void *swap_in(pte_t *pte) {
+    uint32_t slot = pte->swap_offset;
+
+    void *page = pra_swapcache_get(slot);
+    if (page) {
+        swap_area.stats.cache_hits++;
+        return page;
+    }
+
+    // 等待期间换出失败，页面已恢复映射，槽位中没有有效副本
+    if (pte->flags.present || pte->swap_offset != slot) return NULL;
+
+    page = pra_alloc_page();
+    if (!page) return NULL;
+
+    if (slot & SWAP_ZRAM_BIT) {
+        if (zram_load(slot & ~SWAP_ZRAM_BIT, page) < 0) {
+            pra_free_page(page);
+            return NULL;
+        }
+
+        // 解压后立即释放压缩副本，把内存还给压缩池；此后页面是唯一副本，
+        // 必须标记为脏，否则只读映射的页面在下次回收时会被当作干净页丢弃
+        zram_free(slot & ~SWAP_ZRAM_BIT);
+        pra_mark_dirty(page);
+        return page;
+    }
+
+    mutex_lock(&swap_area.lock);
+    DRESULT res = disk_read(swap_area.pdrv, page, slot_sector(slot), SWAP_PAGE_SECTORS);
+    if (res == RES_OK) {
+        swap_area.stats.swap_ins++;
+    } else {
+        swap_area.stats.io_errors++;
+    }
+    mutex_unlock(&swap_area.lock);
+
+    if (res != RES_OK) {
+        pra_free_page(page);
+        return NULL;
+    }
+
+    // 页面保持干净时，交换槽中的副本仍然有效，再次换出无需写回
+    virt_to_page(page)->swap_slot = slot;
+    pra_mark_clean(page);
+    return page;
+}
+
+static inline uint32_t cache_hash(uint32_t slot) {
+    return (slot * 2654435761u) & (SWAP_CACHE_SIZE - 1);
+}
+
+// 加入交换缓存（调用者持有页面替换锁），表满时返回false
+bool swap_cache_add(page_t *page) {
+    uint32_t i = cache_hash(page->swap_slot);
+
+    for (uint32_t n = 0; n < SWAP_CACHE_SIZE; n++) {
+        if (!swap_cache[i]) {
+            swap_cache[i] = page;
+            page->flags |= PG_SWAPCACHE;
+            return true;
+        }
+        i = (i + 1) & (SWAP_CACHE_SIZE - 1);
+    }
+
+    return false;
+}
+
+// 按槽位查找交换缓存（调用者持有页面替换锁）
+page_t *swap_cache_find(uint32_t slot) {
+    uint32_t i = cache_hash(slot);
+
+    while (swap_cache[i]) {
+        if (swap_cache[i]->swap_slot == slot) return swap_cache[i];
+        i = (i + 1) & (SWAP_CACHE_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+// 从交换缓存删除（调用者持有页面替换锁），后续项前移以保持线性探测链完整
+void swap_cache_del(page_t *page) {
+    if (!(page->flags & PG_SWAPCACHE)) return;
+
+    uint32_t i = cache_hash(page->swap_slot);
+
+    while (swap_cache[i] && swap_cache[i] != page) {
+        i = (i + 1) & (SWAP_CACHE_SIZE - 1);
+    }
+    if (!swap_cache[i]) return;
+
+    swap_cache[i] = NULL;
+    page->flags &= ~PG_SWAPCACHE;
+
+    uint32_t j = (i + 1) & (SWAP_CACHE_SIZE - 1);
+    while (swap_cache[j]) {
+        uint32_t home = cache_hash(swap_cache[j]->swap_slot);
+        // home不在(i, j]区间内时，该项可以移到空位i
+        if (((j - home) & (SWAP_CACHE_SIZE - 1)) >= ((j - i) & (SWAP_CACHE_SIZE - 1))) {
+            swap_cache[i] = swap_cache[j];
+            swap_cache[j] = NULL;
+            i = j;
+        }
+        j = (j + 1) & (SWAP_CACHE_SIZE - 1);
+    }
+}
+
+// 获取交换统计信息
+void swap_get_stats(swap_stats_t *stats) {
+    if (!stats) return;
+
+    mutex_lock(&swap_area.lock);
+    *stats = swap_area.stats;
+    mutex_unlock(&swap_area.lock);
+}
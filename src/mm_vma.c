@@ -0,0 +1,166 @@
+#include "mm.h"
+#include <string.h>
+
+static kmem_cache_t *vma_cache;
+
+// 创建区域描述符缓存
+void vma_cache_init(void) {
+    vma_cache = kmem_cache_create("vm_area", sizeof(vm_area_t), 0, 0, NULL);
+}
+
+// 分配清零的区域描述符
+vm_area_t *vma_alloc(void) {
+    vm_area_t *vma = kmem_cache_alloc(vma_cache);
+    if (vma) {
+        memset(vma, 0, sizeof(vm_area_t));
+    }
+    return vma;
+}
+
+// 释放区域描述符
+void vma_free(vm_area_t *vma) {
+    if (vma) {
+        kmem_cache_free(vma_cache, vma);
+    }
+}
+
+// 查找第一个结束地址大于addr的区域（区域互不重叠，按起始地址排序即可完成区间查找）
+vm_area_t *vma_find(mm_struct_t *mm, uint32_t addr) {
+    vm_area_t *vma = mm->mmap_cache;
+    if (vma && addr >= vma->start && addr < vma->end) {
+        return vma;
+    }
+
+    vm_area_t *best = NULL;
+    rb_node_t *node = mm->mm_rb.rb_node;
+
+    while (node) {
+        vma = rb_entry(node, vm_area_t, vm_rb);
+        if (vma->end > addr) {
+            best = vma;
+            if (vma->start <= addr) break;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    if (best && best->start <= addr) {
+        mm->mmap_cache = best;
+    }
+    return best;
+}
+
+// 查找包含addr的区域，O(log n)，最近命中的区域直接返回
+vm_area_t *vma_lookup(mm_struct_t *mm, uint32_t addr) {
+    vm_area_t *vma = vma_find(mm, addr);
+    return (vma && vma->start <= addr) ? vma : NULL;
+}
+
+// 插入区域（调用者保证不与已有区域重叠），同时维护按地址排序的链表
+void vma_link(mm_struct_t *mm, vm_area_t *vma) {
+    rb_node_t **link = &mm->mm_rb.rb_node;
+    rb_node_t *parent = NULL;
+    vm_area_t *prev = NULL;
+
+    while (*link) {
+        parent = *link;
+        vm_area_t *cur = rb_entry(parent, vm_area_t, vm_rb);
+        if (vma->start < cur->start) {
+            link = &parent->rb_left;
+        } else {
+            prev = cur;
+            link = &parent->rb_right;
+        }
+    }
+
+    rb_link_node(&vma->vm_rb, parent, link);
+    rb_insert_color(&vma->vm_rb, &mm->mm_rb);
+
+    if (prev) {
+        vma->next = prev->next;
+        prev->next = vma;
+    } else {
+        vma->next = mm->mmap;
+        mm->mmap = vma;
+    }
+    mm->map_count++;
+}
+
+// 从树和链表中摘除区域（不释放描述符）
+void vma_unlink(mm_struct_t *mm, vm_area_t *vma) {
+    rb_node_t *node = rb_prev(&vma->vm_rb);
+    vm_area_t *prev = node ? rb_entry(node, vm_area_t, vm_rb) : NULL;
+
+    if (prev) {
+        prev->next = vma->next;
+    } else {
+        mm->mmap = vma->next;
+    }
+
+    rb_erase(&vma->vm_rb, &mm->mm_rb);
+    vma->next = NULL;
+
+    if (mm->mmap_cache == vma) {
+        mm->mmap_cache = NULL;
+    }
+    mm->map_count--;
+}
+
+// 在addr处（页对齐，位于区域内部）拆分区域，返回新建的后半部分
+vm_area_t *vma_split(mm_struct_t *mm, vm_area_t *vma, uint32_t addr) {
+    vm_area_t *tail = vma_alloc();
+    if (!tail) return NULL;
+
+    *tail = *vma;
+    tail->start = addr;
+    if (tail->ino) {
+        tail->pgoff += (addr - vma->start) >> PAGE_SHIFT;
+        tail->ra_next = tail->pgoff;
+        tail->ra_window = 0;
+    }
+    if (tail->map_flags & MAP_PHYS) {
+        tail->phys += addr - vma->start;
+    }
+
+    // 前半部分的起始地址即树的键值不变，只需缩短结束地址
+    vma->end = addr;
+    vma_link(mm, tail);
+    return tail;
+}
+
+// 两个相邻区域能否合并：地址连续、权限与映射标志相同，文件映射还要求文件页连续；
+// 物理映射（共享内存段）按区域起点识别所属段，从不合并
+static bool vma_can_merge(const vm_area_t *a, const vm_area_t *b) {
+    if (a->end != b->start || a->flags != b->flags ||
+        a->map_flags != b->map_flags || a->ino != b->ino) {
+        return false;
+    }
+
+    if (a->map_flags & MAP_PHYS) {
+        return false;
+    }
+
+    return !a->ino || a->pgoff + ((a->end - a->start) >> PAGE_SHIFT) == b->pgoff;
+}
+
+// 与前后相邻的兼容区域合并，返回合并后的区域
+vm_area_t *vma_merge(mm_struct_t *mm, vm_area_t *vma) {
+    while (vma->next && vma_can_merge(vma, vma->next)) {
+        vm_area_t *next = vma->next;
+        vma->end = next->end;
+        vma_unlink(mm, next);
+        vma_free(next);
+    }
+
+    rb_node_t *node = rb_prev(&vma->vm_rb);
+    vm_area_t *prev = node ? rb_entry(node, vm_area_t, vm_rb) : NULL;
+    if (prev && vma_can_merge(prev, vma)) {
+        prev->end = vma->end;
+        vma_unlink(mm, vma);
+        vma_free(vma);
+        vma = prev;
+    }
+
+    return vma;
+}
@@ -0,0 +1,389 @@
+#include "mm.h"
+#include "sync.h"
+#include <string.h>
+
+/*
+ * 压缩内存交换层：被换出的匿名页用LZ4块格式压缩后存入按大小分级的
+ * slab缓存（类似zsmalloc的size class），缺页时解压回内存。
+ * 压缩后超过ZRAM_MAX_COMPRESSED的页按原样整页存储。
+ */
+
+#define ZRAM_CLASS_SIZE      64                      // 大小级别粒度
+#define ZRAM_MAX_COMPRESSED  (PAGE_SIZE * 3 / 4)     // 超过该大小视为不可压缩
+#define ZRAM_CLASSES         (ZRAM_MAX_COMPRESSED / ZRAM_CLASS_SIZE)
+#define ZRAM_HUGE            0xFFFF                  // 整页存储标记
+
+#define LZ4_HASH_BITS        12
+#define LZ4_MIN_MATCH        4
+#define LZ4_LAST_LITERALS    5       // 块末尾必须为字面量的字节数
+#define LZ4_MF_LIMIT         12      // 最后一个匹配必须在块末尾前此距离开始
+
+// 压缩页槽位
+typedef struct {
+    void *handle;          // 压缩数据（NULL表示空闲或正在写入）
+    uint16_t size;         // 压缩后大小，ZRAM_HUGE表示整页
+    uint8_t pending;       // 已预留，数据尚未写入
+    uint8_t used;          // 槽位已分配
+} zram_slot_t;
+
+typedef struct {
+    bool initialized;
+    zram_slot_t *slots;            // 槽位表（槽0保留）
+    uint16_t *free_stack;          // 空闲槽位栈
+    uint32_t free_top;             // 栈顶
+    uint32_t nr_slots;
+    kmem_cache_t *classes[ZRAM_CLASSES]; // 大小级别缓存
+    uint8_t buffer[PAGE_SIZE];     // 压缩输出缓冲
+    uint16_t hash_table[1 << LZ4_HASH_BITS]; // 压缩哈希表
+    // 统计
+    uint32_t pages_stored;
+    uint32_t compr_bytes;
+    uint32_t huge_pages;
+    uint32_t failures;
+    uint64_t compress_cycles;
+    uint32_t compress_count;
+    uint64_t decompress_cycles;
+    uint32_t decompress_count;
+    mutex_t lock;
+    condition_t stored;            // 预留槽位写入完成
+} zram_t;
+
+static zram_t zram;
+
+// 读取PMU周期计数器
+static inline uint32_t read_cycles(void) {
+    uint32_t cycles;
+    __asm__ volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (cycles));
+    return cycles;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static uint8_t *lz4_write_length(uint8_t *op, uint32_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+// LZ4块格式压缩，输出超过cap时返回0
+static uint32_t lz4_compress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + len;
+    const uint8_t *mflimit = end - LZ4_MF_LIMIT;
+    const uint8_t *matchlimit = end - LZ4_LAST_LITERALS;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + cap;
+
+    memset(zram.hash_table, 0, sizeof(zram.hash_table));
+
+    while (len > LZ4_MF_LIMIT && ip < mflimit) {
+        uint32_t seq = read32(ip);
+        uint32_t h = lz4_hash(seq);
+        const uint8_t *ref = src + zram.hash_table[h];
+        zram.hash_table[h] = ip - src;
+
+        if (ref >= ip || ip - ref > 0xFFFF || read32(ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        // 计算匹配长度
+        const uint8_t *mp = ip + LZ4_MIN_MATCH;
+        const uint8_t *rp = ref + LZ4_MIN_MATCH;
+        while (mp < matchlimit && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+
+        uint32_t lit = ip - anchor;
+        uint32_t mlen = mp - ip - LZ4_MIN_MATCH;
+        if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 > oend) return 0;
+
+        // 序列：token、字面量长度、字面量、偏移、匹配长度
+        uint8_t *token = op++;
+        *token = (lit >= 15 ? 15 : lit) << 4;
+        if (lit >= 15) op = lz4_write_length(op, lit - 15);
+        memcpy(op, anchor, lit);
+        op += lit;
+
+        uint32_t offset = ip - ref;
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+
+        *token |= mlen >= 15 ? 15 : mlen;
+        if (mlen >= 15) op = lz4_write_length(op, mlen - 15);
+
+        ip = mp;
+        anchor = ip;
+    }
+
+    // 剩余字面量
+    uint32_t lit = end - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > oend) return 0;
+
+    uint8_t *token = op++;
+    *token = (lit >= 15 ? 15 : lit) << 4;
+    if (lit >= 15) op = lz4_write_length(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    return op - dst;
+}
+
+// LZ4块格式解压，数据损坏时返回-1
+static int lz4_decompress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + cap;
+
+    while (ip < iend) {
+        uint32_t token = *ip++;
+
+        uint32_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (uint32_t)(iend - ip) || lit > (uint32_t)(oend - op)) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        // 最后一个序列只有字面量
+        if (ip >= iend) break;
+
+        if (iend - ip < 2) return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst)) return -1;
+
+        uint32_t mlen = token & 15;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ4_MIN_MATCH;
+        if (mlen > (uint32_t)(oend - op)) return -1;
+
+        // 匹配可能与输出重叠，逐字节复制
+        const uint8_t *ref = op - offset;
+        while (mlen--) {
+            *op++ = *ref++;
+        }
+    }
+
+    return op - dst;
+}
+
+// 初始化压缩交换层，max_pages为最多可存储的页数
+int zram_init(uint32_t max_pages) {
+    if (zram.initialized || max_pages == 0) return -1;
+    if (max_pages > 0xFFFF) max_pages = 0xFFFF;
+
+    zram.slots = mm_alloc(sizeof(zram_slot_t) * (max_pages + 1));
+    zram.free_stack = mm_alloc(sizeof(uint16_t) * max_pages);
+    if (!zram.slots || !zram.free_stack) {
+        mm_free(zram.slots);
+        mm_free(zram.free_stack);
+        return -1;
+    }
+
+    memset(zram.slots, 0, sizeof(zram_slot_t) * (max_pages + 1));
+    zram.nr_slots = max_pages + 1;
+
+    // 槽0保留，低编号槽位先分配
+    zram.free_top = 0;
+    for (uint32_t i = max_pages; i >= 1; i--) {
+        zram.free_stack[zram.free_top++] = i;
+    }
+
+    for (uint32_t i = 0; i < ZRAM_CLASSES; i++) {
+        zram.classes[i] = kmem_cache_create("zram", (i + 1) * ZRAM_CLASS_SIZE, 8, 0, NULL);
+    }
+
+    mutex_init(&zram.lock, "zram_lock");
+    condition_init(&zram.stored, "zram_stored");
+
+    // 使能PMU周期计数器用于延迟统计
+    uint32_t pmcr;
+    __asm__ volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmcr));
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr | 1));
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r" (1u << 31));
+
+    zram.initialized = true;
+    return 0;
+}
+
+// 预留一个槽位（在解除映射前调用，使页表项能立即指向该槽位），满时返回0
+uint32_t zram_reserve(void) {
+    if (!zram.initialized) return 0;
+
+    mutex_lock(&zram.lock);
+
+    uint32_t index = 0;
+    if (zram.free_top > 0) {
+        index = zram.free_stack[--zram.free_top];
+        zram.slots[index].used = 1;
+        zram.slots[index].pending = 1;
+        zram.slots[index].handle = NULL;
+    }
+
+    mutex_unlock(&zram.lock);
+    return index;
+}
+
+// 释放槽位及其压缩数据（调用者持有锁）
+static void slot_release_locked(uint32_t index) {
+    zram_slot_t *slot = &zram.slots[index];
+
+    if (slot->handle) {
+        if (slot->size == ZRAM_HUGE) {
+            mm_free_pages(slot->handle, 1);
+            zram.huge_pages--;
+            zram.compr_bytes -= PAGE_SIZE;
+        } else {
+            kmem_cache_free(zram.classes[(slot->size - 1) / ZRAM_CLASS_SIZE], slot->handle);
+            zram.compr_bytes -= slot->size;
+        }
+        zram.pages_stored--;
+    }
+
+    slot->handle = NULL;
+    slot->used = 0;
+    slot->pending = 0;
+    zram.free_stack[zram.free_top++] = index;
+}
+
+// 压缩页面并写入预留的槽位
+int zram_store(uint32_t index, const void *src) {
+    if (!zram.initialized || index == 0 || index >= zram.nr_slots) return -1;
+
+    mutex_lock(&zram.lock);
+
+    zram_slot_t *slot = &zram.slots[index];
+
+    uint32_t start = read_cycles();
+    uint32_t size = lz4_compress(src, PAGE_SIZE, zram.buffer, ZRAM_MAX_COMPRESSED);
+    zram.compress_cycles += read_cycles() - start;
+    zram.compress_count++;
+
+    void *handle = NULL;
+    if (size > 0) {
+        handle = kmem_cache_alloc(zram.classes[(size - 1) / ZRAM_CLASS_SIZE]);
+        if (handle) {
+            memcpy(handle, zram.buffer, size);
+            zram.compr_bytes += size;
+        }
+    } else {
+        // 不可压缩，整页存储
+        handle = mm_alloc_pages(1);
+        if (handle) {
+            memcpy(handle, src, PAGE_SIZE);
+            size = ZRAM_HUGE;
+            zram.huge_pages++;
+            zram.compr_bytes += PAGE_SIZE;
+        }
+    }
+
+    if (!handle) {
+        // 槽位由调用者通过zram_free释放
+        zram.failures++;
+        slot->pending = 0;
+        condition_broadcast(&zram.stored);
+        mutex_unlock(&zram.lock);
+        return -1;
+    }
+
+    slot->handle = handle;
+    slot->size = size;
+    slot->pending = 0;
+    zram.pages_stored++;
+
+    condition_broadcast(&zram.stored);
+    mutex_unlock(&zram.lock);
+    return 0;
+}
+
+// 解压槽位数据到页面（槽位仍在写入时等待完成）
+int zram_load(uint32_t index, void *dst) {
+    if (!zram.initialized || index == 0 || index >= zram.nr_slots) return -1;
+
+    mutex_lock(&zram.lock);
+
+    zram_slot_t *slot = &zram.slots[index];
+    while (slot->used && slot->pending) {
+        condition_wait(&zram.stored, &zram.lock);
+    }
+
+    if (!slot->used || !slot->handle) {
+        mutex_unlock(&zram.lock);
+        return -1;
+    }
+
+    int ret = 0;
+    if (slot->size == ZRAM_HUGE) {
+        memcpy(dst, slot->handle, PAGE_SIZE);
+    } else {
+        uint32_t start = read_cycles();
+        if (lz4_decompress(slot->handle, slot->size, dst, PAGE_SIZE) != PAGE_SIZE) {
+            ret = -1;
+        }
+        zram.decompress_cycles += read_cycles() - start;
+        zram.decompress_count++;
+    }
+
+    mutex_unlock(&zram.lock);
+    return ret;
+}
+
+// 释放槽位
+void zram_free(uint32_t index) {
+    if (!zram.initialized || index == 0 || index >= zram.nr_slots) return;
+
+    mutex_lock(&zram.lock);
+    if (zram.slots[index].used) {
+        slot_release_locked(index);
+    }
+    mutex_unlock(&zram.lock);
+}
+
+// 获取压缩交换统计信息
+void zram_get_stats(zram_stats_t *stats) {
+    if (!stats) return;
+
+    mutex_lock(&zram.lock);
+
+    stats->pages_stored = zram.pages_stored;
+    stats->compr_bytes = zram.compr_bytes;
+    stats->huge_pages = zram.huge_pages;
+    stats->failures = zram.failures;
+    stats->ratio = zram.compr_bytes ?
+        (uint32_t)((uint64_t)zram.pages_stored * PAGE_SIZE * 100 / zram.compr_bytes) : 0;
+    stats->avg_compress_cycles = zram.compress_count ?
+        (uint32_t)(zram.compress_cycles / zram.compress_count) : 0;
+    stats->avg_decompress_cycles = zram.decompress_count ?
+        (uint32_t)(zram.decompress_cycles / zram.decompress_count) : 0;
+
+    mutex_unlock(&zram.lock);
+}
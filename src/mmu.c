@@ -1,5 +1,9 @@
 #include "mmu.h"
+#include "cache.h"
+#include "mm.h"
+#include "task.h"
 #include <stdint.h>
+#include <stddef.h>
 
 // 一级页表基地址
 static uint32_t *first_level_table = (uint32_t *)0x70004000;
@@ -7,6 +11,33 @@ static uint32_t *first_level_table = (uint32_t *)0x70004000;
 // 二级页表基地址
 static uint32_t *second_level_table = (uint32_t *)0x70008000;
 
+// TTBCR.N=1：低2GB（内核、外设、RAM）由TTBR0的内核页表转换且从不切换，
+// 高2GB（用户空间）由TTBR1转换，上下文切换时只更换TTBR1与CONTEXTIDR
+#define TTBCR_N         1
+#define TTBR1_BASE      0x80000000
+
+// ASID分配：上下文标识 = 代数 << 8 | 8位硬件ASID，代数不同的ASID在首次切换时重新分配
+#define ASID_BITS       8
+#define ASID_MASK       ((1u << ASID_BITS) - 1)
+#define ASID_FIRST_VERSION (1u << ASID_BITS)
+#define NUM_ASIDS       (1u << ASID_BITS)
+
+// 每个CPU当前的用户页表与上下文标识（内核任务使用内核页表与保留ASID 0）
+static uint32_t *cpu_pgd[MAX_CPUS];
+static uint32_t active_asids[MAX_CPUS];
+
+// 回绕时各CPU正在使用的上下文标识，在新一代中保持不变
+static uint32_t reserved_asids[MAX_CPUS];
+
+// 回绕后各CPU在下次分配时需失效本地TLB
+static bool tlb_flush_pending[MAX_CPUS];
+
+// 当前代数与本代已分配的ASID位图，ASID 0保留给切换过程和内核任务
+static spinlock_t asid_lock;
+static uint32_t asid_generation = ASID_FIRST_VERSION;
+static uint32_t asid_map[NUM_ASIDS / 32] = { 1 };
+static uint32_t asid_next = 1;
+
 // MMU 访问权限定义
 #define AP_NO_ACCESS     0
 #define AP_SYS_ACCESS    1
@@ -26,6 +57,61 @@ static uint32_t *second_level_table = (uint32_t *)0x70008000;
 // 段描述符类型
 #define SECTION_TYPE    2
 #define SMALL_PAGE_TYPE 2
+#define PDE_TYPE_MASK   3
+#define PDE_TYPE_TABLE  1
+
+// 二级页表页布局：前1KB为256项硬件页表，偏移2KB处为256项软件页表项pte_t
+#define L2_SHADOW_OFFSET 2048
+
+// 二级页表项位定义（SCTLR.AFE=1时AP[0]作为访问标志）
+#define PTE_TYPE_MASK   3
+#define PTE_TYPE_LARGE  1          // 64KB大页，16个连续表项重复
+#define PTE_TYPE_SMALL  2          // 4KB小页（bit0为XN）
+#define PTE_XN          (1 << 0)
+#define PTE_B           (1 << 2)
+#define PTE_C           (1 << 3)
+#define PTE_AF          (1 << 4)   // AP[0]：访问标志
+#define PTE_AP_USER     (1 << 5)   // AP[1]：用户态可访问
+#define PTE_SMALL_TEX(x) ((x) << 6)
+#define PTE_AP_RO       (1 << 9)   // AP[2]：只读
+#define PTE_S           (1 << 10)  // 多核共享
+#define PTE_NG          (1 << 11)  // 非全局，按ASID匹配
+#define PTE_LARGE_TEX(x) ((x) << 12)
+#define PTE_LARGE_XN    (1 << 15)
+#define LARGE_PAGE_SIZE 0x10000
+#define LARGE_PTES      16
+
+// 一级段描述符位定义（1MB段与16MB超级段，超级段的16个连续表项重复）
+#define SECT_B          (1 << 2)
+#define SECT_C          (1 << 3)
+#define SECT_XN         (1 << 4)
+#define SECT_AF         (1 << 10)  // AP[0]：访问标志
+#define SECT_AP_USER    (1 << 11)  // AP[1]：用户态可访问
+#define SECT_TEX(x)     ((x) << 12)
+#define SECT_AP_RO      (1 << 15)  // AP[2]：只读
+#define SECT_S          (1 << 16)
+#define SECT_NG         (1 << 17)
+#define SECT_SUPER      (1 << 18)
+#define SECT_ATTR_MASK  (SECT_B | SECT_C | SECT_XN | SECT_AF | SECT_AP_USER | SECT_TEX(7) | \
+                         SECT_AP_RO | SECT_S | SECT_NG)
+#define SUPERSECTION_SIZE 0x1000000
+#define SUPERSECTION_PDES 16
+
+// 批处理范围超过该页数时改为按ASID整体失效
+#define TLB_RANGE_MAX   64
+
+// 系统控制寄存器位
+#define SCTLR_TRE       (1 << 28)  // TEX remap使能
+#define SCTLR_AFE       (1 << 29)  // 访问标志使能
+
+// 内存类型到TEX remap属性表索引
+static const uint8_t mt_attr_index[] = {
+    [MMU_MT_NORMAL] = MMU_ATTR_NORMAL_WB,
+    [MMU_MT_NORMAL_WT] = MMU_ATTR_NORMAL_WT,
+    [MMU_MT_NORMAL_NC] = MMU_ATTR_NORMAL_NC,
+    [MMU_MT_DEVICE] = MMU_ATTR_DEVICE,
+    [MMU_MT_STRONGLY_ORDERED] = MMU_ATTR_SO,
+};
 
 void mmu_init(void) {
     uint32_t i;
@@ -60,8 +146,16 @@ void mmu_init(void) {
                               (AP_USER_RW << 10); // 用户可读写
     }
 
-    // 设置转换表基地址寄存器
+    // TEX remap属性表
+    __asm__ volatile ("mcr p15, 0, %0, c10, c2, 0" : : "r" (MMU_PRRR));
+    __asm__ volatile ("mcr p15, 0, %0, c10, c2, 1" : : "r" (MMU_NMRR));
+
+    // 设置转换表基地址寄存器：TTBR0固定为内核页表，TTBR1初始指向内核页表（高2GB无映射）
     __asm__ volatile ("mcr p15, 0, %0, c2, c0, 0" : : "r" (first_level_table));
+    __asm__ volatile ("mcr p15, 0, %0, c2, c0, 1" : : "r" (first_level_table));
+    __asm__ volatile ("mcr p15, 0, %0, c2, c0, 2" : : "r" (TTBCR_N));
+    __asm__ volatile ("mcr p15, 0, %0, c13, c0, 1" : : "r" (0));
+    spinlock_init(&asid_lock, "asid");
 
     // 使无效TLB
     __asm__ volatile ("mcr p15, 0, %0, c8, c7, 0" : : "r" (0));
@@ -77,6 +171,8 @@ void mmu_enable(void) {
     uint32_t control;
     __asm__ volatile ("mrc p15, 0, %0, c1, c0, 0" : "=r" (control));
     control |= 1;  // 启用MMU
+    control |= SCTLR_AFE;  // AP[0]作为访问标志，用于页面老化
+    control |= SCTLR_TRE;  // 内存类型由PRRR/NMRR属性表解释
     __asm__ volatile ("mcr p15, 0, %0, c1, c0, 0" : : "r" (control));
 }
 
@@ -93,4 +189,859 @@ void mmu_map_section(uint32_t va, uint32_t pa, uint32_t flags) {
     
     // 使无效TLB
     __asm__ volatile ("mcr p15, 0, %0, c8, c7, 1" : : "r" (va));
-} 
\ No newline at end of file
+}
+
+// 用户空间地址
+static inline bool is_user_addr(uint32_t va) {
+    return va >= USER_SPACE_BASE && va < USER_SPACE_BASE + USER_SPACE_SIZE;
+}
+
+static inline bool pte_valid(uint32_t pte) {
+    return (pte & PTE_TYPE_MASK) != 0;
+}
+
+static inline bool pte_is_large(uint32_t pte) {
+    return (pte & PTE_TYPE_MASK) == PTE_TYPE_LARGE;
+}
+
+// 在指定一级页表中查找虚拟地址对应的二级页表项（小页或大页），未映射时返回NULL
+static uint32_t *pgd_lookup_pte(uint32_t *pgd, uint32_t va) {
+    uint32_t pde = pgd[va >> 20];
+    if ((pde & PDE_TYPE_MASK) != PDE_TYPE_TABLE) return NULL;
+
+    uint32_t *table = (uint32_t *)(pde & 0xFFFFFC00);
+    uint32_t *pte = &table[(va >> 12) & 0xFF];
+    return pte_valid(*pte) ? pte : NULL;
+}
+
+// 虚拟地址所在的页表：用户地址使用当前CPU的TTBR1页表，其余使用内核页表
+static inline uint32_t *va_pgd(uint32_t va) {
+    uint32_t *pgd = cpu_pgd[smp_processor_id()];
+    return (va >= TTBR1_BASE && pgd) ? pgd : first_level_table;
+}
+
+// 当前CPU的硬件ASID
+static inline uint32_t cur_asid(void) {
+    return active_asids[smp_processor_id()] & ASID_MASK;
+}
+
+// 查找当前页表中的二级页表项
+static uint32_t *lookup_pte(uint32_t va) {
+    return pgd_lookup_pte(va_pgd(va), va);
+}
+
+// 硬件页表项对应的软件页表项（同一页内偏移2KB处）
+static inline pte_t *pte_shadow(uint32_t *pte) {
+    uint32_t base = (uint32_t)pte & ~(PAGE_SIZE - 1);
+    uint32_t index = ((uint32_t)pte & 0x3FF) / sizeof(uint32_t);
+    return &((pte_t *)(base + L2_SHADOW_OFFSET))[index];
+}
+
+// 清理页表所在缓存行，保证硬件页表遍历可见
+static inline void table_clean(void *addr, uint32_t size) {
+    dcache_clean_range(addr, size);
+}
+
+// 使单页TLB项无效：用户地址按MVA+ASID（TLBIMVAIS），内核全局映射按MVA匹配所有ASID（TLBIMVAAIS）
+static inline void tlb_inv_page(uint32_t va, uint32_t asid) {
+    if (is_user_addr(va)) {
+        __asm__ volatile ("mcr p15, 0, %0, c8, c3, 1" : : "r" ((va & PAGE_MASK) | (asid & ASID_MASK)));
+    } else {
+        __asm__ volatile ("mcr p15, 0, %0, c8, c3, 3" : : "r" (va & PAGE_MASK));
+    }
+}
+
+// 使[start, end)范围的TLB项无效，范围较大时按ASID（TLBIASIDIS）或全部（TLBIALLIS）失效
+static void tlb_flush_range(uint32_t start, uint32_t end, uint32_t asid) {
+    __asm__ volatile ("dsb");
+
+    if (((end - start) >> PAGE_SHIFT) > TLB_RANGE_MAX) {
+        if (is_user_addr(start) && is_user_addr(end - 1)) {
+            __asm__ volatile ("mcr p15, 0, %0, c8, c3, 2" : : "r" (asid & ASID_MASK));
+        } else {
+            __asm__ volatile ("mcr p15, 0, %0, c8, c3, 0" : : "r" (0));
+        }
+    } else {
+        for (uint32_t va = start; va < end; va += PAGE_SIZE) {
+            tlb_inv_page(va, asid);
+        }
+    }
+
+    __asm__ volatile ("dsb\n" "isb");
+}
+
+// 当前任务的TLB批处理（内核启动阶段没有当前任务）
+static inline mmu_batch_t *current_batch(void) {
+    task_t *task = task_get_current();
+    return task ? task->tlb_batch : NULL;
+}
+
+// 使[va, va+size)的TLB项无效；当前地址空间处于批处理时只记录范围，结束时统一失效
+static void tlb_invalidate(uint32_t va, uint32_t size, uint32_t asid) {
+    mmu_batch_t *batch = (asid & ASID_MASK) == cur_asid() ? current_batch() : NULL;
+    va &= PAGE_MASK;
+
+    if (batch) {
+        if (batch->end == 0) {
+            batch->start = va;
+            batch->end = va + size;
+        } else {
+            if (va < batch->start) batch->start = va;
+            if (va + size > batch->end) batch->end = va + size;
+        }
+        return;
+    }
+
+    tlb_flush_range(va, va + size, asid);
+}
+
+// 更新页表项（大页同时更新全部16个重复项）并使对应TLB项无效
+static void pte_set(uint32_t *pte, uint32_t value, uint32_t va, uint32_t asid) {
+    if (pte_is_large(*pte) && pte_is_large(value)) {
+        uint32_t *first = (uint32_t *)((uint32_t)pte & ~(LARGE_PTES * sizeof(uint32_t) - 1));
+        for (uint32_t i = 0; i < LARGE_PTES; i++) {
+            first[i] = value;
+        }
+        table_clean(first, LARGE_PTES * sizeof(uint32_t));
+        tlb_invalidate(va & ~(LARGE_PAGE_SIZE - 1), PAGE_SIZE, asid);
+        return;
+    }
+
+    *pte = value;
+    table_clean(pte, sizeof(uint32_t));
+    tlb_invalidate(va, PAGE_SIZE, asid);
+}
+
+// 修改页表项的若干位
+static inline void pte_modify(uint32_t *pte, uint32_t clear, uint32_t set, uint32_t va, uint32_t asid) {
+    pte_set(pte, (*pte & ~clear) | set, va, asid);
+}
+
+// 映射权限中的内存类型对应的属性表索引
+static inline uint32_t prot_attr_index(uint32_t prot) {
+    uint32_t mt = (prot & MMU_PERM_MT_MASK) >> 8;
+    return mt < sizeof(mt_attr_index) ? mt_attr_index[mt] : MMU_ATTR_NORMAL_WB;
+}
+
+// 设备与强序内存不可执行
+static inline bool prot_exec(uint32_t prot) {
+    uint32_t index = prot_attr_index(prot);
+    return (prot & MMU_PERM_EXEC) && index != MMU_ATTR_DEVICE && index != MMU_ATTR_SO;
+}
+
+// 生成页表项属性：内存类型按属性表索引编码到TEX[0]:C:B，多核共享；用户映射为非全局项
+static uint32_t pte_attrs(uint32_t va, uint32_t prot, bool large) {
+    uint32_t index = prot_attr_index(prot);
+    uint32_t attrs = PTE_AF | PTE_S;
+
+    if (index & 1) attrs |= PTE_B;
+    if (index & 2) attrs |= PTE_C;
+    if (index & 4) attrs |= large ? PTE_LARGE_TEX(1) : PTE_SMALL_TEX(1);
+    if (is_user_addr(va) || (prot & MMU_PERM_USER)) attrs |= PTE_AP_USER | PTE_NG;
+    if (!(prot & MMU_PERM_WRITE)) attrs |= PTE_AP_RO;
+    if (!prot_exec(prot)) attrs |= large ? PTE_LARGE_XN : PTE_XN;
+
+    return attrs;
+}
+
+// 以不缓存或写通类型映射RAM前，清理并失效内核可缓存映射中该物理范围的缓存行，避免属性不一致的别名
+static void mt_sync_alias(uint32_t pa, uint32_t size, uint32_t prot) {
+    if (prot_attr_index(prot) == MMU_ATTR_NORMAL_WB) return;
+    if (pa < RAM_BASE || pa >= RAM_BASE + RAM_SIZE) return;
+
+    dcache_flush_range((void *)pa, size);
+}
+
+// 大页拆分为16个属性相同的小页（先断开再建立，避免TLB中同时存在两种大小的项）
+static void large_split(uint32_t *pte, uint32_t va, uint32_t asid) {
+    uint32_t *first = (uint32_t *)((uint32_t)pte & ~(LARGE_PTES * sizeof(uint32_t) - 1));
+    uint32_t large = *first;
+    uint32_t base = large & 0xFFFF0000;
+
+    // TEX与XN在两种格式中位置不同，其余属性位相同
+    uint32_t attrs = large & (PTE_B | PTE_C | PTE_AF | PTE_AP_USER | PTE_AP_RO | PTE_S | PTE_NG);
+    attrs |= PTE_SMALL_TEX((large >> 12) & 7);
+    if (large & PTE_LARGE_XN) attrs |= PTE_XN;
+
+    va &= ~(LARGE_PAGE_SIZE - 1);
+    for (uint32_t i = 0; i < LARGE_PTES; i++) {
+        first[i] = 0;
+    }
+    table_clean(first, LARGE_PTES * sizeof(uint32_t));
+    tlb_flush_range(va, va + LARGE_PAGE_SIZE, asid);
+
+    for (uint32_t i = 0; i < LARGE_PTES; i++) {
+        first[i] = (base + i * PAGE_SIZE) | PTE_TYPE_SMALL | attrs;
+    }
+    table_clean(first, LARGE_PTES * sizeof(uint32_t));
+}
+
+static inline bool pde_is_section(uint32_t pde) {
+    return (pde & PDE_TYPE_MASK) == SECTION_TYPE;
+}
+
+static inline bool pde_is_supersection(uint32_t pde) {
+    return pde_is_section(pde) && (pde & SECT_SUPER);
+}
+
+// 段映射的物理地址
+static inline uint32_t section_phys(uint32_t pde, uint32_t va) {
+    if (pde & SECT_SUPER) {
+        return (pde & 0xFF000000) | (va & (SUPERSECTION_SIZE - 1));
+    }
+    return (pde & 0xFFF00000) | (va & (SECTION_SIZE - 1));
+}
+
+// 生成段描述符属性，与pte_attrs一致
+static uint32_t sect_attrs(uint32_t va, uint32_t prot) {
+    uint32_t index = prot_attr_index(prot);
+    uint32_t attrs = SECT_AF | SECT_S;
+
+    if (index & 1) attrs |= SECT_B;
+    if (index & 2) attrs |= SECT_C;
+    if (index & 4) attrs |= SECT_TEX(1);
+    if (is_user_addr(va) || (prot & MMU_PERM_USER)) attrs |= SECT_AP_USER | SECT_NG;
+    if (!(prot & MMU_PERM_WRITE)) attrs |= SECT_AP_RO;
+    if (!prot_exec(prot)) attrs |= SECT_XN;
+
+    return attrs;
+}
+
+// 段属性转换为小页属性
+static uint32_t sect_to_pte_attrs(uint32_t sect) {
+    uint32_t attrs = sect & (PTE_B | PTE_C);
+
+    if (sect & SECT_AF) attrs |= PTE_AF;
+    if (sect & SECT_AP_USER) attrs |= PTE_AP_USER;
+    if (sect & SECT_AP_RO) attrs |= PTE_AP_RO;
+    if (sect & SECT_S) attrs |= PTE_S;
+    if (sect & SECT_NG) attrs |= PTE_NG;
+    if (sect & SECT_XN) attrs |= PTE_XN;
+
+    return attrs | PTE_SMALL_TEX((sect >> 12) & 7);
+}
+
+// 超级段拆分为16个属性相同的段（先断开再建立）
+static void supersection_split(uint32_t *pgd, uint32_t va, uint32_t asid) {
+    uint32_t *first = &pgd[(va >> 20) & ~(SUPERSECTION_PDES - 1)];
+    uint32_t base = *first & 0xFF000000;
+    uint32_t attrs = *first & SECT_ATTR_MASK;
+
+    va &= ~(SUPERSECTION_SIZE - 1);
+    for (uint32_t i = 0; i < SUPERSECTION_PDES; i++) {
+        first[i] = 0;
+    }
+    table_clean(first, SUPERSECTION_PDES * sizeof(uint32_t));
+    tlb_flush_range(va, va + SUPERSECTION_SIZE, asid);
+
+    for (uint32_t i = 0; i < SUPERSECTION_PDES; i++) {
+        first[i] = (base + i * SECTION_SIZE) | SECTION_TYPE | attrs;
+    }
+    table_clean(first, SUPERSECTION_PDES * sizeof(uint32_t));
+}
+
+// 段拆分为256个小页组成的二级页表（先断开再建立），返回新页表
+static uint32_t *section_split(uint32_t *pgd, uint32_t va, uint32_t asid) {
+    if (pde_is_supersection(pgd[va >> 20])) {
+        supersection_split(pgd, va, asid);
+    }
+
+    uint32_t *pde = &pgd[va >> 20];
+    uint32_t sect = *pde;
+    uint32_t base = sect & 0xFFF00000;
+    uint32_t attrs = sect_to_pte_attrs(sect);
+
+    uint32_t *table = mm_alloc_pages(1);
+    if (!table) return NULL;
+
+    pte_t *shadow = (pte_t *)((uint8_t *)table + L2_SHADOW_OFFSET);
+    for (uint32_t i = 0; i < 256; i++) {
+        table[i] = (base + i * PAGE_SIZE) | PTE_TYPE_SMALL | attrs;
+        shadow[i].flags.present = 1;
+        shadow[i].flags.writable = (sect & SECT_AP_RO) ? 0 : 1;
+        shadow[i].flags.user = (sect & SECT_AP_USER) ? 1 : 0;
+        shadow[i].flags.frame = (base >> PAGE_SHIFT) + i;
+        shadow[i].swap_offset = 0;
+    }
+    table_clean(table, 1024);
+
+    va &= ~(SECTION_SIZE - 1);
+    *pde = 0;
+    table_clean(pde, sizeof(uint32_t));
+    tlb_flush_range(va, va + SECTION_SIZE, asid);
+
+    *pde = (uint32_t)table | PDE_TYPE_TABLE;
+    table_clean(pde, sizeof(uint32_t));
+    return table;
+}
+
+// 获取指定页表的二级页表，不存在时分配（整页：前1KB硬件页表，偏移2KB处为软件页表项），
+// 已被段映射覆盖时先拆分
+static uint32_t *pgd_l2_table(uint32_t *pgd, uint32_t va, uint32_t asid) {
+    uint32_t *pde = &pgd[va >> 20];
+
+    if (pde_is_section(*pde)) {
+        return section_split(pgd, va, asid);
+    }
+
+    if ((*pde & PDE_TYPE_MASK) != PDE_TYPE_TABLE) {
+        uint8_t *table = mm_alloc_pages(1);
+        if (!table) return NULL;
+
+        for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+            table[i] = 0;
+        }
+        table_clean(table, 1024);
+
+        *pde = (uint32_t)table | PDE_TYPE_TABLE;
+        table_clean(pde, sizeof(uint32_t));
+    }
+
+    return (uint32_t *)(*pde & 0xFFFFFC00);
+}
+
+// 查找二级页表项，va位于段映射内时先拆分
+static uint32_t *pgd_split_lookup(uint32_t *pgd, uint32_t va, uint32_t asid) {
+    if (pde_is_section(pgd[va >> 20]) && !section_split(pgd, va, asid)) {
+        return NULL;
+    }
+    return pgd_lookup_pte(pgd, va);
+}
+
+// 记录软件页表项的映射状态（交换槽由调用者维护）
+static inline void shadow_set(uint32_t *pte, uint32_t pa, uint32_t va, uint32_t prot) {
+    pte_t *shadow = pte_shadow(pte);
+    shadow->flags.present = 1;
+    shadow->flags.writable = (prot & MMU_PERM_WRITE) ? 1 : 0;
+    shadow->flags.user = (is_user_addr(va) || (prot & MMU_PERM_USER)) ? 1 : 0;
+    shadow->flags.frame = pa >> PAGE_SHIFT;
+}
+
+// 在指定页表中建立4KB映射，按需分配二级页表；替换已有的不同物理页时先断开旧映射
+int mmu_pgd_map_page(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t pa, uint32_t prot) {
+    uint32_t *table = pgd_l2_table(pgd, va, asid);
+    if (!table) return -1;
+
+    uint32_t *pte = &table[(va >> 12) & 0xFF];
+    if (pte_is_large(*pte)) {
+        large_split(pte, va, asid);
+    }
+
+    if (pte_valid(*pte) && (*pte & 0xFFFFF000) != (pa & 0xFFFFF000)) {
+        *pte = 0;
+        table_clean(pte, sizeof(uint32_t));
+        tlb_flush_range(va & PAGE_MASK, (va & PAGE_MASK) + PAGE_SIZE, asid);
+    }
+
+    mt_sync_alias(pa & PAGE_MASK, PAGE_SIZE, prot);
+    pte_set(pte, (pa & 0xFFFFF000) | PTE_TYPE_SMALL | pte_attrs(va, prot, false), va, asid);
+    shadow_set(pte, pa & PAGE_MASK, va, prot);
+    return 0;
+}
+
+// 在当前页表中建立4KB映射
+int mmu_map_page(uint32_t va, uint32_t pa, uint32_t prot) {
+    return mmu_pgd_map_page(va_pgd(va), cur_asid(), va, pa, prot);
+}
+
+// 在指定页表中建立64KB大页映射（va与pa都需64KB对齐），减少TLB项占用
+static int pgd_map_large(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t pa, uint32_t prot) {
+    if ((va | pa) & (LARGE_PAGE_SIZE - 1)) return -1;
+
+    uint32_t *table = pgd_l2_table(pgd, va, asid);
+    if (!table) return -1;
+
+    uint32_t *first = &table[(va >> 12) & 0xF0];
+    uint32_t value = (pa & 0xFFFF0000) | PTE_TYPE_LARGE | pte_attrs(va, prot, true);
+    mt_sync_alias(pa, LARGE_PAGE_SIZE, prot);
+
+    // 先断开原有的小页映射，再写入16个重复项
+    bool mapped = false;
+    for (uint32_t i = 0; i < LARGE_PTES; i++) {
+        mapped |= pte_valid(first[i]);
+        first[i] = 0;
+    }
+    if (mapped) {
+        table_clean(first, LARGE_PTES * sizeof(uint32_t));
+        tlb_flush_range(va, va + LARGE_PAGE_SIZE, asid);
+    }
+
+    for (uint32_t i = 0; i < LARGE_PTES; i++) {
+        first[i] = value;
+        shadow_set(&first[i], pa + i * PAGE_SIZE, va + i * PAGE_SIZE, prot);
+    }
+    table_clean(first, LARGE_PTES * sizeof(uint32_t));
+    return 0;
+}
+
+// 在当前页表中建立64KB大页映射
+int mmu_map_large_page(uint32_t va, uint32_t pa, uint32_t prot) {
+    return pgd_map_large(va_pgd(va), cur_asid(), va, pa, prot);
+}
+
+// 一级表项可改为段映射：空表项，或没有有效项的二级页表（释放页表，并失效页表遍历缓存）
+static bool pde_reclaim_empty(uint32_t *pgd, uint32_t va, uint32_t asid) {
+    uint32_t *pde = &pgd[va >> 20];
+
+    if (*pde == 0) return true;
+    if ((*pde & PDE_TYPE_MASK) != PDE_TYPE_TABLE) return false;
+
+    uint32_t *table = (uint32_t *)(*pde & 0xFFFFFC00);
+    pte_t *shadow = (pte_t *)((uint8_t *)table + L2_SHADOW_OFFSET);
+    for (uint32_t i = 0; i < 256; i++) {
+        if (pte_valid(table[i]) || shadow[i].swap_offset) return false;
+    }
+
+    *pde = 0;
+    table_clean(pde, sizeof(uint32_t));
+    tlb_invalidate(va & ~(SECTION_SIZE - 1), SECTION_SIZE, asid);
+    mm_free_pages(table, 1);
+    return true;
+}
+
+// 按对齐与剩余长度选择最大的映射粒度：16MB超级段、1MB段、64KB大页或4KB小页，
+// 用于物理连续的大缓冲区，减少TLB项占用
+int mmu_pgd_map_range(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t pa, uint32_t size, uint32_t prot) {
+    uint32_t end = va + size;
+
+    if ((va | pa | size) & ~PAGE_MASK) return -1;
+
+    while (va < end) {
+        uint32_t remain = end - va;
+        uint32_t index = va >> 20;
+
+        if (!((va | pa) & (SUPERSECTION_SIZE - 1)) && remain >= SUPERSECTION_SIZE) {
+            bool empty = true;
+            for (uint32_t i = 0; i < SUPERSECTION_PDES && empty; i++) {
+                empty = pde_reclaim_empty(pgd, va + i * SECTION_SIZE, asid);
+            }
+            if (empty) {
+                mt_sync_alias(pa, SUPERSECTION_SIZE, prot);
+                uint32_t value = (pa & 0xFF000000) | SECTION_TYPE | SECT_SUPER | sect_attrs(va, prot);
+                for (uint32_t i = 0; i < SUPERSECTION_PDES; i++) {
+                    pgd[index + i] = value;
+                }
+                table_clean(&pgd[index], SUPERSECTION_PDES * sizeof(uint32_t));
+                va += SUPERSECTION_SIZE;
+                pa += SUPERSECTION_SIZE;
+                continue;
+            }
+        }
+
+        if (!((va | pa) & (SECTION_SIZE - 1)) && remain >= SECTION_SIZE &&
+            pde_reclaim_empty(pgd, va, asid)) {
+            mt_sync_alias(pa, SECTION_SIZE, prot);
+            pgd[index] = (pa & 0xFFF00000) | SECTION_TYPE | sect_attrs(va, prot);
+            table_clean(&pgd[index], sizeof(uint32_t));
+            va += SECTION_SIZE;
+            pa += SECTION_SIZE;
+            continue;
+        }
+
+        if (!((va | pa) & (LARGE_PAGE_SIZE - 1)) && remain >= LARGE_PAGE_SIZE) {
+            if (pgd_map_large(pgd, asid, va, pa, prot) < 0) return -1;
+            va += LARGE_PAGE_SIZE;
+            pa += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        if (mmu_pgd_map_page(pgd, asid, va, pa, prot) < 0) return -1;
+        va += PAGE_SIZE;
+        pa += PAGE_SIZE;
+    }
+
+    return 0;
+}
+
+// 在当前页表中按最大粒度映射物理连续区域
+int mmu_map_range(uint32_t va, uint32_t pa, uint32_t size, uint32_t prot) {
+    return mmu_pgd_map_range(va_pgd(va), cur_asid(), va, pa, size, prot);
+}
+
+// 解除指定页表中的4KB映射（位于大页内时先拆分），软件页表项中的交换槽保留
+void mmu_pgd_unmap_page(uint32_t *pgd, uint32_t asid, uint32_t va) {
+    uint32_t *pte = pgd_split_lookup(pgd, va, asid);
+    if (!pte) return;
+
+    if (pte_is_large(*pte)) {
+        large_split(pte, va, asid);
+    }
+
+    pte_set(pte, 0, va, asid);
+    pte_shadow(pte)->flags.present = 0;
+}
+
+// 解除当前页表中的4KB映射
+void mmu_unmap_page(uint32_t va) {
+    mmu_pgd_unmap_page(va_pgd(va), cur_asid(), va);
+}
+
+// 解除指定页表中[va, va+size)的映射，整段覆盖的段与超级段直接清除，部分覆盖时拆分
+void mmu_pgd_unmap_range(uint32_t *pgd, uint32_t asid, uint32_t va, uint32_t size) {
+    uint32_t end = va + size;
+
+    while (va < end) {
+        uint32_t *pde = &pgd[va >> 20];
+        uint32_t remain = end - va;
+
+        if (pde_is_supersection(*pde)) {
+            if (!(va & (SUPERSECTION_SIZE - 1)) && remain >= SUPERSECTION_SIZE) {
+                for (uint32_t i = 0; i < SUPERSECTION_PDES; i++) {
+                    pde[i] = 0;
+                }
+                table_clean(pde, SUPERSECTION_PDES * sizeof(uint32_t));
+                tlb_invalidate(va, SUPERSECTION_SIZE, asid);
+                va += SUPERSECTION_SIZE;
+                continue;
+            }
+            supersection_split(pgd, va, asid);
+        }
+
+        if (pde_is_section(*pde) && !(va & (SECTION_SIZE - 1)) && remain >= SECTION_SIZE) {
+            *pde = 0;
+            table_clean(pde, sizeof(uint32_t));
+            tlb_invalidate(va, SECTION_SIZE, asid);
+            va += SECTION_SIZE;
+            continue;
+        }
+
+        mmu_pgd_unmap_page(pgd, asid, va);
+        va += PAGE_SIZE;
+    }
+}
+
+// 解除当前页表中[va, va+size)的映射
+void mmu_unmap_range(uint32_t va, uint32_t size) {
+    mmu_pgd_unmap_range(va_pgd(va), cur_asid(), va, size);
+}
+
+// 修改4KB页的访问权限（位于大页或段内时先拆分）
+int mmu_update_prot(uint32_t va, uint32_t prot) {
+    uint32_t *pte = pgd_split_lookup(va_pgd(va), va, cur_asid());
+    if (!pte) return -1;
+
+    if (pte_is_large(*pte)) {
+        large_split(pte, va, cur_asid());
+    }
+
+    // 保留访问标志，其余属性按新权限重新生成
+    uint32_t af = *pte & PTE_AF;
+    uint32_t value = (*pte & 0xFFFFF000) | PTE_TYPE_SMALL | (pte_attrs(va, prot, false) & ~PTE_AF) | af;
+    pte_set(pte, value, va, cur_asid());
+    pte_shadow(pte)->flags.writable = (prot & MMU_PERM_WRITE) ? 1 : 0;
+    return 0;
+}
+
+// 开始TLB批处理：之后的页表修改只记录范围，mmu_batch_end时统一失效
+void mmu_batch_begin(mmu_batch_t *batch) {
+    task_t *task = task_get_current();
+
+    batch->start = 0;
+    batch->end = 0;
+    batch->prev = task ? task->tlb_batch : NULL;
+    if (task) task->tlb_batch = batch;
+}
+
+// 立即失效已记录的范围（批处理继续），释放已解除映射的页面前调用
+void mmu_batch_flush(mmu_batch_t *batch) {
+    if (batch->end) {
+        tlb_flush_range(batch->start, batch->end, cur_asid());
+        batch->start = 0;
+        batch->end = 0;
+    }
+}
+
+// 结束TLB批处理
+void mmu_batch_end(mmu_batch_t *batch) {
+    task_t *task = task_get_current();
+
+    if (task && task->tlb_batch == batch) {
+        task->tlb_batch = batch->prev;
+    }
+    mmu_batch_flush(batch);
+}
+
+// 新一代开始：清空位图，保留各CPU正在使用的ASID，并要求各CPU在下次切换时失效本地TLB
+static void asid_rollover_locked(void) {
+    for (uint32_t i = 0; i < NUM_ASIDS / 32; i++) {
+        asid_map[i] = 0;
+    }
+    asid_map[0] = 1;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        uint32_t asid = __atomic_exchange_n(&active_asids[cpu], 0, __ATOMIC_RELAXED);
+
+        // 该CPU在上次回绕后未完成切换，沿用之前保留的ASID
+        if (asid == 0) asid = reserved_asids[cpu];
+
+        asid_map[(asid & ASID_MASK) / 32] |= 1u << (asid & 31);
+        reserved_asids[cpu] = asid;
+        tlb_flush_pending[cpu] = true;
+    }
+}
+
+// 回绕时仍在运行的上下文保留原ASID，只更新代数
+static bool asid_check_reserved_locked(uint32_t asid, uint32_t new_asid) {
+    bool hit = false;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (reserved_asids[cpu] == asid) {
+            reserved_asids[cpu] = new_asid;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+// 为过期的上下文标识分配本代ASID：优先沿用原ASID，位图耗尽时进入新一代
+static uint32_t asid_new_context_locked(uint32_t asid) {
+    if (asid != 0) {
+        uint32_t new_asid = asid_generation | (asid & ASID_MASK);
+
+        if (asid_check_reserved_locked(asid, new_asid)) {
+            return new_asid;
+        }
+
+        uint32_t index = asid & ASID_MASK;
+        if (!(asid_map[index / 32] & (1u << (index % 32)))) {
+            asid_map[index / 32] |= 1u << (index % 32);
+            return new_asid;
+        }
+    }
+
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint32_t n = 0; n < NUM_ASIDS; n++) {
+            uint32_t index = (asid_next + n) % NUM_ASIDS;
+            if (!(asid_map[index / 32] & (1u << (index % 32)))) {
+                asid_map[index / 32] |= 1u << (index % 32);
+                asid_next = index + 1;
+                return asid_generation | index;
+            }
+        }
+
+        asid_generation += ASID_FIRST_VERSION;
+        if (asid_generation == 0) asid_generation = ASID_FIRST_VERSION;
+        asid_rollover_locked();
+        asid_next = 1;
+    }
+
+    return 0;
+}
+
+// 释放地址空间的ASID，使所有核上带该ASID的TLB项失效，保证本代再次分配时没有残留
+void mmu_asid_free(uint32_t asid) {
+    if ((asid & ASID_MASK) == 0) return;
+
+    spinlock_lock(&asid_lock);
+    if (((asid ^ asid_generation) >> ASID_BITS) == 0) {
+        uint32_t index = asid & ASID_MASK;
+
+        __asm__ volatile ("dsb");
+        __asm__ volatile ("mcr p15, 0, %0, c8, c3, 2" : : "r" (index));
+        __asm__ volatile ("dsb\n" "isb");
+
+        asid_map[index / 32] &= ~(1u << (index % 32));
+    }
+    spinlock_unlock(&asid_lock);
+}
+
+// 写入TTBR1与CONTEXTIDR：先切到保留ASID 0再换页表，避免新ASID与旧页表短暂组合
+static void cpu_set_context(uint32_t *pgd, uint32_t asid) {
+    __asm__ volatile ("mcr p15, 0, %0, c13, c0, 1" : : "r" (0));
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mcr p15, 0, %0, c2, c0, 1" : : "r" (pgd));
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mcr p15, 0, %0, c13, c0, 1" : : "r" (asid & ASID_MASK));
+    __asm__ volatile ("isb");
+}
+
+// 切换用户地址空间（上下文切换时调用）。context指向地址空间的上下文标识，
+// 代数过期时在此重新分配；同代切换不失效TLB，pgd为NULL时切到内核页表
+void mmu_switch_mm(uint32_t *pgd, uint32_t *context) {
+    uint32_t cpu = smp_processor_id();
+
+    if (!pgd || !context) {
+        if (cpu_pgd[cpu]) {
+            cpu_set_context(first_level_table, 0);
+            cpu_pgd[cpu] = NULL;
+        }
+        return;
+    }
+
+    uint32_t asid = __atomic_load_n(context, __ATOMIC_RELAXED);
+
+    // 快速路径：本代ASID直接切换，与回绕并发时active_asids已被清零则走慢速路径
+    uint32_t old_active = __atomic_load_n(&active_asids[cpu], __ATOMIC_RELAXED);
+    if (asid && ((asid ^ asid_generation) >> ASID_BITS) == 0 && old_active &&
+        __atomic_compare_exchange_n(&active_asids[cpu], &old_active, asid, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        if (cpu_pgd[cpu] != pgd) {
+            cpu_set_context(pgd, asid);
+            cpu_pgd[cpu] = pgd;
+        }
+        return;
+    }
+
+    spinlock_lock(&asid_lock);
+
+    asid = *context;
+    if (!asid || ((asid ^ asid_generation) >> ASID_BITS) != 0) {
+        asid = asid_new_context_locked(asid);
+        __atomic_store_n(context, asid, __ATOMIC_RELAXED);
+    }
+
+    if (tlb_flush_pending[cpu]) {
+        tlb_flush_pending[cpu] = false;
+        __asm__ volatile ("mcr p15, 0, %0, c8, c7, 0" : : "r" (0));
+        __asm__ volatile ("dsb\n" "isb");
+    }
+
+    __atomic_store_n(&active_asids[cpu], asid, __ATOMIC_RELAXED);
+    spinlock_unlock(&asid_lock);
+
+    cpu_set_context(pgd, asid);
+    cpu_pgd[cpu] = pgd;
+}
+
+// 获取虚拟地址对应的软件页表项（记录存在位与交换槽），二级页表不存在时返回NULL
+pte_t *mmu_get_pte(uint32_t va) {
+    return mmu_pgd_get_pte(va_pgd(va), va);
+}
+
+// 虚拟地址转换为物理地址，未映射返回0
+uint32_t mmu_virt_to_phys(uint32_t va) {
+    uint32_t pde = va_pgd(va)[va >> 20];
+
+    if (pde_is_section(pde)) {
+        return section_phys(pde, va);
+    }
+
+    return mmu_pgd_virt_to_phys(va_pgd(va), va);
+}
+
+// 读取并清除指定页表中的访问标志，之后的首次访问将触发访问标志错误
+bool mmu_pgd_test_and_clear_accessed(uint32_t *pgd, uint32_t asid, uint32_t va) {
+    uint32_t *pte = pgd_lookup_pte(pgd, va);
+    if (!pte || !(*pte & PTE_AF)) return false;
+
+    pte_modify(pte, PTE_AF, 0, va, asid);
+    return true;
+}
+
+// 读取并清除当前页表中的访问标志
+bool mmu_test_and_clear_accessed(uint32_t va) {
+    return mmu_pgd_test_and_clear_accessed(va_pgd(va), cur_asid(), va);
+}
+
+// 设置访问标志（访问标志错误处理中调用）
+bool mmu_set_accessed(uint32_t va) {
+    uint32_t *pte = lookup_pte(va);
+    if (!pte) return false;
+
+    pte_modify(pte, 0, PTE_AF, va, cur_asid());
+    return true;
+}
+
+// 页面是否可写
+bool mmu_is_writable(uint32_t va) {
+    uint32_t *pte = lookup_pte(va);
+    return pte && !(*pte & PTE_AP_RO);
+}
+
+// 允许写入（干净页首次写入后调用）
+bool mmu_write_enable(uint32_t va) {
+    uint32_t *pte = lookup_pte(va);
+    if (!pte) return false;
+
+    pte_modify(pte, PTE_AP_RO, PTE_AF, va, cur_asid());
+    pte_shadow(pte)->flags.writable = 1;
+    return true;
+}
+
+// 写保护页面（页面写回变干净后调用，下次写入触发权限错误）
+bool mmu_write_protect(uint32_t va) {
+    uint32_t *pte = lookup_pte(va);
+    if (!pte) return false;
+
+    pte_modify(pte, 0, PTE_AP_RO, va, cur_asid());
+    pte_shadow(pte)->flags.writable = 0;
+    return true;
+}
+
+// 分配地址空间的一级页表：内核映射与内核页表共享，用户空间部分为空
+uint32_t *mmu_pgd_alloc(void) {
+    // 一级页表需16KB对齐，伙伴系统的4页块按块大小对齐
+    uint32_t *pgd = mm_alloc_pages(4);
+    if (!pgd) return NULL;
+
+    // 内核地址由TTBR0转换，用户页表只使用高2GB的表项
+    for (uint32_t i = 0; i < 4096; i++) {
+        pgd[i] = 0;
+    }
+
+    table_clean(pgd, 4096 * sizeof(uint32_t));
+    return pgd;
+}
+
+// 释放一级页表及其用户空间的二级页表（映射的页面由调用者先行释放）
+void mmu_pgd_free(uint32_t *pgd) {
+    if (!pgd) return;
+
+    // 退出的任务仍在使用该页表时先切回内核页表
+    if (cpu_pgd[smp_processor_id()] == pgd) {
+        mmu_switch_mm(NULL, NULL);
+    }
+
+    for (uint32_t i = USER_SPACE_BASE >> 20; i < (USER_SPACE_BASE + USER_SPACE_SIZE) >> 20; i++) {
+        if ((pgd[i] & PDE_TYPE_MASK) == PDE_TYPE_TABLE) {
+            mm_free_pages((void *)(pgd[i] & 0xFFFFFC00), 1);
+        }
+    }
+
+    mm_free_pages(pgd, 4);
+}
+
+// 将当前页表中va的映射复制到目标页表，wrprotect为true时两边都改为只读（写时复制）
+int mmu_pgd_copy_pte(uint32_t *dst_pgd, uint32_t va, bool wrprotect) {
+    uint32_t *src = lookup_pte(va);
+    if (!src) return -1;
+
+    uint32_t *table = pgd_l2_table(dst_pgd, va, 0);
+    if (!table) return -1;
+
+    if (wrprotect && !(*src & PTE_AP_RO)) {
+        pte_modify(src, 0, PTE_AP_RO, va, cur_asid());
+        pte_shadow(src)->flags.writable = 0;
+    }
+
+    uint32_t index = (va >> 12) & 0xFF;
+    table[index] = *src;
+    table_clean(&table[index], sizeof(uint32_t));
+
+    *pte_shadow(&table[index]) = *pte_shadow(src);
+    return 0;
+}
+
+// 在指定页表中转换虚拟地址，未映射返回0
+uint32_t mmu_pgd_virt_to_phys(uint32_t *pgd, uint32_t va) {
+    if (pde_is_section(pgd[va >> 20])) {
+        return section_phys(pgd[va >> 20], va);
+    }
+
+    uint32_t *pte = pgd_lookup_pte(pgd, va);
+    if (!pte) return 0;
+
+    if (pte_is_large(*pte)) {
+        return (*pte & 0xFFFF0000) | (va & 0xFFFF);
+    }
+    return (*pte & 0xFFFFF000) | (va & 0xFFF);
+}
+
+// 获取指定页表中的软件页表项，二级页表不存在时返回NULL
+pte_t *mmu_pgd_get_pte(uint32_t *pgd, uint32_t va) {
+    uint32_t pde = pgd[va >> 20];
+    if ((pde & PDE_TYPE_MASK) != PDE_TYPE_TABLE) return NULL;
+
+    pte_t *shadow = (pte_t *)((pde & 0xFFFFFC00) + L2_SHADOW_OFFSET);
+    return &shadow[(va >> 12) & 0xFF];
+}
@@ -1,36 +1,34 @@
 #include "mmu.h"
+#include "mm.h"
+#include "task.h"
 #include "uart.h"
 #include <stdint.h>
 
 // MMU 配置常量
-#define SECTION_SIZE               0x100000    // 1MB
 #define TOTAL_SECTIONS            4096        // 4GB/1MB
 #define PAGE_TABLE_BASE           0x70004000
 #define SECOND_LEVEL_TABLE_BASE   0x70008000
 
-// 内存区域定义
-#define PERIPH_BASE               0x10000000
-#define PERIPH_SIZE              (32 * SECTION_SIZE)  // 32MB
-#define RAM_BASE                  0x70000000
-#define RAM_SIZE                 (128 * SECTION_SIZE) // 128MB
-#define USER_SPACE_BASE          0x80000000
-#define USER_SPACE_SIZE          (256 * SECTION_SIZE) // 256MB
-
 // MMU 控制位
 #define MMU_SECTION              (0x2)        // Section descriptor
 #define MMU_CACHEABLE           (1 << 3)     // C bit
 #define MMU_BUFFERABLE         (1 << 2)     // B bit
+#define MMU_TEX0               (1 << 12)    // TEX[0] bit
 #define MMU_ACCESS_RW          (0x3 << 10)  // AP bits
 #define MMU_ACCESS_RO          (0x2 << 10)
 #define MMU_DOMAIN            (0x0 << 5)    // Domain 0
+#define MMU_SUPERSECTION       (1 << 18)    // Supersection (16MB, 16 repeated entries)
+#define SUPERSECTION_SIZE      (16 * SECTION_SIZE)
 
 // 页表条目类型
 typedef enum {
     UNMAPPED,           // 未映射
     STRONGLY_ORDERED,   // 强序访问（无缓存）
     DEVICE,            // 设备内存
-    NORMAL_CACHED,     // 普通内存（带缓存）
-    NORMAL_UNCACHED    // 普通内存（无缓存）
+    NORMAL_CACHED,     // 普通内存（写回写分配）
+    NORMAL_UNCACHED,   // 普通内存（无缓存，可写合并）
+    NORMAL_WRITE_THROUGH, // 普通内存（写通）
+    NORMAL_WRITE_COMBINE  // 普通内存（写合并，帧缓冲与流式写入的外设缓冲区）
 } memory_type_t;
 
 // 内存区域描述符
@@ -46,46 +44,67 @@ typedef struct {
 // 测试用的共享内存区域
 static volatile uint32_t *shared_memory = (volatile uint32_t *)0x80000000;
 
-// 创建页表条目
+// 创建页表条目：内存类型编码为TEX remap属性表索引（TEX[0]:C:B）
 static uint32_t create_section_entry(uint32_t physical_addr, memory_type_t type, uint8_t ap) {
     uint32_t entry = physical_addr & 0xFFF00000; // 基地址
+    uint32_t index;
+
     entry |= MMU_SECTION;                        // 段描述符
     entry |= MMU_DOMAIN;                         // 域
 
     switch (type) {
         case STRONGLY_ORDERED:
-            // 无缓存，无缓冲
+            index = MMU_ATTR_SO;
             break;
         case DEVICE:
-            entry |= MMU_BUFFERABLE;             // 只启用缓冲
+            index = MMU_ATTR_DEVICE;
             break;
         case NORMAL_CACHED:
-            entry |= MMU_CACHEABLE | MMU_BUFFERABLE; // 启用缓存和缓冲
+            index = MMU_ATTR_NORMAL_WB;
+            break;
+        case NORMAL_WRITE_THROUGH:
+            index = MMU_ATTR_NORMAL_WT;
             break;
         case NORMAL_UNCACHED:
-            // 无缓存，无缓冲
+        case NORMAL_WRITE_COMBINE:
+            index = MMU_ATTR_NORMAL_NC;
             break;
         default:
+            index = MMU_ATTR_SO;
             break;
     }
 
+    if (index & 1) entry |= MMU_BUFFERABLE;
+    if (index & 2) entry |= MMU_CACHEABLE;
+    if (index & 4) entry |= MMU_TEX0;
+
     entry |= (ap << 10);                        // 访问权限
     return entry;
 }
 
-// 配置内存区域
+// 配置内存区域：虚拟与物理地址都16MB对齐的部分使用超级段（一个TLB项覆盖16MB），其余使用1MB段
 static void configure_memory_region(const memory_region_t *region) {
     uint32_t *page_table = (uint32_t *)PAGE_TABLE_BASE;
-    uint32_t num_sections = region->size / SECTION_SIZE;
-    uint32_t virt_section = region->virtual_addr / SECTION_SIZE;
-    uint32_t phys_section = region->physical_addr / SECTION_SIZE;
-
-    for (uint32_t i = 0; i < num_sections; i++) {
-        page_table[virt_section + i] = create_section_entry(
-            (phys_section + i) * SECTION_SIZE,
-            region->type,
-            region->access_permissions
-        );
+    uint32_t va = region->virtual_addr;
+    uint32_t pa = region->physical_addr;
+    uint32_t end = region->virtual_addr + region->size;
+
+    while (va < end) {
+        if (!((va | pa) & (SUPERSECTION_SIZE - 1)) && end - va >= SUPERSECTION_SIZE) {
+            uint32_t entry = create_section_entry(pa & 0xFF000000, region->type,
+                                                  region->access_permissions) | MMU_SUPERSECTION;
+            for (uint32_t i = 0; i < 16; i++) {
+                page_table[va / SECTION_SIZE + i] = entry;
+            }
+            va += SUPERSECTION_SIZE;
+            pa += SUPERSECTION_SIZE;
+            continue;
+        }
+
+        page_table[va / SECTION_SIZE] = create_section_entry(pa, region->type,
+                                                             region->access_permissions);
+        va += SECTION_SIZE;
+        pa += SECTION_SIZE;
     }
 }
 
@@ -117,16 +136,8 @@ void mmu_init(void) {
             .type = NORMAL_CACHED,
             .access_permissions = MMU_ACCESS_RW,
             .executable = 1
-        },
-        // 用户空间 - 带缓存，只读
-        {
-            .virtual_addr = USER_SPACE_BASE,
-            .physical_addr = RAM_BASE + RAM_SIZE,
-            .size = USER_SPACE_SIZE,
-            .type = NORMAL_CACHED,
-            .access_permissions = MMU_ACCESS_RO,
-            .executable = 0
         }
+        // 用户空间不使用段映射，由各地址空间的二级页表按页建立
     };
 
     // 配置所有内存区域
@@ -134,6 +145,10 @@ void mmu_init(void) {
         configure_memory_region(&regions[i]);
     }
 
+    // TEX remap属性表（mmu_enable中开启SCTLR.TRE）
+    __asm__ volatile ("mcr p15, 0, %0, c10, c2, 0" : : "r" (MMU_PRRR));
+    __asm__ volatile ("mcr p15, 0, %0, c10, c2, 1" : : "r" (MMU_NMRR));
+
     // 设置域访问控制
     uint32_t dacr = 0x1; // 域0设置为客户端
     __asm__ volatile ("mcr p15, 0, %0, c3, c0, 0" : : "r" (dacr));
@@ -182,24 +197,6 @@ void test_memory_access(void) {
     *user_space = 0x11111111;  // 这里应该触发数据访问异常
 }
 
-// 缓存操作函数
-void cache_operations(void) {
-    // 清理数据缓存
-    __asm__ volatile ("mcr p15, 0, %0, c7, c10, 0" : : "r" (0));
-    
-    // 清理并使无效数据缓存
-    __asm__ volatile ("mcr p15, 0, %0, c7, c14, 0" : : "r" (0));
-    
-    // 使无效指令缓存
-    __asm__ volatile ("mcr p15, 0, %0, c7, c5, 0" : : "r" (0));
-    
-    // 数据同步屏障
-    __asm__ volatile ("dsb");
-    
-    // 指令同步屏障
-    __asm__ volatile ("isb");
-}
-
 // 异常处理函数
 void data_abort_handler(void) {
     uint32_t dfar, dfsr;
@@ -210,8 +207,35 @@ void data_abort_handler(void) {
     // 读取故障状态寄存器
     __asm__ volatile ("mrc p15, 0, %0, c5, c0, 0" : "=r" (dfsr));
 
+    // 短描述符格式：FS[4] 位于 DFSR[10]，WnR 位于 DFSR[11]
+    uint32_t status = (dfsr & 0xF) | ((dfsr >> 6) & 0x10);
+    uint32_t error_code = (dfsr & (1 << 11)) ? FAULT_WRITE : 0;
+
+    // 只有用户任务访问用户空间的错误交给缺页处理，内核地址或内核任务的错误按致命异常报告
+    task_t *task = task_get_current();
+    bool user_fault = dfar >= USER_SPACE_BASE && task && task->mm;
+
+    if (user_fault) {
+        switch (status) {
+            case 0x05:  // 段转换错误
+            case 0x07:  // 页转换错误
+                page_fault_handler(dfar, error_code);
+                return;
+            case 0x03:  // 段访问标志错误
+            case 0x06:  // 页访问标志错误
+                page_fault_handler(dfar, error_code | FAULT_PRESENT | FAULT_ACCESS_FLAG);
+                return;
+            case 0x0D:  // 段权限错误
+            case 0x0F:  // 页权限错误
+                page_fault_handler(dfar, error_code | FAULT_PRESENT | FAULT_PERMISSION);
+                return;
+            default:
+                break;
+        }
+    }
+
     uart_puts("Data Abort Exception!\r\n");
     uart_puts("Fault Address: ");
     // 这里应该添加一个函数来打印十六进制值
     uart_puts("\r\n");
-} 
\ No newline at end of file
+}
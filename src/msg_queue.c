@@ -1,177 +1,626 @@
 #include "ipc.h"
 #include "memory.h"
 #include "task.h"
+#include "mm.h"
+#include "timer.h"
 #include <string.h>
 
-// 全局消息队列链表
-static msg_queue_t *msg_queues = NULL;
-static mutex_t msg_queues_lock;
-static ipc_stats_t ipc_stats;
+// 截止时间队列中普通发送的消息排在所有有截止时间的消息之后
+#define MSGQ_NO_DEADLINE  0x7FFFFFFF
+
+// 消息队列句柄表
+static ipc_table_t msgq_table;
+static kmem_cache_t *msgq_cache;
 
 // 初始化消息队列系统
 void msgq_init(void) {
-    mutex_init(&msg_queues_lock, "msg_queues_lock");
-    memset(&ipc_stats, 0, sizeof(ipc_stats));
+    ipc_table_init(&msgq_table, IPC_MAX_MSGQ);
+    msgq_cache = kmem_cache_create("msg_queue", sizeof(msg_queue_t), 0, SLAB_HWCACHE_ALIGN, NULL);
+}
+
+// 按句柄查找消息队列并持有一个引用，用完后msgq_put
+static inline msg_queue_t *find_msg_queue(int mqid) {
+    return ipc_handle_get(&msgq_table, mqid);
+}
+
+// 释放消息队列的存储
+static void msgq_free(msg_queue_t *mq) {
+    free(mq->storage);
+    free(mq->type_storage);
+    free(mq->heap);
+    kmem_cache_free(msgq_cache, mq);
+}
+
+// 释放一个引用，最后一个引用（句柄已删除、没有进行中的操作和未释放的消息）释放队列
+static void msgq_put(msg_queue_t *mq) {
+    if (ipc_handle_put(mq)) {
+        msgq_free(mq);
+        ipc_stats.msg_queues--;
+    }
+}
+
+// 消息节点与msg_t互相转换
+static inline msg_t *node_msg(msg_node_t *node) {
+    return (msg_t *)(node + 1);
+}
+
+static inline msg_node_t *msg_node(msg_t *msg) {
+    return (msg_node_t *)msg - 1;
+}
+
+static inline uint32_t type_hash(long type) {
+    return (uint32_t)type % MSGQ_TYPE_BUCKETS;
+}
+
+// 查找类型子队列
+static msg_type_queue_t *type_queue_find(msg_queue_t *mq, long type) {
+    msg_type_queue_t *tq = mq->types[type_hash(type)];
+    while (tq && tq->type != type) {
+        tq = tq->next;
+    }
+    return tq;
+}
+
+// 查找或建立类型子队列；子队列数不超过消息块数，空闲链不会耗尽
+static msg_type_queue_t *type_queue_get(msg_queue_t *mq, long type) {
+    msg_type_queue_t *tq = type_queue_find(mq, type);
+    if (tq) return tq;
+
+    tq = mq->free_types;
+    mq->free_types = tq->next;
+
+    tq->type = type;
+    tq->head = NULL;
+    tq->tail = NULL;
+    tq->count = 0;
+    tq->next = mq->types[type_hash(type)];
+    mq->types[type_hash(type)] = tq;
+    return tq;
+}
+
+// 子队列为空时归还空闲链
+static void type_queue_put(msg_queue_t *mq, msg_type_queue_t *tq) {
+    msg_type_queue_t **link = &mq->types[type_hash(tq->type)];
+    while (*link != tq) {
+        link = &(*link)->next;
+    }
+    *link = tq->next;
+
+    tq->next = mq->free_types;
+    mq->free_types = tq;
+}
+
+// 截止时间先后比较（tick回绕安全），相同时按到达顺序
+static inline bool deadline_before(msg_node_t *a, msg_node_t *b) {
+    int32_t diff = (int32_t)(a->key - b->key);
+    if (diff) return diff < 0;
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static inline void heap_set(msg_queue_t *mq, uint32_t idx, msg_node_t *node) {
+    mq->heap[idx] = node;
+    node->heap_idx = idx;
+}
+
+static void heap_sift_up(msg_queue_t *mq, uint32_t idx) {
+    msg_node_t *node = mq->heap[idx];
+
+    while (idx > 0) {
+        uint32_t parent = (idx - 1) / 2;
+        if (!deadline_before(node, mq->heap[parent])) break;
+        heap_set(mq, idx, mq->heap[parent]);
+        idx = parent;
+    }
+    heap_set(mq, idx, node);
 }
 
-// 查找消息队列
-static msg_queue_t *find_msg_queue(key_t key) {
-    msg_queue_t *mq = msg_queues;
-    while (mq) {
-        if (mq->key == key) {
-            return mq;
+static void heap_sift_down(msg_queue_t *mq, uint32_t idx, uint32_t count) {
+    msg_node_t *node = mq->heap[idx];
+
+    for (;;) {
+        uint32_t child = idx * 2 + 1;
+        if (child >= count) break;
+        if (child + 1 < count && deadline_before(mq->heap[child + 1], mq->heap[child])) {
+            child++;
         }
-        mq = mq->next;
+        if (!deadline_before(mq->heap[child], node)) break;
+        heap_set(mq, idx, mq->heap[child]);
+        idx = child;
+    }
+    heap_set(mq, idx, node);
+}
+
+// 从堆中删除任意节点（按类型接收时不一定是堆顶），调用时msg_count尚未减少
+static void heap_remove(msg_queue_t *mq, msg_node_t *node) {
+    uint32_t last = mq->msg_count - 1;
+    uint32_t idx = node->heap_idx;
+
+    if (idx == last) return;
+
+    heap_set(mq, idx, mq->heap[last]);
+    if (idx > 0 && deadline_before(mq->heap[idx], mq->heap[(idx - 1) / 2])) {
+        heap_sift_up(mq, idx);
+    } else {
+        heap_sift_down(mq, idx, last);
     }
-    return NULL;
 }
 
-// 创建消息队列
+// 消息入队：按优先级追加到对应链表（或插入截止时间堆），并追加到类型子队列尾部
+static void msgq_enqueue(msg_queue_t *mq, msg_node_t *node) {
+    msg_type_queue_t *tq = type_queue_get(mq, node_msg(node)->type);
+
+    node->seq = mq->seq++;
+
+    if (mq->flags & MSGQ_DEADLINE) {
+        heap_set(mq, mq->msg_count, node);
+        heap_sift_up(mq, mq->msg_count);
+    } else {
+        uint32_t prio = node->key;
+
+        node->next = NULL;
+        node->prev = mq->tail[prio];
+        if (mq->tail[prio]) {
+            mq->tail[prio]->next = node;
+        } else {
+            mq->head[prio] = node;
+            mq->prio_map |= 1u << prio;
+        }
+        mq->tail[prio] = node;
+    }
+
+    node->tq = tq;
+    node->type_next = NULL;
+    node->type_prev = tq->tail;
+    if (tq->tail) {
+        tq->tail->type_next = node;
+    } else {
+        tq->head = node;
+    }
+    tq->tail = node;
+    tq->count++;
+
+    mq->msg_count++;
+}
+
+// 取出消息：type为0取最高优先级（或最早截止）的消息，否则取该类型子队列的队首
+static msg_node_t *msgq_dequeue(msg_queue_t *mq, long type) {
+    msg_node_t *node;
+
+    if (type != 0) {
+        msg_type_queue_t *tq = type_queue_find(mq, type);
+        node = tq ? tq->head : NULL;
+    } else if (mq->flags & MSGQ_DEADLINE) {
+        node = mq->msg_count ? mq->heap[0] : NULL;
+    } else {
+        node = mq->prio_map ? mq->head[31 - __builtin_clz(mq->prio_map)] : NULL;
+    }
+    if (!node) return NULL;
+
+    if (mq->flags & MSGQ_DEADLINE) {
+        heap_remove(mq, node);
+    } else {
+        uint32_t prio = node->key;
+
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            mq->head[prio] = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        } else {
+            mq->tail[prio] = node->prev;
+        }
+        if (!mq->head[prio]) {
+            mq->prio_map &= ~(1u << prio);
+        }
+    }
+
+    // 按优先级取出的消息不一定是其类型子队列的队首
+    msg_type_queue_t *tq = node->tq;
+    if (node->type_prev) {
+        node->type_prev->type_next = node->type_next;
+    } else {
+        tq->head = node->type_next;
+    }
+    if (node->type_next) {
+        node->type_next->type_prev = node->type_prev;
+    } else {
+        tq->tail = node->type_prev;
+    }
+    if (--tq->count == 0) {
+        type_queue_put(mq, tq);
+    }
+
+    mq->msg_count--;
+    return node;
+}
+
+// 符合类型的消息数
+static uint32_t msgq_count(msg_queue_t *mq, long type) {
+    if (type == 0) return mq->msg_count;
+
+    msg_type_queue_t *tq = type_queue_find(mq, type);
+    return tq ? tq->count : 0;
+}
+
+// 创建消息队列：预先划分max_msgs个消息块，收发过程中不再分配内存
 int msgq_create(key_t key, uint32_t max_msgs, uint32_t max_size) {
-    mutex_lock(&msg_queues_lock);
+    return msgq_create_ex(key, max_msgs, max_size, 0);
+}
 
-    // 检查是否已存在
-    if (find_msg_queue(key)) {
-        mutex_unlock(&msg_queues_lock);
+// 按标志创建消息队列，MSGQ_DEADLINE队列额外预分配截止时间堆；返回队列句柄
+int msgq_create_ex(key_t key, uint32_t max_msgs, uint32_t max_size, uint32_t flags) {
+    if (max_msgs == 0 || max_size < sizeof(msg_t)) {
+        return -1;
+    }
+
+    // 检查是否已存在（分配句柄时会再次检查）
+    if (ipc_handle_lookup(&msgq_table, key) >= 0) {
         return -1;
     }
 
     // 分配消息队列结构
-    msg_queue_t *mq = malloc(sizeof(msg_queue_t));
+    msg_queue_t *mq = kmem_cache_alloc(msgq_cache);
     if (!mq) {
-        mutex_unlock(&msg_queues_lock);
         return -1;
     }
+    memset(mq, 0, sizeof(msg_queue_t));
 
-    // 分配消息缓冲区
-    mq->buffer = malloc(max_msgs * max_size);
-    if (!mq->buffer) {
-        free(mq);
-        mutex_unlock(&msg_queues_lock);
+    // 分配消息块与类型子队列
+    uint32_t block_size = (sizeof(msg_node_t) + max_size + 7) & ~7;
+    uint32_t storage_size = max_msgs * block_size + 8;
+    mq->storage = malloc(storage_size);
+    mq->type_storage = malloc(max_msgs * sizeof(msg_type_queue_t));
+    if (flags & MSGQ_DEADLINE) {
+        mq->heap = malloc(max_msgs * sizeof(msg_node_t *));
+    }
+    if (!mq->storage || !mq->type_storage || ((flags & MSGQ_DEADLINE) && !mq->heap) ||
+        mempool_init(&mq->pool, "msgq_pool", mq->storage, storage_size, block_size) < 0) {
+        msgq_free(mq);
         return -1;
     }
 
+    for (uint32_t i = 0; i < max_msgs; i++) {
+        mq->type_storage[i].next = mq->free_types;
+        mq->free_types = &mq->type_storage[i];
+    }
+
     // 初始化消息队列
     mq->key = key;
+    mq->flags = flags;
     mq->max_msgs = max_msgs;
     mq->max_size = max_size;
-    mq->msg_count = 0;
-    mq->head = 0;
-    mq->tail = 0;
     mutex_init(&mq->lock, "msgq_lock");
-    condition_init(&mq->not_full, "msgq_not_full");
     condition_init(&mq->not_empty, "msgq_not_empty");
 
-    // 添加到链表
-    mq->next = msg_queues;
-    msg_queues = mq;
+    // 分配句柄，对象初始化完成后才可被查找到
+    mq->id = ipc_handle_alloc(&msgq_table, key, mq);
+    if (mq->id < 0) {
+        msgq_free(mq);
+        return -1;
+    }
     ipc_stats.msg_queues++;
 
-    mutex_unlock(&msg_queues_lock);
-    return 0;
+    return mq->id;
 }
 
-// 发送消息
-int msgq_send(int mqid, const msg_t *msg, uint32_t size, uint32_t timeout) {
+// 按键打开消息队列，返回句柄
+int msgq_open(key_t key) {
+    return ipc_handle_lookup(&msgq_table, key);
+}
+
+// 关闭消息队列：句柄全局有效，只校验句柄
+int msgq_close(int mqid) {
     msg_queue_t *mq = find_msg_queue(mqid);
     if (!mq) return -1;
 
+    msgq_put(mq);
+    return 0;
+}
+
+// 删除消息队列：句柄立即失效并唤醒等待的接收者；进行中的操作和未释放的消息
+// 各持有一个引用，全部结束后才释放队列
+int msgq_delete(int mqid) {
+    msg_queue_t *mq = ipc_handle_free(&msgq_table, mqid);
+    if (!mq) return -1;
+
+    // 丢弃尚未接收的消息，它们持有的引用在解锁后释放
+    uint32_t dropped = 0;
+    msg_node_t *node;
+
     mutex_lock(&mq->lock);
+    mq->deleted = true;
+    while ((node = msgq_dequeue(mq, 0))) {
+        mempool_free(&mq->pool, node);
+        dropped++;
+    }
+    condition_broadcast(&mq->not_empty);
+    mutex_unlock(&mq->lock);
 
-    // 等待直到队列非满
-    while (mq->msg_count >= mq->max_msgs) {
-        if (timeout == 0) {
-            mutex_unlock(&mq->lock);
-            return -1;
-        }
-        if (!condition_timedwait(&mq->not_full, &mq->lock, timeout)) {
-            mutex_unlock(&mq->lock);
-            return -1;
-        }
+    while (dropped--) {
+        msgq_put(mq);
     }
+    msgq_put(mq);
+    return 0;
+}
 
-    // 复制消息到缓冲区
-    uint32_t offset = mq->tail * mq->max_size;
-    memcpy(mq->buffer + offset, msg, size);
-    
-    // 更新队列状态
-    mq->tail = (mq->tail + 1) % mq->max_msgs;
-    mq->msg_count++;
+// 普通发送的排序键：优先级0；截止时间队列中为最晚的截止时间
+static inline uint32_t msgq_default_key(msg_queue_t *mq) {
+    if (mq->flags & MSGQ_DEADLINE) {
+        return timer_get_ticks() + MSGQ_NO_DEADLINE;
+    }
+    return 0;
+}
+
+// 分配消息节点，成功时节点持有调用者的队列引用
+static msg_node_t *msgq_node_alloc(msg_queue_t *mq, uint32_t size, uint32_t timeout) {
+    msg_node_t *node = mempool_alloc_wait(&mq->pool, timeout);
+    if (!node) return NULL;
+
+    node->len = size;
+    node->key = msgq_default_key(mq);
+    node->mq = mq;
+    return node;
+}
+
+// 分配消息（零拷贝发送）：块池为空时等待接收方释放，size为含msg_t头的总长度
+msg_t *msgq_alloc(int mqid, uint32_t size, uint32_t timeout) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return NULL;
+
+    msg_node_t *node = NULL;
+    if (size >= sizeof(msg_t) && size <= mq->max_size) {
+        node = msgq_node_alloc(mq, size, timeout);
+    }
+    if (!node) {
+        msgq_put(mq);
+        return NULL;
+    }
+    return node_msg(node);
+}
+
+// 投递消息（零拷贝发送）：只把指针挂入队列，所有权转给接收方
+int msgq_post(int mqid, msg_t *msg) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return -1;
+    if (!msg || msg_node(msg)->mq != mq) {
+        msgq_put(mq);
+        return -1;
+    }
+
+    mutex_lock(&mq->lock);
+
+    msgq_enqueue(mq, msg_node(msg));
     ipc_stats.msg_sends++;
 
-    // 通知等待的接收者
-    condition_signal(&mq->not_empty);
+    // 按类型等待的接收者各自检查，需全部唤醒
+    condition_broadcast(&mq->not_empty);
 
     mutex_unlock(&mq->lock);
+    msgq_put(mq);
     return 0;
 }
 
-// 接收消息
-int msgq_receive(int mqid, msg_t *msg, uint32_t size, long type, uint32_t timeout) {
+// 按优先级投递（零拷贝）
+int msgq_post_prio(int mqid, msg_t *msg, uint32_t prio) {
     msg_queue_t *mq = find_msg_queue(mqid);
     if (!mq) return -1;
 
+    bool valid = msg && ((mq->flags & MSGQ_DEADLINE) || prio < MSGQ_PRIO_LEVELS);
+    msgq_put(mq);
+    if (!valid) return -1;
+
+    msg_node(msg)->key = prio;
+    return msgq_post(mqid, msg);
+}
+
+// 接收消息（零拷贝）：返回队列中的消息指针，用完后调用msgq_release
+msg_t *msgq_receive_ref(int mqid, long type, uint32_t timeout) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return NULL;
+
+    uint32_t start = timer_get_ticks();
+
     mutex_lock(&mq->lock);
 
-    // 等待直到队列非空
-    while (mq->msg_count == 0) {
-        if (timeout == 0) {
-            mutex_unlock(&mq->lock);
-            return -1;
-        }
-        if (!condition_timedwait(&mq->not_empty, &mq->lock, timeout)) {
+    // 等待直到有符合类型的消息；被其他类型的消息唤醒时只等待剩余时间，队列删除时返回
+    msg_node_t *node;
+    while (!(node = msgq_dequeue(mq, type))) {
+        uint32_t elapsed = timer_get_ticks() - start;
+        if (elapsed >= timeout || mq->deleted) {
             mutex_unlock(&mq->lock);
-            return -1;
+            msgq_put(mq);
+            return NULL;
         }
+
+        condition_timedwait(&mq->not_empty, &mq->lock, timeout - elapsed);
     }
 
-    // 查找指定类型的消息
-    uint32_t current = mq->head;
-    uint32_t count = mq->msg_count;
-    bool found = false;
+    ipc_stats.msg_receives++;
 
-    while (count > 0) {
-        msg_t *current_msg = (msg_t *)(mq->buffer + current * mq->max_size);
-        if (type == 0 || current_msg->type == type) {
-            found = true;
-            break;
-        }
-        current = (current + 1) % mq->max_msgs;
-        count--;
+    mutex_unlock(&mq->lock);
+    msgq_put(mq);
+    return node_msg(node);
+}
+
+// 释放已接收（或分配后未投递）的消息，块池中等待的发送方被唤醒；
+// 通过消息所属的队列释放，队列已删除时随最后一条消息一起释放
+void msgq_release(int mqid, msg_t *msg) {
+    if (!msg) return;
+
+    msg_queue_t *mq = msg_node(msg)->mq;
+    if (mq->id != mqid) return;
+
+    mempool_free(&mq->pool, msg_node(msg));
+    msgq_put(mq);
+}
+
+// 发送消息（复制方式）：复制到队列的消息块后投递
+int msgq_send(int mqid, const msg_t *msg, uint32_t size, uint32_t timeout) {
+    msg_t *copy = msgq_alloc(mqid, size, timeout);
+    if (!copy) return -1;
+
+    memcpy(copy, msg, size);
+    if (msgq_post(mqid, copy) < 0) {
+        msgq_release(mqid, copy);
+        return -1;
     }
+    return 0;
+}
+
+// 按优先级发送（复制方式）
+int msgq_send_prio(int mqid, const msg_t *msg, uint32_t size, uint32_t prio, uint32_t timeout) {
+    msg_t *copy = msgq_alloc(mqid, size, timeout);
+    if (!copy) return -1;
 
-    if (!found) {
-        mutex_unlock(&mq->lock);
+    memcpy(copy, msg, size);
+    if (msgq_post_prio(mqid, copy, prio) < 0) {
+        msgq_release(mqid, copy);
         return -1;
     }
+    return 0;
+}
 
-    // 复制消息
-    uint32_t offset = current * mq->max_size;
-    memcpy(msg, mq->buffer + offset, size);
+// 接收消息（复制方式）
+int msgq_receive(int mqid, msg_t *msg, uint32_t size, long type, uint32_t timeout) {
+    msg_t *received = msgq_receive_ref(mqid, type, timeout);
+    if (!received) return -1;
 
-    // 更新队列状态
-    if (current == mq->head) {
-        mq->head = (mq->head + 1) % mq->max_msgs;
-    } else {
-        // 移动消息
-        uint32_t move_start = current;
-        uint32_t move_end = mq->head;
-        while (move_start != move_end) {
-            uint32_t prev = (move_start - 1 + mq->max_msgs) % mq->max_msgs;
-            memcpy(mq->buffer + move_start * mq->max_size,
-                   mq->buffer + prev * mq->max_size,
-                   mq->max_size);
-            move_start = prev;
+    uint32_t len = msg_node(received)->len;
+    memcpy(msg, received, size < len ? size : len);
+
+    msgq_release(mqid, received);
+    return 0;
+}
+
+// 批量投递（零拷贝）：一次持锁挂入全部消息，只广播一次
+int msgq_post_batch(int mqid, msg_t **msgs, uint32_t count) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return -1;
+    if (!msgs || count == 0) {
+        msgq_put(mq);
+        return msgs ? 0 : -1;
+    }
+
+    mutex_lock(&mq->lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        msgq_enqueue(mq, msg_node(msgs[i]));
+    }
+    ipc_stats.msg_sends += count;
+
+    condition_broadcast(&mq->not_empty);
+
+    mutex_unlock(&mq->lock);
+    msgq_put(mq);
+    return count;
+}
+
+// 批量发送（复制方式）：count条size字节的消息连续存放；块池不足时在超时内等待，
+// 超时后只投递已分配到块的部分
+int msgq_send_batch(int mqid, const void *msgs, uint32_t size, uint32_t count, uint32_t timeout) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return -1;
+    if (!msgs || size < sizeof(msg_t) || size > mq->max_size) {
+        msgq_put(mq);
+        return -1;
+    }
+
+    msg_t *batch[MSGQ_BATCH_MAX];
+    const uint8_t *src = msgs;
+    uint32_t start = timer_get_ticks();
+    uint32_t sent = 0;
+
+    // 按批次上限分段，每段一次持锁投递
+    while (sent < count) {
+        uint32_t n = 0;
+        uint32_t want = count - sent;
+        if (want > MSGQ_BATCH_MAX) want = MSGQ_BATCH_MAX;
+
+        while (n < want) {
+            uint32_t elapsed = timer_get_ticks() - start;
+            uint32_t remain = elapsed < timeout ? timeout - elapsed : 0;
+
+            // 每条消息各持有一个队列引用，由接收方msgq_release释放
+            __atomic_add_fetch(&mq->obj.refs, 1, __ATOMIC_RELAXED);
+            msg_node_t *node = msgq_node_alloc(mq, size, remain);
+            if (!node) {
+                msgq_put(mq);
+                break;
+            }
+
+            batch[n] = node_msg(node);
+            memcpy(batch[n], src + (sent + n) * size, size);
+            n++;
         }
-        mq->head = (mq->head + 1) % mq->max_msgs;
+
+        if (n && msgq_post_batch(mqid, batch, n) < 0) {
+            // 队列已删除，交还未投递的消息
+            for (uint32_t i = 0; i < n; i++) {
+                msgq_release(mqid, batch[i]);
+            }
+            break;
+        }
+        sent += n;
+        if (n < want) break;
     }
 
-    mq->msg_count--;
-    ipc_stats.msg_receives++;
+    msgq_put(mq);
+    return sent ? (int)sent : -1;
+}
+
+// 批量接收（零拷贝）：等待至少min_count条符合类型的消息，一次持锁最多取出max_count条
+int msgq_receive_ref_batch(int mqid, msg_t **msgs, uint32_t max_count, uint32_t min_count,
+                           long type, uint32_t timeout) {
+    msg_queue_t *mq = find_msg_queue(mqid);
+    if (!mq) return -1;
+    if (!msgs || max_count == 0) {
+        msgq_put(mq);
+        return -1;
+    }
+    if (min_count == 0) min_count = 1;
+    if (min_count > max_count) min_count = max_count;
+
+    uint32_t start = timer_get_ticks();
+
+    mutex_lock(&mq->lock);
 
-    // 通知等待的发送者
-    condition_signal(&mq->not_full);
+    // 攒够min_count条再返回，超时或队列删除时取已有的
+    while (msgq_count(mq, type) < min_count && !mq->deleted) {
+        uint32_t elapsed = timer_get_ticks() - start;
+        if (elapsed >= timeout) break;
+
+        condition_timedwait(&mq->not_empty, &mq->lock, timeout - elapsed);
+    }
+
+    uint32_t n = 0;
+    msg_node_t *node;
+    while (n < max_count && (node = msgq_dequeue(mq, type))) {
+        msgs[n++] = node_msg(node);
+    }
+    ipc_stats.msg_receives += n;
 
     mutex_unlock(&mq->lock);
-    return 0;
-} 
\ No newline at end of file
+    msgq_put(mq);
+    return n ? (int)n : -1;
+}
+
+// 批量接收（复制方式）：消息按size间隔复制到msgs，持锁期间只摘链，复制在锁外进行
+int msgq_receive_batch(int mqid, void *msgs, uint32_t size, uint32_t max_count, uint32_t min_count,
+                       long type, uint32_t timeout) {
+    msg_t *batch[MSGQ_BATCH_MAX];
+    uint8_t *dst = msgs;
+
+    if (!msgs) return -1;
+    if (max_count > MSGQ_BATCH_MAX) max_count = MSGQ_BATCH_MAX;
+
+    int n = msgq_receive_ref_batch(mqid, batch, max_count, min_count, type, timeout);
+    for (int i = 0; i < n; i++) {
+        uint32_t len = msg_node(batch[i])->len;
+        memcpy(dst + i * size, batch[i], size < len ? size : len);
+        msgq_release(mqid, batch[i]);
+    }
+
+    return n;
+}
@@ -1,75 +1,300 @@
 #include "ipc.h"
 #include "memory.h"
+#include "mm.h"
+#include "fs.h"
+#include "lwip/sockets.h"
 #include <string.h>
 
-#define PIPE_BUF_SIZE 4096
+#define PIPE_DEF_SIZE  (16 * PAGE_SIZE)   // 默认容量
+#define PIPE_MAX_SIZE  (256 * PAGE_SIZE)  // 最大容量
 
-// 全局管道链表
-static pipe_t *pipes = NULL;
-static mutex_t pipes_lock;
+// 管道句柄表，每个管道的读端、写端各占一个句柄
+static ipc_table_t pipe_table;
+static kmem_cache_t *pipe_cache;
 
 // 初始化管道系统
 void pipe_init(void) {
-    mutex_init(&pipes_lock, "pipes_lock");
+    ipc_table_init(&pipe_table, IPC_MAX_PIPE_FDS);
+    pipe_cache = kmem_cache_create("pipe", sizeof(pipe_t), 0, SLAB_HWCACHE_ALIGN, NULL);
+}
+
+static void pipe_destroy(pipe_t *pipe);
+
+// 按句柄查找管道（任一端）并持有一个引用，用完后pipe_put
+static inline pipe_t *find_pipe_by_fd(int fd) {
+    return ipc_handle_get(&pipe_table, fd);
+}
+
+// 释放一个引用，最后一个引用（两端句柄都已关闭且没有进行中的操作）释放管道
+static inline void pipe_put(pipe_t *pipe) {
+    if (ipc_handle_put(pipe)) {
+        pipe_destroy(pipe);
+    }
+}
+
+// 按句柄查找管道，句柄须为读端
+static inline pipe_t *pipe_reader(int fd) {
+    pipe_t *pipe = find_pipe_by_fd(fd);
+    if (pipe && pipe->read_fd != fd) {
+        pipe_put(pipe);
+        return NULL;
+    }
+    return pipe;
+}
+
+// 按句柄查找管道，句柄须为写端
+static inline pipe_t *pipe_writer(int fd) {
+    pipe_t *pipe = find_pipe_by_fd(fd);
+    if (pipe && pipe->write_fd != fd) {
+        pipe_put(pipe);
+        return NULL;
+    }
+    return pipe;
+}
+
+static inline pipe_buf_t *pipe_slot(pipe_t *pipe, uint32_t idx) {
+    return &pipe->bufs[idx & (pipe->nr_bufs - 1)];
+}
+
+static inline bool pipe_full(pipe_t *pipe) {
+    return pipe->head - pipe->tail >= pipe->nr_bufs;
+}
+
+static inline bool pipe_empty(pipe_t *pipe) {
+    return pipe->head == pipe->tail;
+}
+
+// 容量换算为槽数：按页向上取整到2的幂，超过最大容量返回0
+static uint32_t pipe_size_to_bufs(uint32_t size) {
+    if (size > PIPE_MAX_SIZE) return 0;
+
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t nr = 1;
+    while (nr < pages) nr <<= 1;
+    return nr;
+}
+
+// 分配匿名页，优先使用留用页
+static uint8_t *pipe_page_alloc(pipe_t *pipe) {
+    uint8_t *page = pipe->spare;
+    if (page) {
+        pipe->spare = NULL;
+        return page;
+    }
+    return mm_alloc_pages(1);
+}
+
+// 释放已读完的缓冲区：匿名页留一页备用，文件页解除固定，调用者缓冲区交还
+static void pipe_buf_release(pipe_t *pipe, pipe_buf_t *buf) {
+    switch (buf->type) {
+        case PIPE_BUF_ANON:
+            if (!pipe->spare) {
+                pipe->spare = buf->page;
+            } else {
+                mm_free_pages(buf->page, 1);
+            }
+            break;
+        case PIPE_BUF_FILE:
+            fs_put_page(buf->file.ino, buf->file.pgoff);
+            break;
+        case PIPE_BUF_USER:
+            if (buf->user.release) buf->user.release(buf->page, buf->user.arg);
+            break;
+    }
+}
+
+// 等待空闲槽，阻塞前先唤醒读者；任一端已关闭返回-1
+static int pipe_wait_writable(pipe_t *pipe) {
+    while (pipe_full(pipe)) {
+        if (pipe->reader_closed || pipe->writer_closed) return -1;
+        condition_signal(&pipe->not_empty);
+        condition_wait(&pipe->not_full, &pipe->lock);
+    }
+    return 0;
+}
+
+// 等待数据，阻塞前先唤醒写者；无数据且任一端已关闭返回-1
+static int pipe_wait_readable(pipe_t *pipe) {
+    while (pipe_empty(pipe)) {
+        if (pipe->writer_closed || pipe->reader_closed) return -1;
+        condition_signal(&pipe->not_full);
+        condition_wait(&pipe->not_empty, &pipe->lock);
+    }
+    return 0;
+}
+
+// 消费读取槽中的n字节，读完的槽被释放
+static void pipe_consume(pipe_t *pipe, pipe_buf_t *buf, uint32_t n) {
+    buf->offset += n;
+    buf->len -= n;
+    pipe->count -= n;
+
+    if (buf->len == 0) {
+        pipe_buf_release(pipe, buf);
+        pipe->tail++;
+    }
+}
+
+// 释放管道：丢弃剩余数据，释放缓冲区与管道结构
+static void pipe_destroy(pipe_t *pipe) {
+    while (!pipe_empty(pipe)) {
+        pipe_buf_t *buf = pipe_slot(pipe, pipe->tail);
+        pipe_consume(pipe, buf, buf->len);
+    }
+
+    if (pipe->spare) mm_free_pages(pipe->spare, 1);
+    free(pipe->bufs);
+    kmem_cache_free(pipe_cache, pipe);
+    ipc_stats.pipes--;
 }
 
 // 创建管道
 int pipe_create(int pipefd[2]) {
-    mutex_lock(&pipes_lock);
+    return pipe_create_size(pipefd, PIPE_DEF_SIZE);
+}
+
+// 创建指定容量的管道，缓冲页在写入时按需分配
+int pipe_create_size(int pipefd[2], uint32_t size) {
+    uint32_t nr_bufs = pipe_size_to_bufs(size);
+    if (!nr_bufs) return -1;
 
     // 分配管道结构
-    pipe_t *pipe = malloc(sizeof(pipe_t));
+    pipe_t *pipe = kmem_cache_alloc(pipe_cache);
     if (!pipe) {
-        mutex_unlock(&pipes_lock);
         return -1;
     }
 
-    // 分配缓冲区
-    pipe->buffer = malloc(PIPE_BUF_SIZE);
-    if (!pipe->buffer) {
-        free(pipe);
-        mutex_unlock(&pipes_lock);
+    // 分配缓冲区槽
+    pipe->bufs = malloc(nr_bufs * sizeof(pipe_buf_t));
+    if (!pipe->bufs) {
+        kmem_cache_free(pipe_cache, pipe);
         return -1;
     }
 
     // 初始化管道
-    pipe->size = PIPE_BUF_SIZE;
-    pipe->read_pos = 0;
-    pipe->write_pos = 0;
+    pipe->obj.refs = 0;
+    pipe->nr_bufs = nr_bufs;
+    pipe->size = nr_bufs * PAGE_SIZE;
+    pipe->head = 0;
+    pipe->tail = 0;
     pipe->count = 0;
+    pipe->spare = NULL;
     mutex_init(&pipe->lock, "pipe_lock");
     condition_init(&pipe->not_full, "pipe_not_full");
     condition_init(&pipe->not_empty, "pipe_not_empty");
     pipe->reader_closed = false;
     pipe->writer_closed = false;
 
-    // 分配文件描述符
-    int read_fd = fd_alloc();
-    int write_fd = fd_alloc();
-    if (read_fd < 0 || write_fd < 0) {
-        free(pipe->buffer);
-        free(pipe);
-        mutex_unlock(&pipes_lock);
+    // 分配读端、写端句柄
+    pipe->read_fd = -1;
+    pipe->write_fd = -1;
+    pipe->read_fd = ipc_handle_alloc(&pipe_table, IPC_PRIVATE, pipe);
+    if (pipe->read_fd >= 0) {
+        pipe->write_fd = ipc_handle_alloc(&pipe_table, IPC_PRIVATE, pipe);
+    }
+    if (pipe->write_fd < 0) {
+        if (pipe->read_fd >= 0) ipc_handle_free(&pipe_table, pipe->read_fd);
+        free(pipe->bufs);
+        kmem_cache_free(pipe_cache, pipe);
         return -1;
     }
 
     // 设置文件描述符
-    pipefd[0] = read_fd;
-    pipefd[1] = write_fd;
-
-    // 添加到链表
-    pipe->next = pipes;
-    pipes = pipe;
+    pipefd[0] = pipe->read_fd;
+    pipefd[1] = pipe->write_fd;
     ipc_stats.pipes++;
 
-    mutex_unlock(&pipes_lock);
     return 0;
 }
 
-// 写入管道
-int pipe_write(int fd, const void *buf, uint32_t count) {
+// 关闭管道一端：句柄立即失效并唤醒两端的等待者；阻塞在该管道上的任务各持有一个引用，
+// 两端都关闭且这些任务全部返回后才释放缓冲区与管道
+int pipe_close(int fd) {
+    pipe_t *pipe = find_pipe_by_fd(fd);
+    if (!pipe) return -1;
+
+    mutex_lock(&pipe->lock);
+
+    if (fd == pipe->read_fd) {
+        pipe->reader_closed = true;
+        pipe->read_fd = -1;
+    } else if (fd == pipe->write_fd) {
+        pipe->writer_closed = true;
+        pipe->write_fd = -1;
+    } else {
+        mutex_unlock(&pipe->lock);
+        pipe_put(pipe);
+        return -1;
+    }
+
+    // 句柄的引用转交到这里，本次操作的引用仍在，不会是最后一个
+    if (ipc_handle_free(&pipe_table, fd)) {
+        ipc_handle_put(pipe);
+    }
+
+    condition_broadcast(&pipe->not_full);
+    condition_broadcast(&pipe->not_empty);
+
+    mutex_unlock(&pipe->lock);
+    pipe_put(pipe);
+    return 0;
+}
+
+// 调整管道容量，已有数据按顺序搬到新的槽环，返回新容量
+int pipe_set_size(int fd, uint32_t size) {
     pipe_t *pipe = find_pipe_by_fd(fd);
-    if (!pipe || pipe->writer_closed) return -1;
+    if (!pipe) return -1;
+
+    uint32_t nr_bufs = pipe_size_to_bufs(size);
+    if (!nr_bufs) {
+        pipe_put(pipe);
+        return -1;
+    }
+
+    mutex_lock(&pipe->lock);
+
+    uint32_t used = pipe->head - pipe->tail;
+    pipe_buf_t *bufs = used <= nr_bufs ? malloc(nr_bufs * sizeof(pipe_buf_t)) : NULL;
+    if (!bufs) {
+        mutex_unlock(&pipe->lock);
+        pipe_put(pipe);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < used; i++) {
+        bufs[i] = *pipe_slot(pipe, pipe->tail + i);
+    }
+    free(pipe->bufs);
+
+    pipe->bufs = bufs;
+    pipe->nr_bufs = nr_bufs;
+    pipe->size = nr_bufs * PAGE_SIZE;
+    pipe->tail = 0;
+    pipe->head = used;
+
+    // 扩容后可能有多个写者可以继续
+    condition_broadcast(&pipe->not_full);
+
+    int new_size = pipe->size;
+    mutex_unlock(&pipe->lock);
+    pipe_put(pipe);
+    return new_size;
+}
+
+// 获取管道容量
+int pipe_get_size(int fd) {
+    pipe_t *pipe = find_pipe_by_fd(fd);
+    if (!pipe) return -1;
+
+    int size = pipe->size;
+    pipe_put(pipe);
+    return size;
+}
+
+// 写入管道：先追加到末尾匿名页的剩余空间，再按页分配新槽；写完后唤醒读者一次
+int pipe_write(int fd, const void *buf, uint32_t count) {
+    pipe_t *pipe = pipe_writer(fd);
+    if (!pipe) return -1;
 
     mutex_lock(&pipe->lock);
 
@@ -77,48 +302,55 @@ int pipe_write(int fd, const void *buf, uint32_t count) {
     const uint8_t *src = buf;
 
     while (written < count) {
-        // 等待直到有空间可写
-        while (pipe->count == pipe->size) {
-            if (pipe->reader_closed) {
+        pipe_buf_t *last = pipe_empty(pipe) ? NULL : pipe_slot(pipe, pipe->head - 1);
+        uint32_t chunk;
+
+        if (last && last->type == PIPE_BUF_ANON && last->offset + last->len < PAGE_SIZE) {
+            chunk = PAGE_SIZE - (last->offset + last->len);
+            if (chunk > count - written) chunk = count - written;
+            memcpy(last->page + last->offset + last->len, src + written, chunk);
+            last->len += chunk;
+        } else {
+            // 等待直到有空闲槽
+            if (pipe_wait_writable(pipe) < 0) {
                 mutex_unlock(&pipe->lock);
+                pipe_put(pipe);
                 return -1;
             }
-            condition_wait(&pipe->not_full, &pipe->lock);
-        }
 
-        // 计算可写入的数量
-        uint32_t space = pipe->size - pipe->count;
-        uint32_t to_write = count - written;
-        if (to_write > space) to_write = space;
-
-        // 写入数据
-        uint32_t first_part = pipe->size - pipe->write_pos;
-        if (to_write <= first_part) {
-            memcpy(pipe->buffer + pipe->write_pos, src + written, to_write);
-            pipe->write_pos += to_write;
-            if (pipe->write_pos == pipe->size) pipe->write_pos = 0;
-        } else {
-            memcpy(pipe->buffer + pipe->write_pos, src + written, first_part);
-            memcpy(pipe->buffer, src + written + first_part, to_write - first_part);
-            pipe->write_pos = to_write - first_part;
-        }
+            uint8_t *page = pipe_page_alloc(pipe);
+            if (!page) break;
 
-        pipe->count += to_write;
-        written += to_write;
-        ipc_stats.pipe_writes++;
+            chunk = count - written;
+            if (chunk > PAGE_SIZE) chunk = PAGE_SIZE;
+            memcpy(page, src + written, chunk);
 
-        // 通知等待的读者
-        condition_signal(&pipe->not_empty);
+            pipe_buf_t *slot = pipe_slot(pipe, pipe->head);
+            slot->type = PIPE_BUF_ANON;
+            slot->page = page;
+            slot->offset = 0;
+            slot->len = chunk;
+            pipe->head++;
+        }
+
+        pipe->count += chunk;
+        written += chunk;
     }
 
+    ipc_stats.pipe_writes++;
+
+    // 通知等待的读者
+    condition_signal(&pipe->not_empty);
+
     mutex_unlock(&pipe->lock);
-    return written;
+    pipe_put(pipe);
+    return written ? (int)written : -1;
 }
 
-// 从管道读取
+// 从管道读取：按槽复制，读完的页立即释放；读完后唤醒写者一次
 int pipe_read(int fd, void *buf, uint32_t count) {
-    pipe_t *pipe = find_pipe_by_fd(fd);
-    if (!pipe || pipe->reader_closed) return -1;
+    pipe_t *pipe = pipe_reader(fd);
+    if (!pipe) return -1;
 
     mutex_lock(&pipe->lock);
 
@@ -126,44 +358,212 @@ int pipe_read(int fd, void *buf, uint32_t count) {
     uint8_t *dst = buf;
 
     while (read < count) {
-        // 等待直到有数据可读
-        while (pipe->count == 0) {
-            if (pipe->writer_closed) {
-                if (read > 0) {
-                    mutex_unlock(&pipe->lock);
-                    return read;
-                }
-                mutex_unlock(&pipe->lock);
-                return 0;
+        // 等待直到有数据可读，写端关闭时返回已读取的部分
+        if (pipe_wait_readable(pipe) < 0) break;
+
+        pipe_buf_t *slot = pipe_slot(pipe, pipe->tail);
+        uint32_t chunk = slot->len;
+        if (chunk > count - read) chunk = count - read;
+
+        memcpy(dst + read, slot->page + slot->offset, chunk);
+        pipe_consume(pipe, slot, chunk);
+        read += chunk;
+    }
+
+    ipc_stats.pipe_reads++;
+
+    // 通知等待的写者
+    condition_signal(&pipe->not_full);
+
+    mutex_unlock(&pipe->lock);
+    pipe_put(pipe);
+    return read;
+}
+
+// 将调用者的缓冲区挂入管道（不复制），读完后调用release交还；缓冲区在此之前不得修改
+int pipe_vmsplice(int fd, void *buf, uint32_t len, void (*release)(void *buf, void *arg), void *arg) {
+    if (!buf) return -1;
+    if (len == 0) return 0;
+
+    pipe_t *pipe = pipe_writer(fd);
+    if (!pipe) return -1;
+
+    mutex_lock(&pipe->lock);
+
+    if (pipe_wait_writable(pipe) < 0) {
+        mutex_unlock(&pipe->lock);
+        pipe_put(pipe);
+        return -1;
+    }
+
+    pipe_buf_t *slot = pipe_slot(pipe, pipe->head);
+    slot->type = PIPE_BUF_USER;
+    slot->page = buf;
+    slot->offset = 0;
+    slot->len = len;
+    slot->user.release = release;
+    slot->user.arg = arg;
+    pipe->head++;
+    pipe->count += len;
+    ipc_stats.pipe_writes++;
+
+    condition_signal(&pipe->not_empty);
+
+    mutex_unlock(&pipe->lock);
+    pipe_put(pipe);
+    return len;
+}
+
+// 从文件拼接到管道：固定文件页缓存并按页挂入管道，不复制数据；
+// offset为文件偏移，完成后前移。管道中的文件页在读出前被改写时，读者看到的是新内容
+int pipe_splice_from_file(int fd_in, uint32_t *offset, int pipe_fd, uint32_t len) {
+    uint32_t ino;
+    if (!offset || fs_get_inode(fd_in, &ino) < 0) return -1;
+
+    uint32_t file_size = fs_file_size(ino);
+    if (*offset >= file_size) return 0;
+    if (len > file_size - *offset) len = file_size - *offset;
+
+    pipe_t *pipe = pipe_writer(pipe_fd);
+    if (!pipe) return -1;
+
+    mutex_lock(&pipe->lock);
+
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = *offset + done;
+        uint32_t pgoff = pos / PAGE_SIZE;
+        uint32_t in_page = pos % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > len - done) chunk = len - done;
+
+        if (pipe_wait_writable(pipe) < 0) break;
+
+        uint8_t *page = fs_get_page(ino, pgoff);
+        if (!page) break;
+
+        pipe_buf_t *slot = pipe_slot(pipe, pipe->head);
+        slot->type = PIPE_BUF_FILE;
+        slot->page = page;
+        slot->offset = in_page;
+        slot->len = chunk;
+        slot->file.ino = ino;
+        slot->file.pgoff = pgoff;
+        pipe->head++;
+        pipe->count += chunk;
+        done += chunk;
+    }
+
+    if (done) {
+        ipc_stats.pipe_writes++;
+        condition_signal(&pipe->not_empty);
+    }
+
+    mutex_unlock(&pipe->lock);
+    pipe_put(pipe);
+
+    *offset += done;
+    return done ? (int)done : -1;
+}
+
+// 从套接字拼接到管道：直接接收到管道页，不经过中间缓冲区；
+// 接收在锁外进行，套接字阻塞期间读者仍可取走已有数据
+int pipe_splice_from_socket(int sock, int pipe_fd, uint32_t len) {
+    pipe_t *pipe = pipe_writer(pipe_fd);
+    if (!pipe) return -1;
+
+    uint32_t done = 0;
+    while (done < len) {
+        mutex_lock(&pipe->lock);
+        uint8_t *page = pipe_page_alloc(pipe);
+        mutex_unlock(&pipe->lock);
+        if (!page) break;
+
+        uint32_t want = len - done;
+        if (want > PAGE_SIZE) want = PAGE_SIZE;
+
+        // 首次阻塞接收，之后只取套接字中已有的数据
+        int n = lwip_recv(sock, page, want, done ? MSG_DONTWAIT : 0);
+
+        mutex_lock(&pipe->lock);
+        if (n <= 0 || pipe_wait_writable(pipe) < 0) {
+            if (!pipe->spare) {
+                pipe->spare = page;
+            } else {
+                mm_free_pages(page, 1);
             }
-            condition_wait(&pipe->not_empty, &pipe->lock);
+            mutex_unlock(&pipe->lock);
+            break;
         }
 
-        // 计算可读取的数量
-        uint32_t available = pipe->count;
-        uint32_t to_read = count - read;
-        if (to_read > available) to_read = available;
-
-        // 读取数据
-        uint32_t first_part = pipe->size - pipe->read_pos;
-        if (to_read <= first_part) {
-            memcpy(dst + read, pipe->buffer + pipe->read_pos, to_read);
-            pipe->read_pos += to_read;
-            if (pipe->read_pos == pipe->size) pipe->read_pos = 0;
-        } else {
-            memcpy(dst + read, pipe->buffer + pipe->read_pos, first_part);
-            memcpy(dst + read + first_part, pipe->buffer, to_read - first_part);
-            pipe->read_pos = to_read - first_part;
+        pipe_buf_t *slot = pipe_slot(pipe, pipe->head);
+        slot->type = PIPE_BUF_ANON;
+        slot->page = page;
+        slot->offset = 0;
+        slot->len = n;
+        pipe->head++;
+        pipe->count += n;
+        ipc_stats.pipe_writes++;
+
+        condition_signal(&pipe->not_empty);
+        mutex_unlock(&pipe->lock);
+
+        done += n;
+        if ((uint32_t)n < want) break;
+    }
+
+    pipe_put(pipe);
+    return done ? (int)done : -1;
+}
+
+// 从管道拼接到输出：直接从管道页写出，不复制到中间缓冲区；至少等到有数据，之后只取已有的数据
+static int pipe_splice_out(int pipe_fd, uint32_t len, int (*sink)(int fd, const void *buf, uint32_t count),
+                           int fd_out) {
+    pipe_t *pipe = pipe_reader(pipe_fd);
+    if (!pipe) return -1;
+
+    mutex_lock(&pipe->lock);
+
+    uint32_t done = 0;
+    int err = 0;
+    while (done < len) {
+        if (done ? pipe_empty(pipe) : pipe_wait_readable(pipe) < 0) break;
+
+        pipe_buf_t *slot = pipe_slot(pipe, pipe->tail);
+        uint32_t chunk = slot->len;
+        if (chunk > len - done) chunk = len - done;
+
+        int n = sink(fd_out, slot->page + slot->offset, chunk);
+        if (n <= 0) {
+            err = -1;
+            break;
         }
 
-        pipe->count -= to_read;
-        read += to_read;
-        ipc_stats.pipe_reads++;
+        pipe_consume(pipe, slot, n);
+        done += n;
+        if ((uint32_t)n < chunk) break;
+    }
 
-        // 通知等待的写者
+    if (done) {
+        ipc_stats.pipe_reads++;
         condition_signal(&pipe->not_full);
     }
 
     mutex_unlock(&pipe->lock);
-    return read;
-} 
\ No newline at end of file
+    pipe_put(pipe);
+    return done ? (int)done : err;
+}
+
+static int socket_sink(int sock, const void *buf, uint32_t count) {
+    return lwip_send(sock, buf, count, 0);
+}
+
+// 从管道拼接到文件
+int pipe_splice_to_file(int pipe_fd, int fd_out, uint32_t len) {
+    return pipe_splice_out(pipe_fd, len, fs_write, fd_out);
+}
+
+// 从管道拼接到套接字
+int pipe_splice_to_socket(int pipe_fd, int sock, uint32_t len) {
+    return pipe_splice_out(pipe_fd, len, socket_sink, sock);
+}
@@ -0,0 +1,308 @@
+#include "ipc.h"
+#include "sync.h"
+#include "timer.h"
+#include <string.h>
+
+/*
+ * 无锁环形队列：索引为单调递增的32位计数，取模用mask，回绕由无符号减法处理。
+ * SPSC只有生产者写tail、消费者写head，入队/出队无等待；
+ * MPMC采用Vyukov有界队列，槽位序号等于位置时可写，等于位置+1时可读，
+ * 读出后序号推进一圈（位置+容量）供下一轮写入。
+ * 阻塞接口：等待者计数 + 计数信号量。等待方先登记再重试，发布方发布后看到等待者才释放信号量，
+ * 两侧屏障配对保证不会两边都错过；信号量计数只作提示，等待者醒来后总是重新检查队列。
+ * semaphore_post只关中断、不取睡眠锁，中断中的生产者可以直接唤醒阻塞在_wait中的消费者。
+ */
+
+typedef uint32_t (*ring_op_t)(void *ring, void *elems, uint32_t n);
+
+static void ring_waitq_init(ring_waitq_t *wq, const char *name) {
+    wq->waiters = 0;
+    semaphore_init(&wq->sem, 0, name);
+}
+
+// 发布后唤醒等待者；屏障保证索引的写入先于等待者计数的读取，与等待方的屏障配对
+static inline void ring_wake(ring_waitq_t *wq) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&wq->waiters, __ATOMIC_RELAXED)) {
+        semaphore_post(&wq->sem);
+    }
+}
+
+// 阻塞执行入队/出队操作：all为真时直到全部完成，否则完成至少一个即返回；返回完成的元素数
+static uint32_t ring_wait_op(ring_waitq_t *wq, ring_op_t op, void *ring, uint8_t *elems,
+                             uint32_t n, uint32_t elem_size, bool all, uint32_t timeout_ms) {
+    uint32_t done = op(ring, elems, n);
+    if (done == n || (done && !all) || timeout_ms == 0) return done;
+
+    uint32_t start = timer_get_ticks();
+
+    // 先登记等待者再重试：重试失败后的发布一定能看到登记并释放信号量
+    __atomic_add_fetch(&wq->waiters, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    while (done < n) {
+        uint32_t got = op(ring, elems + done * elem_size, n - done);
+        done += got;
+        if (done == n || (done && !all)) break;
+        if (got) continue;
+
+        uint32_t elapsed = timer_get_ticks() - start;
+        if (elapsed >= timeout_ms) break;
+
+        semaphore_timedwait(&wq->sem, timeout_ms - elapsed);
+    }
+
+    // 一次批量发布只释放一次信号量，离开时还有其他等待者则转交唤醒
+    if (__atomic_sub_fetch(&wq->waiters, 1, __ATOMIC_RELAXED) && done) {
+        semaphore_post(&wq->sem);
+    }
+
+    return done;
+}
+
+// 初始化单生产者单消费者环形队列，capacity须为2的幂
+int spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity, uint32_t elem_size, const char *name) {
+    if (!ring || !buffer || !elem_size || !capacity || (capacity & (capacity - 1))) return -1;
+
+    ring->buffer = buffer;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->name = name;
+    ring->tail = 0;
+    ring->head_cache = 0;
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring_waitq_init(&ring->not_empty, name);
+    ring_waitq_init(&ring->not_full, name);
+
+    return 0;
+}
+
+// 批量入队（仅生产者调用），空间不足时只入队能容纳的部分
+uint32_t spsc_ring_enqueue_batch(spsc_ring_t *ring, const void *elems, uint32_t n) {
+    uint32_t capacity = ring->mask + 1;
+    uint32_t tail = ring->tail;
+    uint32_t space = capacity - (tail - ring->head_cache);
+
+    // 缓存的读取位置不够时才读取消费者的缓存行
+    if (space < n) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        space = capacity - (tail - ring->head_cache);
+    }
+    if (n > space) n = space;
+    if (!n) return 0;
+
+    // 回绕时分两段拷贝
+    uint32_t idx = tail & ring->mask;
+    uint32_t first = capacity - idx;
+    if (first > n) first = n;
+    memcpy(ring->buffer + idx * ring->elem_size, elems, first * ring->elem_size);
+    memcpy(ring->buffer, (const uint8_t *)elems + first * ring->elem_size, (n - first) * ring->elem_size);
+
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    ring_wake(&ring->not_empty);
+
+    return n;
+}
+
+// 批量出队（仅消费者调用），返回实际出队数
+uint32_t spsc_ring_dequeue_batch(spsc_ring_t *ring, void *elems, uint32_t n) {
+    uint32_t capacity = ring->mask + 1;
+    uint32_t head = ring->head;
+    uint32_t avail = ring->tail_cache - head;
+
+    if (avail < n) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        avail = ring->tail_cache - head;
+    }
+    if (n > avail) n = avail;
+    if (!n) return 0;
+
+    uint32_t idx = head & ring->mask;
+    uint32_t first = capacity - idx;
+    if (first > n) first = n;
+    memcpy(elems, ring->buffer + idx * ring->elem_size, first * ring->elem_size);
+    memcpy((uint8_t *)elems + first * ring->elem_size, ring->buffer, (n - first) * ring->elem_size);
+
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    ring_wake(&ring->not_full);
+
+    return n;
+}
+
+bool spsc_ring_enqueue(spsc_ring_t *ring, const void *elem) {
+    return spsc_ring_enqueue_batch(ring, elem, 1) == 1;
+}
+
+bool spsc_ring_dequeue(spsc_ring_t *ring, void *elem) {
+    return spsc_ring_dequeue_batch(ring, elem, 1) == 1;
+}
+
+static uint32_t spsc_put(void *ring, void *elems, uint32_t n) {
+    return spsc_ring_enqueue_batch(ring, elems, n);
+}
+
+static uint32_t spsc_get(void *ring, void *elems, uint32_t n) {
+    return spsc_ring_dequeue_batch(ring, elems, n);
+}
+
+// 阻塞入队，直到全部入队或超时，返回已入队数
+uint32_t spsc_ring_enqueue_wait(spsc_ring_t *ring, const void *elems, uint32_t n, uint32_t timeout_ms) {
+    return ring_wait_op(&ring->not_full, spsc_put, ring,
+                        (uint8_t *)elems, n, ring->elem_size, true, timeout_ms);
+}
+
+// 阻塞出队，至少取得一个元素或超时
+uint32_t spsc_ring_dequeue_wait(spsc_ring_t *ring, void *elems, uint32_t n, uint32_t timeout_ms) {
+    return ring_wait_op(&ring->not_empty, spsc_get, ring,
+                        elems, n, ring->elem_size, false, timeout_ms);
+}
+
+uint32_t spsc_ring_count(spsc_ring_t *ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+static inline volatile uint32_t *cell_seq(mpmc_ring_t *ring, uint32_t pos) {
+    return (volatile uint32_t *)(ring->cells + (pos & ring->mask) * ring->cell_size);
+}
+
+static inline uint8_t *cell_data(mpmc_ring_t *ring, uint32_t pos) {
+    return ring->cells + (pos & ring->mask) * ring->cell_size + sizeof(uint32_t);
+}
+
+// 初始化多生产者多消费者环形队列，cells大小为capacity * MPMC_RING_CELL_SIZE(elem_size)
+int mpmc_ring_init(mpmc_ring_t *ring, void *cells, uint32_t capacity, uint32_t elem_size, const char *name) {
+    if (!ring || !cells || !elem_size || !capacity || (capacity & (capacity - 1))) return -1;
+
+    ring->cells = cells;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->cell_size = MPMC_RING_CELL_SIZE(elem_size);
+    ring->name = name;
+    ring->tail = 0;
+    ring->head = 0;
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        *cell_seq(ring, i) = i;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ring_waitq_init(&ring->not_empty, name);
+    ring_waitq_init(&ring->not_full, name);
+
+    return 0;
+}
+
+/*
+ * 批量入队：从tail起数出连续可写的槽位（序号等于位置），一次CAS认领整段。
+ * 槽位序号只会被认领该位置的生产者改写，CAS成功前检查过的槽位不会变为不可写。
+ */
+uint32_t mpmc_ring_enqueue_batch(mpmc_ring_t *ring, const void *elems, uint32_t n) {
+    uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t count;
+
+    if (!n) return 0;
+
+    for (;;) {
+        for (count = 0; count < n; count++) {
+            uint32_t seq = __atomic_load_n(cell_seq(ring, pos + count), __ATOMIC_ACQUIRE);
+            if (seq != pos + count) break;
+        }
+
+        if (count == 0) {
+            // 首个槽位仍未被消费完（满），或tail已被其他生产者推进
+            uint32_t seq = __atomic_load_n(cell_seq(ring, pos), __ATOMIC_ACQUIRE);
+            if ((int32_t)(seq - pos) < 0) return 0;
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + count, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    const uint8_t *src = elems;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(cell_data(ring, pos + i), src + i * ring->elem_size, ring->elem_size);
+        __atomic_store_n(cell_seq(ring, pos + i), pos + i + 1, __ATOMIC_RELEASE);
+    }
+
+    ring_wake(&ring->not_empty);
+    return count;
+}
+
+// 批量出队：认领连续可读的槽位（序号等于位置+1），读出后序号推进一圈
+uint32_t mpmc_ring_dequeue_batch(mpmc_ring_t *ring, void *elems, uint32_t n) {
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t count;
+
+    if (!n) return 0;
+
+    for (;;) {
+        for (count = 0; count < n; count++) {
+            uint32_t seq = __atomic_load_n(cell_seq(ring, pos + count), __ATOMIC_ACQUIRE);
+            if (seq != pos + count + 1) break;
+        }
+
+        if (count == 0) {
+            // 首个槽位尚未发布（空），或head已被其他消费者推进
+            uint32_t seq = __atomic_load_n(cell_seq(ring, pos), __ATOMIC_ACQUIRE);
+            if ((int32_t)(seq - (pos + 1)) < 0) return 0;
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&ring->head, &pos, pos + count, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    uint8_t *dst = elems;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(dst + i * ring->elem_size, cell_data(ring, pos + i), ring->elem_size);
+        __atomic_store_n(cell_seq(ring, pos + i), pos + i + ring->mask + 1, __ATOMIC_RELEASE);
+    }
+
+    ring_wake(&ring->not_full);
+    return count;
+}
+
+bool mpmc_ring_enqueue(mpmc_ring_t *ring, const void *elem) {
+    return mpmc_ring_enqueue_batch(ring, elem, 1) == 1;
+}
+
+bool mpmc_ring_dequeue(mpmc_ring_t *ring, void *elem) {
+    return mpmc_ring_dequeue_batch(ring, elem, 1) == 1;
+}
+
+static uint32_t mpmc_put(void *ring, void *elems, uint32_t n) {
+    return mpmc_ring_enqueue_batch(ring, elems, n);
+}
+
+static uint32_t mpmc_get(void *ring, void *elems, uint32_t n) {
+    return mpmc_ring_dequeue_batch(ring, elems, n);
+}
+
+// 阻塞入队，直到全部入队或超时，返回已入队数
+uint32_t mpmc_ring_enqueue_wait(mpmc_ring_t *ring, const void *elems, uint32_t n, uint32_t timeout_ms) {
+    return ring_wait_op(&ring->not_full, mpmc_put, ring,
+                        (uint8_t *)elems, n, ring->elem_size, true, timeout_ms);
+}
+
+// 阻塞出队，至少取得一个元素或超时
+uint32_t mpmc_ring_dequeue_wait(mpmc_ring_t *ring, void *elems, uint32_t n, uint32_t timeout_ms) {
+    return ring_wait_op(&ring->not_empty, mpmc_get, ring,
+                        elems, n, ring->elem_size, false, timeout_ms);
+}
+
+// 近似元素数（含已认领未发布的槽位）
+uint32_t mpmc_ring_count(mpmc_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    int32_t count = (int32_t)(tail - head);
+
+    return count < 0 ? 0 : (uint32_t)count;
+}
@@ -15,6 +15,7 @@ void scheduler_init(void) {
     // 初始化各个调度器
     scheduler_mlfq_init();
     scheduler_fair_init();
+    scheduler_rt_init();
 }
 
 // 启动调度器
@@ -1,5 +1,6 @@
 #include "scheduler.h"
 #include "task.h"
+#include "mm.h"
 #include <stdint.h>
 
 // 红黑树节点颜色
@@ -20,6 +21,9 @@ typedef struct rb_node {
 // 红黑树根
 static rb_node_t *rb_root = NULL;
 
+// 调度实体缓存
+static kmem_cache_t *se_cache;
+
 // 调度实体
 typedef struct {
     rb_node_t rb_node;
@@ -142,9 +146,15 @@ static void rb_insert_color(rb_node_t *node) {
     rb_root->color = RB_BLACK;
 }
 
+// 初始化公平调度器
+void scheduler_fair_init(void) {
+    rb_root = NULL;
+    se_cache = kmem_cache_create("sched_entity", sizeof(sched_entity_t), 0, SLAB_HWCACHE_ALIGN, NULL);
+}
+
 // 初始化调度实体
 static void init_sched_entity(task_t *task) {
-    sched_entity_t *se = malloc(sizeof(sched_entity_t));
+    sched_entity_t *se = kmem_cache_alloc(se_cache);
     if (!se) return;
 
     memset(se, 0, sizeof(sched_entity_t));
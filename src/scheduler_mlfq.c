@@ -1,5 +1,6 @@
 #include "scheduler.h"
 #include "task.h"
+#include "mm.h"
 #include <stdint.h>
 
 // MLFQ队列结构
@@ -14,6 +15,7 @@ typedef struct {
 static mlfq_queue_t queues[MLFQ_QUEUE_COUNT];
 static uint32_t boost_period = 100;  // 优先级提升周期
 static uint32_t boost_counter = 0;
+static kmem_cache_t *mlfq_params_cache;
 
 // 初始化MLFQ
 void scheduler_mlfq_init(void) {
@@ -23,6 +25,10 @@ void scheduler_mlfq_init(void) {
         queues[i].time_quantum = (1 << i) * BASE_QUANTUM;  // 指数增长的时间片
         queues[i].task_count = 0;
     }
+
+    if (!mlfq_params_cache) {
+        mlfq_params_cache = kmem_cache_create("mlfq_params", sizeof(mlfq_params_t), 0, 0, NULL);
+    }
 }
 
 // 将任务添加到队列
@@ -68,7 +74,7 @@ static task_t *mlfq_dequeue(uint32_t queue_index) {
 
 // 初始化任务的MLFQ参数
 void scheduler_mlfq_init_task(task_t *task) {
-    mlfq_params_t *params = malloc(sizeof(mlfq_params_t));
+    mlfq_params_t *params = kmem_cache_alloc(mlfq_params_cache);
     if (!params) {
         return;
     }
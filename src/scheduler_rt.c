@@ -1,11 +1,13 @@
 #include "scheduler.h"
 #include "task.h"
 #include "timer.h"
+#include "mm.h"
 #include <stdint.h>
 
 // 实时任务链表
 static task_t *rt_tasks = NULL;
 static uint32_t rt_task_count = 0;
+static kmem_cache_t *rt_params_cache;
 
 // EDF (Earliest Deadline First) 调度实现
 static task_t *edf_schedule(void) {
@@ -47,6 +49,13 @@ static task_t *rm_schedule(void) {
     return highest;
 }
 
+// 初始化实时调度器
+void scheduler_rt_init(void) {
+    rt_tasks = NULL;
+    rt_task_count = 0;
+    rt_params_cache = kmem_cache_create("rt_params", sizeof(realtime_params_t), 0, 0, NULL);
+}
+
 // 设置实时参数
 void scheduler_set_realtime_params(task_t *task, realtime_params_t *params) {
     if (!task || !params) {
@@ -54,7 +63,7 @@ void scheduler_set_realtime_params(task_t *task, realtime_params_t *params) {
     }
 
     // 分配实时参数结构
-    realtime_params_t *rt_params = malloc(sizeof(realtime_params_t));
+    realtime_params_t *rt_params = kmem_cache_alloc(rt_params_cache);
     if (!rt_params) {
         return;
     }
@@ -1,6 +1,7 @@
 #include "sync.h"
 #include "interrupt.h"
 #include "task.h"
+#include "timer.h"
 
 // 初始化信号量
 void semaphore_init(semaphore_t *sem, int32_t initial_count, const char *name) {
@@ -35,6 +36,55 @@ void semaphore_wait(semaphore_t *sem) {
     task_yield();
 }
 
+// 从等待队列中摘除指定任务，任务不在队列中返回false
+static bool wait_queue_unlink(task_t **queue, task_t *task) {
+    while (*queue && *queue != task) {
+        queue = &(*queue)->next_wait;
+    }
+    if (!*queue) return false;
+
+    *queue = task->next_wait;
+    task->next_wait = NULL;
+    return true;
+}
+
+// 带超时的等待信号量，超时返回false
+bool semaphore_timedwait(semaphore_t *sem, uint32_t timeout_ms) {
+    if (!sem) return false;
+    
+    interrupt_disable();
+    
+    if (sem->count > 0) {
+        sem->count--;
+        interrupt_enable();
+        return true;
+    }
+    
+    if (timeout_ms == 0) {
+        interrupt_enable();
+        return false;
+    }
+    
+    // 增加竞争计数
+    sync_stats.sem_contentions++;
+    
+    // 将当前任务添加到等待队列
+    task_t *current = task_get_current();
+    current->state = TASK_BLOCKED;
+    current->wake_time = timer_get_ticks() + timeout_ms;
+    add_to_wait_queue(&sem->waiting_tasks, current);
+    
+    interrupt_enable();
+    task_yield();
+    
+    // semaphore_post唤醒时已把任务移出队列并直接交付计数；仍在队列中说明超时
+    interrupt_disable();
+    bool timed_out = wait_queue_unlink(&sem->waiting_tasks, current);
+    interrupt_enable();
+    
+    return !timed_out;
+}
+
 // 尝试等待信号量
 bool semaphore_trywait(semaphore_t *sem) {
     if (!sem) return false;
@@ -1,51 +1,50 @@
 #include "ipc.h"
 #include "memory.h"
 #include "mmu.h"
+#include "mm.h"
 #include <string.h>
 
-// 全局共享内存段链表
-static shm_segment_t *shm_segments = NULL;
-static mutex_t shm_segments_lock;
+// 共享内存段句柄表
+static ipc_table_t shm_table;
+static kmem_cache_t *shm_cache;
 
 // 初始化共享内存系统
 void shm_init(void) {
-    mutex_init(&shm_segments_lock, "shm_segments_lock");
+    ipc_table_init(&shm_table, IPC_MAX_SHM);
+    shm_cache = kmem_cache_create("shm_segment", sizeof(shm_segment_t), 0, SLAB_HWCACHE_ALIGN, NULL);
 }
 
-// 查找共享内存段
-static shm_segment_t *find_shm_segment(key_t key) {
-    shm_segment_t *seg = shm_segments;
-    while (seg) {
-        if (seg->key == key) {
-            return seg;
-        }
-        seg = seg->next;
+// 按句柄查找共享内存段并持有一个引用，用完后shm_put
+static inline shm_segment_t *find_shm_segment(int shmid) {
+    return ipc_handle_get(&shm_table, shmid);
+}
+
+// 释放一个引用，最后一个引用（句柄已删除且没有进行中的操作）释放段内存
+static void shm_put(shm_segment_t *seg) {
+    if (ipc_handle_put(seg)) {
+        mm_free_pages(seg->phys_addr, seg->size / PAGE_SIZE + 1);
+        kmem_cache_free(shm_cache, seg);
+        ipc_stats.shm_segments--;
     }
-    return NULL;
 }
 
-// 创建共享内存段
+// 创建共享内存段，返回段句柄
 int shm_create(key_t key, uint32_t size) {
-    mutex_lock(&shm_segments_lock);
-
-    // 检查是否已存在
-    if (find_shm_segment(key)) {
-        mutex_unlock(&shm_segments_lock);
+    // 检查是否已存在（分配句柄时会再次检查）
+    if (ipc_handle_lookup(&shm_table, key) >= 0) {
         return -1;
     }
 
     // 分配共享内存段结构
-    shm_segment_t *seg = malloc(sizeof(shm_segment_t));
+    shm_segment_t *seg = kmem_cache_alloc(shm_cache);
     if (!seg) {
-        mutex_unlock(&shm_segments_lock);
         return -1;
     }
 
     // 分配物理内存
     void *phys_addr = mm_alloc_pages(size / PAGE_SIZE + 1);
     if (!phys_addr) {
-        free(seg);
-        mutex_unlock(&shm_segments_lock);
+        kmem_cache_free(shm_cache, seg);
         return -1;
     }
 
@@ -53,79 +52,105 @@ int shm_create(key_t key, uint32_t size) {
     seg->key = key;
     seg->size = size;
     seg->phys_addr = phys_addr;
+    seg->obj.refs = 0;
     seg->ref_count = 0;
     mutex_init(&seg->lock, "shm_lock");
 
-    // 添加到链表
-    seg->next = shm_segments;
-    shm_segments = seg;
+    // 分配句柄
+    seg->id = ipc_handle_alloc(&shm_table, key, seg);
+    if (seg->id < 0) {
+        mm_free_pages(phys_addr, size / PAGE_SIZE + 1);
+        kmem_cache_free(shm_cache, seg);
+        return -1;
+    }
     ipc_stats.shm_segments++;
 
-    mutex_unlock(&shm_segments_lock);
+    return seg->id;
+}
+
+// 按键打开共享内存段，返回句柄
+int shm_open(key_t key) {
+    return ipc_handle_lookup(&shm_table, key);
+}
+
+// 关闭共享内存段：句柄全局有效，只校验句柄
+int shm_close(int shmid) {
+    shm_segment_t *seg = find_shm_segment(shmid);
+    if (!seg) return -1;
+
+    shm_put(seg);
     return 0;
 }
 
-// 附加共享内存段
-void *shm_attach(int shmid) {
+// 删除共享内存段：仍有任务附加时失败；段内存在最后一个进行中的操作结束后释放
+int shm_delete(int shmid) {
     shm_segment_t *seg = find_shm_segment(shmid);
-    if (!seg) return NULL;
+    if (!seg) return -1;
 
     mutex_lock(&seg->lock);
-
-    // 为当前任务分配虚拟地址空间
-    void *virt_addr = mm_alloc_virt_pages(seg->size / PAGE_SIZE + 1);
-    if (!virt_addr) {
+    if (seg->ref_count > 0) {
         mutex_unlock(&seg->lock);
-        return NULL;
+        shm_put(seg);
+        return -1;
     }
 
-    // 建立映射
-    for (uint32_t offset = 0; offset < seg->size; offset += PAGE_SIZE) {
-        mmu_map_page((uint32_t)virt_addr + offset,
-                     (uint32_t)seg->phys_addr + offset,
-                     MMU_PERM_READ | MMU_PERM_WRITE | MMU_PERM_USER);
-    }
+    // 并发删除时只有一方能释放句柄，另一方得到NULL；两方都持有引用，段不会在此期间释放
+    shm_segment_t *freed = ipc_handle_free(&shm_table, shmid);
+    mutex_unlock(&seg->lock);
 
-    seg->ref_count++;
-    ipc_stats.shm_attaches++;
+    if (freed) shm_put(freed);
+    shm_put(seg);
+    return freed ? 0 : -1;
+}
+
+// 附加共享内存段：段内存物理连续，按段大小对齐虚拟地址后以尽量大的粒度映射
+void *shm_attach(int shmid) {
+    shm_segment_t *seg = find_shm_segment(shmid);
+    if (!seg) return NULL;
+
+    mutex_lock(&seg->lock);
+
+    void *virt_addr = mm_mmap_phys(NULL, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   (uint32_t)seg->phys_addr);
+    if (virt_addr) {
+        seg->ref_count++;
+        ipc_stats.shm_attaches++;
+    }
 
     mutex_unlock(&seg->lock);
+    shm_put(seg);
     return virt_addr;
 }
 
 // 分离共享内存段
 int shm_detach(void *addr) {
-    mutex_lock(&shm_segments_lock);
-
-    // 查找对应的共享内存段
-    shm_segment_t *seg = shm_segments;
-    while (seg) {
-        task_t *current = task_get_current();
-        if (current->mm->shm_areas && 
-            current->mm->shm_areas->addr == addr) {
-            break;
-        }
-        seg = seg->next;
+    task_t *current = task_get_current();
+    vm_area_t *vma = current->mm ? vma_lookup(current->mm, (uint32_t)addr) : NULL;
+
+    if (!vma || !(vma->map_flags & MAP_PHYS) || vma->start != (uint32_t)addr) {
+        return -1;
+    }
+
+    // 按映射的物理地址查找对应的共享内存段（分离不在热路径上，遍历句柄表）
+    uint32_t pos = 0;
+    shm_segment_t *seg;
+    while ((seg = ipc_handle_next(&shm_table, &pos))) {
+        if ((uint32_t)seg->phys_addr == vma->phys) break;
+        shm_put(seg);
     }
 
     if (!seg) {
-        mutex_unlock(&shm_segments_lock);
         return -1;
     }
 
     mutex_lock(&seg->lock);
 
-    // 解除映射
-    for (uint32_t offset = 0; offset < seg->size; offset += PAGE_SIZE) {
-        mmu_unmap_page((uint32_t)addr + offset);
-    }
-
-    // 释放虚拟地址空间
-    mm_free_virt_pages(addr, seg->size / PAGE_SIZE + 1);
+    // 解除映射并释放虚拟地址区间
+    mm_unmap(addr, seg->size);
 
     seg->ref_count--;
 
     mutex_unlock(&seg->lock);
-    mutex_unlock(&shm_segments_lock);
+    shm_put(seg);
     return 0;
-} 
\ No newline at end of file
+}
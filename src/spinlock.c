@@ -0,0 +1,52 @@
+#include "sync.h"
+
+// 初始化自旋锁
+void spinlock_init(spinlock_t *spinlock, const char *name) {
+    if (!spinlock) return;
+
+    spinlock->locked = 0;
+    spinlock->name = name;
+}
+
+// 尝试获取自旋锁（ldrex/strex原子交换）
+bool spinlock_trylock(spinlock_t *spinlock) {
+    uint32_t old, fail;
+
+    if (!spinlock) return false;
+
+    __asm__ volatile (
+        "ldrex   %0, [%2]\n"
+        "cmp     %0, #0\n"
+        "strexeq %1, %3, [%2]\n"
+        "movne   %1, #1\n"
+        : "=&r" (old), "=&r" (fail)
+        : "r" (&spinlock->locked), "r" (1)
+        : "cc", "memory");
+
+    if (old == 0 && fail == 0) {
+        __asm__ volatile ("dmb" ::: "memory");
+        return true;
+    }
+    return false;
+}
+
+// 获取自旋锁
+void spinlock_lock(spinlock_t *spinlock) {
+    if (!spinlock) return;
+
+    while (!spinlock_trylock(spinlock)) {
+        // 等待锁释放时进入低功耗状态，unlock中的sev会唤醒
+        while (spinlock->locked) {
+            __asm__ volatile ("wfe");
+        }
+    }
+}
+
+// 释放自旋锁
+void spinlock_unlock(spinlock_t *spinlock) {
+    if (!spinlock) return;
+
+    __asm__ volatile ("dmb" ::: "memory");
+    spinlock->locked = 0;
+    __asm__ volatile ("dsb\n" "sev" ::: "memory");
+}
@@ -1,9 +1,11 @@
 #include "task.h"
 #include "scheduler.h"
 #include "mmu.h"
+#include "mm.h"
 #include "interrupt.h"
 #include "timer.h"
 #include "uart.h"
+#include "cjson.h"
 
 // 示例任务1
 static void task1(void) {
@@ -40,6 +42,11 @@ void system_init(void) {
     mmu_enable();
     uart_puts("MMU initialized\r\n");
 
+    // 初始化内存管理
+    mm_init();
+    cJSON_Init();
+    uart_puts("Memory manager initialized\r\n");
+
     // 初始化中断系统
     interrupt_init();
     uart_puts("Interrupt system initialized\r\n");
@@ -57,6 +64,21 @@ void system_init(void) {
     scheduler_set_policy(SCHEDULER_POLICY_PRIORITY);
     uart_puts("Scheduler initialized\r\n");
 
+    // 初始化页面替换并启动访问标志扫描与kswapd任务
+    pra_init(PRA_LRU);
+    pra_scanner_start();
+    pra_kswapd_start();
+
+    // 压缩内存交换层优先于磁盘交换区，最多容纳32MB被换出的页
+    if (zram_init(8192) == 0) {
+        uart_puts("Compressed swap enabled\r\n");
+    }
+
+    // 交换区位于MMC卡（驱动器1）64MB偏移处，共32MB
+    if (swap_init(1, 131072, 8192) == 0) {
+        uart_puts("Swap enabled\r\n");
+    }
+
     // 创建示例任务
     task_t *t1 = task_create("task1", task1, TASK_PRIORITY_NORMAL, DEFAULT_STACK_SIZE);
     task_t *t2 = task_create("task2", task2, TASK_PRIORITY_HIGH, DEFAULT_STACK_SIZE);
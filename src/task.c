@@ -1,6 +1,7 @@
 #include "task.h"
 #include "scheduler.h"
 #include "uart.h"
+#include "mm.h"
 #include <string.h>
 
 // 任务列表
@@ -9,6 +10,10 @@ static task_t *current_task = NULL;
 static task_t *idle_task = NULL;
 static uint32_t task_count = 0;
 
+// 每CPU抢占计数与延迟调度标志
+static volatile uint32_t preempt_counts[MAX_CPUS];
+static volatile bool need_resched[MAX_CPUS];
+
 // 空闲任务
 static void idle_task_entry(void) {
     while (1) {
@@ -83,6 +88,42 @@ task_t *task_create(const char *name, void (*entry)(void), uint8_t priority, uin
     return task;
 }
 
+// 创建用户任务：附带一个空的用户地址空间
+task_t *task_create_user(const char *name, void (*entry)(void), uint8_t priority, uint32_t stack_size) {
+    task_t *task = task_create(name, entry, priority, stack_size);
+    if (!task) {
+        return NULL;
+    }
+
+    task->mm = mm_create();
+    if (!task->mm) {
+        task_delete(task);
+        return NULL;
+    }
+
+    return task;
+}
+
+// 克隆当前任务的地址空间（写时复制），新任务从entry开始执行
+task_t *task_clone(const char *name, void (*entry)(void), uint8_t priority, uint32_t stack_size) {
+    if (!current_task || !current_task->mm) {
+        return NULL;
+    }
+
+    task_t *task = task_create(name, entry, priority, stack_size);
+    if (!task) {
+        return NULL;
+    }
+
+    task->mm = mm_dup(current_task->mm);
+    if (!task->mm) {
+        task_delete(task);
+        return NULL;
+    }
+
+    return task;
+}
+
 // 删除任务
 void task_delete(task_t *task) {
     if (!task || task == idle_task) {
@@ -91,6 +132,18 @@ void task_delete(task_t *task) {
 
     // 从调度队列中移除
     task->state = TASK_TERMINATED;
+    mm_task_cache_release(task);
+    task_scratch_release(task);
+
+    // 释放用户地址空间；删除自身时先切回内核页表
+    if (task->mm) {
+        if (task == current_task) {
+            mm_switch(NULL);
+        }
+        mm_destroy(task->mm);
+        task->mm = NULL;
+    }
+
     free(task->stack);
     task_count--;
 
@@ -151,13 +204,48 @@ task_t *task_get_current(void) {
     return current_task;
 }
 
+// 禁止抢占
+void preempt_disable(void) {
+    preempt_counts[smp_processor_id()]++;
+    __asm__ volatile ("" ::: "memory");
+}
+
+// 恢复抢占，若期间有调度请求则补做调度
+void preempt_enable(void) {
+    uint32_t cpu = smp_processor_id();
+
+    __asm__ volatile ("" ::: "memory");
+    if (--preempt_counts[cpu] == 0 && need_resched[cpu]) {
+        need_resched[cpu] = false;
+        task_schedule();
+    }
+}
+
+// 获取当前CPU的抢占计数
+uint32_t preempt_count(void) {
+    return preempt_counts[smp_processor_id()];
+}
+
 // 任务调度
 void task_schedule(void) {
+    uint32_t cpu = smp_processor_id();
+
+    // 抢占被禁止时推迟到preempt_enable
+    if (preempt_counts[cpu]) {
+        need_resched[cpu] = true;
+        return;
+    }
+
     task_t *next = scheduler_next_task();
     
     if (next != current_task) {
         task_t *prev = current_task;
         current_task = next;
+
+        // 地址空间不同才切换页表；ASID区分TLB项，切换无需整体失效TLB
+        if (!prev || prev->mm != next->mm) {
+            mm_switch(next->mm);
+        }
         context_switch(prev, next);
     }
 }
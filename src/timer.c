@@ -1,6 +1,7 @@
 #include "timer.h"
 #include "interrupt.h"
 #include "scheduler.h"
+#include "mm.h"
 #include <stdint.h>
 
 // 在定时器中断处理函数中添加调度器tick处理
@@ -11,6 +12,9 @@ static void timer_irq_handler(void) {
     // 增加系统滴答计数
     system_ticks++;
     
+    // 页面老化
+    pra_tick();
+
     // 调度器tick处理
     scheduler_tick();
 } 
\ No newline at end of file